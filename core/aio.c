@@ -0,0 +1,231 @@
+// core/aio.c - Asynchronous file I/O rings for CDL apps
+//
+// The scheduler is not running, so the "worker" is cooperative: aio_pump
+// runs from the GUI main loop (same context as app callbacks, so the
+// filesystem never sees two callers at once) and does a bounded slice of
+// work each frame. Large reads are split into AIO_CHUNK pieces and
+// requests are rotated so several stay in flight per app.
+
+#include "aio.h"
+#include "memory.h"
+#include "string.h"
+#include "../fs/pfs32.h"
+#include "../fs/tmpfs.h"
+#include "../sys/api.h"
+
+typedef struct {
+    int active;
+    aio_ring_t* ring;
+    uint32_t op;
+    uint32_t user_data;
+    char path[256];
+    uint8_t* buf;
+    uint32_t len;
+    uint32_t offset;
+    uint32_t done;          // Bytes transferred so far
+    int handle;             // Open PFS32 handle for chunked reads, or -1
+    int in_tmp;             // Under a tmpfs mount: by path, no handle
+    int result;
+    int finished;           // Waiting for room in the completion queue
+} aio_req_t;
+
+static aio_ring_t* rings[AIO_MAX_RINGS];
+static aio_req_t reqs[AIO_MAX_REQUESTS];
+static int next_req = 0;    // Round-robin cursor
+
+aio_ring_t* aio_create(uint32_t entries) {
+    if (entries == 0 || entries > AIO_MAX_ENTRIES) return 0;
+    // Round up to a power of two so indices can be masked
+    uint32_t n = 1;
+    while (n < entries) n <<= 1;
+
+    int slot = -1;
+    for (int i = 0; i < AIO_MAX_RINGS; i++) {
+        if (!rings[i]) { slot = i; break; }
+    }
+    if (slot < 0) return 0;
+
+    aio_ring_t* ring = (aio_ring_t*)kzalloc(sizeof(aio_ring_t));
+    if (!ring) return 0;
+    ring->sqes = (aio_sqe_t*)kzalloc(n * sizeof(aio_sqe_t));
+    ring->cqes = (aio_cqe_t*)kzalloc(n * sizeof(aio_cqe_t));
+    if (!ring->sqes || !ring->cqes) {
+        if (ring->sqes) kfree(ring->sqes);
+        if (ring->cqes) kfree(ring->cqes);
+        kfree(ring);
+        return 0;
+    }
+    ring->entries = n;
+    rings[slot] = ring;
+    return ring;
+}
+
+static void req_release(aio_req_t* r) {
+    if (r->handle >= 0) pfs32_close(r->handle);
+    r->handle = -1;
+    r->active = 0;
+}
+
+void aio_destroy(aio_ring_t* ring) {
+    if (!ring) return;
+    for (int i = 0; i < AIO_MAX_RINGS; i++) {
+        if (rings[i] != ring) continue;
+        // Drop anything still in flight; its buffers belong to the app
+        for (int k = 0; k < AIO_MAX_REQUESTS; k++) {
+            if (reqs[k].active && reqs[k].ring == ring) req_release(&reqs[k]);
+        }
+        rings[i] = 0;
+        kfree(ring->sqes);
+        kfree(ring->cqes);
+        kfree(ring);
+        return;
+    }
+}
+
+static int ring_valid(aio_ring_t* ring) {
+    if (!ring) return 0;
+    for (int i = 0; i < AIO_MAX_RINGS; i++) {
+        if (rings[i] == ring) return 1;
+    }
+    return 0;
+}
+
+// Move SQEs into kernel requests. Paths are copied here, so the app only
+// has to keep its buffers alive until completion.
+int aio_submit(aio_ring_t* ring) {
+    if (!ring_valid(ring)) return -1;
+    int accepted = 0;
+    while (ring->sq_head != ring->sq_tail) {
+        aio_req_t* r = 0;
+        for (int i = 0; i < AIO_MAX_REQUESTS; i++) {
+            if (!reqs[i].active) { r = &reqs[i]; break; }
+        }
+        if (!r) break; // Full; the rest stays queued for the next submit
+
+        aio_sqe_t* sqe = &ring->sqes[ring->sq_head & (ring->entries - 1)];
+        memset(r, 0, sizeof(aio_req_t));
+        r->active = 1;
+        r->ring = ring;
+        r->op = sqe->op;
+        r->user_data = sqe->user_data;
+        if (sqe->path) strncpy(r->path, sqe->path, sizeof(r->path) - 1);
+        r->buf = (uint8_t*)sqe->buf;
+        r->len = sqe->len;
+        r->offset = sqe->offset;
+        r->handle = -1;
+        r->in_tmp = tmpfs_owns(r->path);
+        ring->sq_head++;
+        accepted++;
+    }
+    return accepted;
+}
+
+static int post_completion(aio_req_t* r) {
+    aio_ring_t* ring = r->ring;
+    if (ring->cq_tail - ring->cq_head >= ring->entries) return 0; // App hasn't drained
+    aio_cqe_t* cqe = &ring->cqes[ring->cq_tail & (ring->entries - 1)];
+    cqe->user_data = r->user_data;
+    cqe->result = r->result;
+    ring->cq_tail++;
+    return 1;
+}
+
+static void req_finish(aio_req_t* r, int result) {
+    if (r->handle >= 0) pfs32_close(r->handle);
+    r->handle = -1;
+    r->result = result;
+    r->finished = 1;
+}
+
+// Advance one request by at most one chunk; returns bytes of work done
+static uint32_t req_step(aio_req_t* r) {
+    switch (r->op) {
+        case AIO_OP_READ: {
+            if (r->in_tmp) {
+                uint32_t n = r->len - r->done;
+                if (n > AIO_CHUNK) n = AIO_CHUNK;
+                int got = n ? tmpfs_pread(r->path, r->buf + r->done, n, r->offset + r->done) : 0;
+                if (got < 0) { req_finish(r, got); return 0; }
+                r->done += got;
+                if ((uint32_t)got < n || r->done >= r->len) req_finish(r, (int)r->done);
+                return got ? (uint32_t)got : 1;
+            }
+            if (r->handle < 0) {
+                r->handle = pfs32_open(r->path, 0);
+                if (r->handle < 0) { req_finish(r, r->handle); return 0; }
+                if (r->offset && pfs32_seek(r->handle, r->offset) != PFS_OK) {
+                    req_finish(r, PFS_ERR_PARAM);
+                    return 0;
+                }
+            }
+            uint32_t n = r->len - r->done;
+            if (n > AIO_CHUNK) n = AIO_CHUNK;
+            int got = n ? pfs32_read_handle(r->handle, r->buf + r->done, n) : 0;
+            if (got < 0) { req_finish(r, got); return 0; }
+            r->done += got;
+            if ((uint32_t)got < n || r->done >= r->len) req_finish(r, (int)r->done);
+            return got ? (uint32_t)got : 1;
+        }
+        case AIO_OP_WRITE: {
+            if (!sys_fs_exists(r->path)) sys_fs_create(r->path, 0);
+            if (r->offset == 0) {
+                // Offset 0 replaces the whole file
+                req_finish(r, sys_fs_write(r->path, (char*)r->buf, r->len));
+                return r->len ? r->len : 1;
+            }
+            // Anything else patches it in place, growing it if needed
+            int res;
+            if (r->in_tmp) {
+                res = tmpfs_pwrite(r->path, r->buf, r->len, r->offset);
+            } else {
+                r->handle = pfs32_open(r->path, 1);
+                if (r->handle < 0) { req_finish(r, r->handle); return 0; }
+                res = pfs32_pwrite(r->handle, r->buf, r->len, r->offset);
+            }
+            if (res >= 0) sys_notify_fs_event(FS_EVENT_MODIFY, r->path);
+            req_finish(r, res);
+            return r->len ? r->len : 1;
+        }
+        case AIO_OP_STAT: {
+            pfs32_direntry_t* e = (pfs32_direntry_t*)r->buf;
+            int res = r->in_tmp ? tmpfs_stat(r->path, e) : pfs32_stat(r->path, e);
+            req_finish(r, res == PFS_OK ? (int)sizeof(pfs32_direntry_t) : res);
+            return sizeof(pfs32_direntry_t);
+        }
+        case AIO_OP_LIST: {
+            int res = sys_fs_list_dir(r->path, r->buf, r->len);
+            req_finish(r, res);
+            return (res > 0 ? res : 1) * sizeof(pfs32_direntry_t);
+        }
+        default:
+            req_finish(r, PFS_ERR_PARAM);
+            return 0;
+    }
+}
+
+int aio_pump(void) {
+    uint32_t budget = AIO_SLICE_BYTES;
+    int pending = 0;
+
+    // Readahead windows queued by sequential readers, then dirty data
+    // that has aged past the write-back deadline
+    pfs32_readahead_pump();
+    pfs32_writeback_pump();
+
+    for (int n = 0; n < AIO_MAX_REQUESTS * 4 && budget > 0; n++) {
+        aio_req_t* r = &reqs[next_req];
+        next_req = (next_req + 1) % AIO_MAX_REQUESTS;
+        if (!r->active) continue;
+
+        if (!r->finished) {
+            uint32_t work = req_step(r);
+            budget = work >= budget ? 0 : budget - work;
+        }
+        if (r->finished && post_completion(r)) req_release(r);
+    }
+
+    for (int i = 0; i < AIO_MAX_REQUESTS; i++) {
+        if (reqs[i].active) { pending = 1; break; }
+    }
+    return pending;
+}
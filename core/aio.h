@@ -0,0 +1,21 @@
+// core/aio.h - Asynchronous file I/O rings for CDL apps
+#ifndef AIO_H
+#define AIO_H
+
+#include "../sys/cdl_defs.h"
+
+#define AIO_MAX_RINGS     16
+#define AIO_MAX_REQUESTS  64      // In flight across all rings
+#define AIO_MAX_ENTRIES   256     // Per ring
+#define AIO_CHUNK         65536   // Bytes read per request per slice
+#define AIO_SLICE_BYTES   262144  // Work done per aio_pump call
+
+aio_ring_t* aio_create(uint32_t entries);
+void aio_destroy(aio_ring_t* ring);
+int aio_submit(aio_ring_t* ring);
+
+// Background worker: advances in-flight requests round-robin. Called
+// from the GUI loop and process_events; returns 1 if work remains.
+int aio_pump(void);
+
+#endif
@@ -11,6 +11,9 @@
 #include "socket.h"
 #include "dns.h"
 #include "http.h"
+#include "aio.h"
+#include "mmap.h"
+#include "fswatch.h"
 
 // Built-in VarArgs
 #define va_start(v,l) __builtin_va_start(v,l)
@@ -165,6 +168,8 @@ uint32_t wrap_mem_used() { return k_get_total_mem() - k_get_free_mem(); }
 uint32_t wrap_mem_total() { return k_get_total_mem(); }
 int wrap_ping(const char* ip, char* buf, int len) { return sys_net_ping(ip, buf, len); }
 int wrap_fs_list(const char* p, void* b, int c) { return sys_fs_list_dir(p, b, c); }
+int wrap_fs_readdir(const char* p, fs_dirent_t* b, int c, uint32_t* cur) { return sys_fs_readdir(p, b, c, cur); }
+int wrap_fs_search(const char* p, fs_match_t* b, int c, uint32_t* cur) { return sys_fs_search(p, b, c, cur); }
 static char g_launch_args[256] = {0};
 void sys_set_launch_args(const char* args) { if(args) strncpy(g_launch_args, args, 255); else g_launch_args[0]=0; }
 int wrap_exec_with_args(const char* p, const char* a) { sys_set_launch_args(a); return wrap_exec(p); }
@@ -189,12 +194,14 @@ void wrap_set_menu(win_handle_t w, menu_def_t* m, int c, menu_cb_t cb) {
         for(int k=0; k<m[i].item_count; k++) strncpy(win->menus[i].items[k].label, m[i].items[k].label, 15);
     }
 }
+void wrap_set_close(win_handle_t w, close_cb_t cb) { window_t* win=(window_t*)w; if(win) win->close_callback=(void*)cb; }
 
 // Process events during long operations (like HTTP requests)
 // This keeps the UI responsive by polling network and updating display
 void wrap_process_events() {
     extern void rtl8139_poll();
     rtl8139_poll();  // Poll network card
+    aio_pump();      // Keep async file I/O moving during the long operation
     
     // Redraw the active window completely
     if (active_win && active_win->paint_callback) {
@@ -234,7 +241,14 @@ kernel_api_t g_kernel_api = {
     .send = wrap_send, .recvfrom = wrap_recvfrom, .recv = wrap_recv, .close = wrap_close,
     .net_get_interface_info = wrap_net_get_if_info, .dns_resolve = wrap_dns_resolve,
     .http_get = http_get_simple,
-    .process_events = wrap_process_events
+    .process_events = wrap_process_events,
+    .aio_create = aio_create, .aio_destroy = aio_destroy, .aio_submit = aio_submit,
+    .fs_mmap = mmap_file, .fs_msync = mmap_sync, .fs_munmap = mmap_unmap,
+    .fs_watch_add = fswatch_add, .fs_watch_read = fswatch_read, .fs_watch_remove = fswatch_remove,
+    .fs_readdir = wrap_fs_readdir,
+    .fs_set_compressed = sys_fs_set_compressed,
+    .fs_search = wrap_fs_search,
+    .set_window_close = wrap_set_close
 };
 
 // ... (ELF Loader implementation remains the same) ...
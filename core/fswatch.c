@@ -0,0 +1,136 @@
+// core/fswatch.c - Per-directory file-change events for CDL apps and the desktop
+//
+// sys_fs_* post an event after each change that succeeds. Events go to
+// the watches on the changed entry's parent directory and wait in a
+// small ring until the owner reads them from its paint or frame loop.
+
+#include "fswatch.h"
+#include "memory.h"
+#include "string.h"
+
+typedef struct {
+    int active;
+    char dir[128];          // No trailing slash, except for "/"
+    uint32_t len;
+    fs_event_t* events;     // FSWATCH_QUEUE entries
+    uint32_t head;          // Oldest unread
+    uint32_t count;
+    int overflow;           // Queue was dropped; report before anything newer
+} fswatch_t;
+
+static fswatch_t watches[FSWATCH_MAX];
+static int watch_count = 0;
+static uint32_t next_cookie = 0;
+
+// Length of the directory part of `path` ("/a/b" -> 2, "/b" -> 1) and
+// where its last name starts; -1 if there is no slash
+static int split_path(const char* path, uint32_t len, const char** name) {
+    int slash = -1;
+    for (uint32_t i = 0; i < len; i++) if (path[i] == '/') slash = i;
+    if (slash < 0) return -1;
+    *name = path + slash + 1;
+    return slash ? slash : 1;
+}
+
+// Path length without trailing slashes (root stays "/")
+static uint32_t trimmed_len(const char* path) {
+    uint32_t len = strlen(path);
+    while (len > 1 && path[len - 1] == '/') len--;
+    return len;
+}
+
+static fswatch_t* watch_get(int wd) {
+    if (wd < 0 || wd >= FSWATCH_MAX || !watches[wd].active) return 0;
+    return &watches[wd];
+}
+
+int fswatch_add(const char* dir) {
+    if (!dir || dir[0] != '/') return PFS_ERR_PARAM;
+    uint32_t len = trimmed_len(dir);
+    if (len >= sizeof(watches[0].dir)) return PFS_ERR_PARAM;
+
+    for (int i = 0; i < FSWATCH_MAX; i++) {
+        fswatch_t* w = &watches[i];
+        if (w->active) continue;
+        w->events = (fs_event_t*)kzalloc(FSWATCH_QUEUE * sizeof(fs_event_t));
+        if (!w->events) return PFS_ERR_FULL;
+        memcpy(w->dir, dir, len);
+        w->dir[len] = 0;
+        w->len = len;
+        w->head = w->count = 0;
+        w->overflow = 0;
+        w->active = 1;
+        watch_count++;
+        return i;
+    }
+    return PFS_ERR_FULL;
+}
+
+void fswatch_remove(int wd) {
+    fswatch_t* w = watch_get(wd);
+    if (!w) return;
+    kfree(w->events);
+    w->events = 0;
+    w->active = 0;
+    watch_count--;
+}
+
+int fswatch_read(int wd, fs_event_t* out, int max) {
+    fswatch_t* w = watch_get(wd);
+    if (!w || !out) return PFS_ERR_PARAM;
+    int n = 0;
+    if (w->overflow && n < max) {
+        memset(&out[n], 0, sizeof(fs_event_t));
+        out[n++].mask = FS_EVENT_OVERFLOW;
+        w->overflow = 0;
+    }
+    while (w->count && n < max) {
+        out[n++] = w->events[w->head];
+        w->head = (w->head + 1) % FSWATCH_QUEUE;
+        w->count--;
+    }
+    return n;
+}
+
+// The watch on the directory that holds `path`, starting after `from`
+static fswatch_t* watch_next(fswatch_t* from, const char* path, uint32_t len, const char** name) {
+    int dir_len = split_path(path, len, name);
+    if (dir_len < 0) return 0;
+    for (fswatch_t* w = from ? from + 1 : watches; w < watches + FSWATCH_MAX; w++) {
+        if (w->active && w->len == (uint32_t)dir_len && strncmp(w->dir, path, dir_len) == 0) return w;
+    }
+    return 0;
+}
+
+int fswatch_watched(const char* path) {
+    const char* name;
+    if (!watch_count || !path) return 0;
+    return watch_next(0, path, trimmed_len(path), &name) != 0;
+}
+
+void fswatch_post(uint32_t mask, const char* path, const pfs32_direntry_t* entry, uint32_t cookie) {
+    if (!watch_count || !path) return;
+    uint32_t len = trimmed_len(path);
+    const char* name;
+    for (fswatch_t* w = watch_next(0, path, len, &name); w; w = watch_next(w, path, len, &name)) {
+        if (w->count == FSWATCH_QUEUE) {
+            // The reader lists the directory again, so nothing queued matters
+            w->head = w->count = 0;
+            w->overflow = 1;
+        }
+        fs_event_t* ev = &w->events[(w->head + w->count++) % FSWATCH_QUEUE];
+        memset(ev, 0, sizeof(*ev));
+        ev->mask = mask;
+        ev->cookie = cookie;
+        if (entry) memcpy(ev->entry, entry, sizeof(pfs32_direntry_t));
+        pfs32_direntry_t* e = (pfs32_direntry_t*)ev->entry;
+        uint32_t n = (path + len) - name;
+        if (n >= sizeof(e->filename)) n = sizeof(e->filename) - 1;
+        memcpy(e->filename, name, n);
+        e->filename[n] = 0;
+    }
+}
+
+uint32_t fswatch_cookie(void) {
+    return ++next_cookie;
+}
@@ -0,0 +1,25 @@
+// core/fswatch.h - Per-directory file-change events for CDL apps and the desktop
+#ifndef FSWATCH_H
+#define FSWATCH_H
+
+#include "../sys/cdl_defs.h"
+#include "../fs/pfs32.h"
+
+#define FSWATCH_MAX    16      // Watches across all apps
+#define FSWATCH_QUEUE  32      // Unread events kept per watch
+
+int fswatch_add(const char* dir);
+int fswatch_read(int wd, fs_event_t* out, int max);
+void fswatch_remove(int wd);
+
+// Is anyone watching the directory that holds `path`? Lets the caller
+// skip looking the entry up when nobody will see the event.
+int fswatch_watched(const char* path);
+
+// Queue `mask` for the entry at `path` on every watch of its directory.
+// `entry` may be 0 (deleted or renamed away); the name is filled in.
+void fswatch_post(uint32_t mask, const char* path, const pfs32_direntry_t* entry, uint32_t cookie);
+
+uint32_t fswatch_cookie(void); // Fresh value to pair rename halves
+
+#endif
@@ -0,0 +1,245 @@
+// core/mmap.c - Demand-paged file mappings for CDL apps
+//
+// A mapping only reserves address space in the MMAP_BASE window. The
+// first touch of a page faults; the hook reads that page through the
+// file's PFS32 handle (so the block cache and readahead apply) into a
+// frame from a small pool and maps it. The CPU's dirty bit records
+// stores, so msync/munmap write back only pages that changed. When the
+// pool is used up, a clock sweep reclaims frames not touched recently.
+//
+// The fault is handled on the faulting code's stack, possibly in the
+// middle of a filesystem call: apps must not hand mapped memory to the
+// fs_* calls, only read and write it directly.
+
+#include "mmap.h"
+#include "memory.h"
+#include "string.h"
+#include "../fs/pfs32.h"
+#include "../hal/cpu/paging.h"
+
+typedef struct {
+    int active;
+    uint32_t base;          // First virtual address
+    uint32_t pages;
+    uint32_t len;           // Bytes of the file covered
+    uint32_t offset;        // File offset of base
+    int handle;             // PFS32 handle held for the mapping's lifetime
+    int flags;
+} mmap_region_t;
+
+static mmap_region_t regions[MMAP_MAX_REGIONS];
+static uint32_t frame_addr[MMAP_MAX_FRAMES];    // Page-aligned frame (identity mapped)
+static uint32_t frame_page[MMAP_MAX_FRAMES];    // Virtual page it backs, 0 = free
+static uint32_t frame_count = 0;
+static uint32_t frame_hand = 0;                 // Clock hand
+static int hook_installed = 0;
+static mmap_stats_t stats;
+
+static mmap_region_t* region_for(uint32_t addr) {
+    for (int i = 0; i < MMAP_MAX_REGIONS; i++) {
+        mmap_region_t* r = &regions[i];
+        if (r->active && addr >= r->base && addr - r->base < r->pages * MMAP_PAGE) return r;
+    }
+    return 0;
+}
+
+// Lowest free range of `pages` in the window. Every mapping is followed
+// by an unmapped guard page so running off its end still faults.
+static uint32_t va_alloc(uint32_t pages) {
+    uint32_t span = (pages + 1) * MMAP_PAGE;
+    uint32_t addr = MMAP_BASE;
+    int moved = 1;
+    while (moved) {
+        moved = 0;
+        for (int i = 0; i < MMAP_MAX_REGIONS; i++) {
+            mmap_region_t* r = &regions[i];
+            if (!r->active) continue;
+            uint32_t end = r->base + (r->pages + 1) * MMAP_PAGE;
+            if (addr < end && r->base < addr + span) {
+                addr = end;
+                moved = 1;
+            }
+        }
+        if (addr - MMAP_BASE > MMAP_WINDOW - span) return 0;
+    }
+    return addr;
+}
+
+// Bytes of the file behind the page at `page`
+static uint32_t page_bytes(mmap_region_t* r, uint32_t page) {
+    uint32_t rel = page - r->base;
+    return r->len - rel < MMAP_PAGE ? r->len - rel : MMAP_PAGE;
+}
+
+// Write a resident page to its file if the CPU marked it dirty
+static int page_writeback(mmap_region_t* r, uint32_t page, uint32_t* pte) {
+    if (!(*pte & PAGING_FLAG_PRESENT) || !(*pte & PAGING_FLAG_DIRTY)) return PFS_OK;
+    *pte &= ~PAGING_FLAG_DIRTY;
+    paging_flush_page(page);
+    if (!(r->flags & MMAP_WRITE)) return PFS_OK; // Private scribbles are dropped
+
+    int res = pfs32_pwrite(r->handle, (void*)(*pte & 0xFFFFF000), page_bytes(r, page),
+                           r->offset + (page - r->base));
+    if (res < 0) {
+        *pte |= PAGING_FLAG_DIRTY;
+        return res;
+    }
+    stats.writebacks++;
+    return PFS_OK;
+}
+
+static void frame_release(uint32_t f) {
+    uint32_t* pte = paging_get_pte(frame_page[f], 0);
+    if (pte) *pte = 0;
+    paging_flush_page(frame_page[f]);
+    frame_page[f] = 0;
+}
+
+// A free frame: unused, newly taken from the heap, or reclaimed by the
+// clock. Returns -1 if every resident page is dirty and cannot be written.
+static int frame_get(void) {
+    for (uint32_t i = 0; i < frame_count; i++) {
+        if (!frame_page[i]) return i;
+    }
+
+    if (frame_count + MMAP_CHUNK_FRAMES <= MMAP_MAX_FRAMES) {
+        // One extra page of slack to align the chunk; never freed
+        uint32_t raw = (uint32_t)kmalloc((MMAP_CHUNK_FRAMES + 1) * MMAP_PAGE);
+        if (raw) {
+            uint32_t first = frame_count;
+            uint32_t a = (raw + MMAP_PAGE - 1) & ~(MMAP_PAGE - 1);
+            for (int k = 0; k < MMAP_CHUNK_FRAMES; k++) {
+                frame_addr[frame_count] = a + k * MMAP_PAGE;
+                frame_page[frame_count++] = 0;
+            }
+            return first;
+        }
+    }
+
+    // Second chance: a page accessed since the hand last passed is kept
+    for (uint32_t n = 0; n < 2 * frame_count; n++) {
+        uint32_t i = frame_hand;
+        frame_hand = (frame_hand + 1) % frame_count;
+        uint32_t page = frame_page[i];
+        mmap_region_t* r = region_for(page);
+        uint32_t* pte = paging_get_pte(page, 0);
+        if (!r || !pte) continue;
+        if (*pte & PAGING_FLAG_ACCESSED) {
+            *pte &= ~PAGING_FLAG_ACCESSED;
+            paging_flush_page(page);
+            continue;
+        }
+        if (page_writeback(r, page, pte) != PFS_OK) continue;
+        frame_release(i);
+        stats.evictions++;
+        return i;
+    }
+    return -1;
+}
+
+// Page fault hook: read in the touched page of a mapping
+static int mmap_fault(uint32_t addr, uint32_t err_code) {
+    if (err_code & 0x1) return 0; // Protection fault on a present page
+    mmap_region_t* r = region_for(addr);
+    if (!r) return 0;
+    uint32_t page = addr & ~(MMAP_PAGE - 1);
+    uint32_t* pte = paging_get_pte(page, 0);
+    if (!pte) return 0;
+
+    int f = frame_get();
+    if (f < 0) return 0;
+    uint8_t* mem = (uint8_t*)frame_addr[f];
+    int got = pfs32_pread(r->handle, mem, page_bytes(r, page), r->offset + (page - r->base));
+    if (got < 0) return 0; // The page cannot be produced: fatal, like SIGBUS
+    memset(mem + got, 0, MMAP_PAGE - got);
+
+    frame_page[f] = page;
+    *pte = (uint32_t)mem | PAGING_FLAG_PRESENT | PAGING_FLAG_RW | PAGING_FLAG_USER;
+    paging_flush_page(page);
+    stats.faults++;
+    return 1;
+}
+
+void* mmap_file(const char* path, uint32_t offset, uint32_t* len, int flags) {
+    if (!path || !len || (offset & (MMAP_PAGE - 1)) || !(flags & (MMAP_READ | MMAP_WRITE))) return 0;
+
+    pfs32_direntry_t e;
+    if (pfs32_stat(path, &e) != PFS_OK || (e.attributes & PFS32_ATTR_DIRECTORY)) return 0;
+    uint32_t want = *len;
+    if (!(flags & MMAP_WRITE) || !want) {
+        // Only a writable mapping may reach past the end; stores there
+        // grow the file when they are written back
+        if (offset >= e.file_size) return 0;
+        if (!want || want > e.file_size - offset) want = e.file_size - offset;
+    }
+    if (want > MMAP_WINDOW / 2) return 0;
+    uint32_t pages = (want + MMAP_PAGE - 1) / MMAP_PAGE;
+
+    mmap_region_t* r = 0;
+    for (int i = 0; i < MMAP_MAX_REGIONS && !r; i++) {
+        if (!regions[i].active) r = &regions[i];
+    }
+    if (!r) return 0;
+    uint32_t base = va_alloc(pages);
+    if (!base) return 0;
+
+    // Page tables are created now so the fault path never allocates them
+    uint32_t end = base + pages * MMAP_PAGE;
+    for (uint32_t a = base; a < end; a = (a & ~0x3FFFFF) + 0x400000) {
+        if (!paging_get_pte(a, 1)) return 0;
+    }
+
+    int h = pfs32_open(path, (flags & MMAP_WRITE) ? 1 : 0);
+    if (h < 0) return 0;
+    if (!hook_installed) {
+        paging_set_fault_hook(mmap_fault);
+        hook_installed = 1;
+    }
+
+    r->active = 1;
+    r->base = base;
+    r->pages = pages;
+    r->len = want;
+    r->offset = offset;
+    r->handle = h;
+    r->flags = flags;
+    *len = want;
+    return (void*)base;
+}
+
+// Write back the dirty resident pages of [addr, addr+len). Only resident
+// frames are visited, however large the mapping is.
+int mmap_sync(void* addr, uint32_t len) {
+    mmap_region_t* r = region_for((uint32_t)addr);
+    if (!r) return PFS_ERR_PARAM;
+    uint32_t from = (uint32_t)addr & ~(MMAP_PAGE - 1);
+    uint32_t to = r->base + r->pages * MMAP_PAGE;
+    if (len && len < to - (uint32_t)addr) to = (uint32_t)addr + len;
+
+    int res = PFS_OK;
+    for (uint32_t i = 0; i < frame_count; i++) {
+        uint32_t page = frame_page[i];
+        if (!page || page < from || page >= to) continue;
+        uint32_t* pte = paging_get_pte(page, 0);
+        if (pte && page_writeback(r, page, pte) != PFS_OK) res = PFS_ERR_IO;
+    }
+    return res;
+}
+
+int mmap_unmap(void* addr) {
+    mmap_region_t* r = region_for((uint32_t)addr);
+    if (!r || r->base != (uint32_t)addr) return PFS_ERR_PARAM;
+    int res = mmap_sync(addr, 0);
+
+    uint32_t end = r->base + r->pages * MMAP_PAGE;
+    for (uint32_t i = 0; i < frame_count; i++) {
+        if (frame_page[i] && frame_page[i] >= r->base && frame_page[i] < end) frame_release(i);
+    }
+    pfs32_close(r->handle);
+    r->active = 0;
+    return res;
+}
+
+void mmap_get_stats(mmap_stats_t* out) {
+    if (out) *out = stats;
+}
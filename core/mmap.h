@@ -0,0 +1,26 @@
+// core/mmap.h - Demand-paged file mappings for CDL apps
+#ifndef MMAP_H
+#define MMAP_H
+
+#include "../sys/cdl_defs.h"
+
+#define MMAP_BASE          0xB0000000   // Virtual window, above the identity map
+#define MMAP_WINDOW        0x10000000   // 256 MB of address space
+#define MMAP_PAGE          4096
+#define MMAP_MAX_REGIONS   32
+#define MMAP_MAX_FRAMES    1024         // 4 MB resident across all mappings
+#define MMAP_CHUNK_FRAMES  64           // Frames taken from the heap at a time
+
+void* mmap_file(const char* path, uint32_t offset, uint32_t* len, int flags);
+int mmap_sync(void* addr, uint32_t len);
+int mmap_unmap(void* addr);
+
+typedef struct {
+    uint32_t faults;      // Pages read in on first touch
+    uint32_t evictions;   // Frames reclaimed from another page
+    uint32_t writebacks;  // Dirty pages written to their file
+} mmap_stats_t;
+
+void mmap_get_stats(mmap_stats_t* out);
+
+#endif
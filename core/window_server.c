@@ -94,6 +94,11 @@ window_t* ws_create_window(const char* title, int w, int h,
 
 void ws_destroy_window(window_t* win) {
     if(win && win->is_active) {
+        if(win->close_callback) {
+            void (*cb)(void) = (void (*)(void))win->close_callback;
+            win->close_callback = 0;
+            cb();
+        }
         z_remove(win);
         win->is_active = 0;
     }
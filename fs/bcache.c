@@ -0,0 +1,219 @@
+// fs/bcache.c - Data block cache (hashed, LRU)
+#include "bcache.h"
+#include "disk.h"
+#include "memory.h"
+#include "string.h"
+
+#define BC_NONE (-1)
+#define BC_EMPTY 0xFFFFFFFF
+
+static uint8_t* bc_data = 0;                 // BCACHE_BLOCKS * 512, allocated on first use
+static uint32_t bc_block[BCACHE_BLOCKS];
+static int bc_hash_head[BCACHE_HASH_SIZE];
+static int bc_hash_next[BCACHE_BLOCKS];
+static int bc_lru_prev[BCACHE_BLOCKS];       // Towards most recently used
+static int bc_lru_next[BCACHE_BLOCKS];       // Towards least recently used
+static int bc_lru_head = BC_NONE;
+static int bc_lru_tail = BC_NONE;
+static uint8_t bc_dirty[BCACHE_BLOCKS];      // Newer than the disk copy
+static uint32_t bc_ndirty = 0;
+static bcache_stats_t bc_stats;
+
+static inline uint32_t bc_hash(uint32_t blk) {
+    return (blk * 2654435761u) & (BCACHE_HASH_SIZE - 1);
+}
+
+static void bc_lru_unlink(int s) {
+    if (bc_lru_prev[s] != BC_NONE) bc_lru_next[bc_lru_prev[s]] = bc_lru_next[s];
+    else bc_lru_head = bc_lru_next[s];
+    if (bc_lru_next[s] != BC_NONE) bc_lru_prev[bc_lru_next[s]] = bc_lru_prev[s];
+    else bc_lru_tail = bc_lru_prev[s];
+}
+
+static void bc_lru_push_front(int s) {
+    bc_lru_prev[s] = BC_NONE;
+    bc_lru_next[s] = bc_lru_head;
+    if (bc_lru_head != BC_NONE) bc_lru_prev[bc_lru_head] = s;
+    bc_lru_head = s;
+    if (bc_lru_tail == BC_NONE) bc_lru_tail = s;
+}
+
+static void bc_hash_remove(int s) {
+    int* link = &bc_hash_head[bc_hash(bc_block[s])];
+    while (*link != BC_NONE) {
+        if (*link == s) { *link = bc_hash_next[s]; return; }
+        link = &bc_hash_next[*link];
+    }
+}
+
+static int bc_init(void) {
+    if (bc_data) return 1;
+    bc_data = (uint8_t*)kmalloc(BCACHE_BLOCKS * 512);
+    if (!bc_data) return 0;
+    for (int i = 0; i < BCACHE_HASH_SIZE; i++) bc_hash_head[i] = BC_NONE;
+    bc_lru_head = bc_lru_tail = BC_NONE;
+    for (int i = 0; i < BCACHE_BLOCKS; i++) {
+        bc_block[i] = BC_EMPTY;
+        bc_hash_next[i] = BC_NONE;
+        bc_dirty[i] = 0;
+        bc_lru_push_front(i);
+    }
+    bc_ndirty = 0;
+    return 1;
+}
+
+static int bc_find(uint32_t blk) {
+    if (!bc_data) return BC_NONE;
+    for (int s = bc_hash_head[bc_hash(blk)]; s != BC_NONE; s = bc_hash_next[s]) {
+        if (bc_block[s] == blk) return s;
+    }
+    return BC_NONE;
+}
+
+// Least recently used slot that can be recycled. Dirty slots are never
+// evicted; bcache_write caps them well below the cache size.
+static int bc_victim(void) {
+    int s = bc_lru_tail;
+    while (s != BC_NONE && bc_dirty[s]) s = bc_lru_prev[s];
+    return s;
+}
+
+// Slot for `blk`, recycling a clean one if it is not cached
+static int bc_get_slot(uint32_t blk) {
+    int s = bc_find(blk);
+    if (s != BC_NONE) return s;
+    s = bc_victim();
+    if (s == BC_NONE) return BC_NONE;
+    if (bc_block[s] != BC_EMPTY) bc_hash_remove(s);
+    bc_block[s] = blk;
+    uint32_t h = bc_hash(blk);
+    bc_hash_next[s] = bc_hash_head[h];
+    bc_hash_head[h] = s;
+    return s;
+}
+
+int bcache_lookup(uint32_t blk, void* out) {
+    int s = bc_find(blk);
+    if (s == BC_NONE) { bc_stats.misses++; return 0; }
+    memcpy(out, bc_data + s * 512, 512);
+    if (bc_lru_head != s) { bc_lru_unlink(s); bc_lru_push_front(s); }
+    bc_stats.hits++;
+    return 1;
+}
+
+int bcache_contains(uint32_t blk) {
+    return bc_find(blk) != BC_NONE;
+}
+
+void bcache_fill(uint32_t blk, uint32_t count, const void* data) {
+    if (!bc_init()) return;
+    const uint8_t* src = (const uint8_t*)data;
+    for (uint32_t i = 0; i < count; i++, src += 512) {
+        int s = bc_get_slot(blk + i);
+        if (s == BC_NONE) return;
+        // A dirty copy is newer than what was read from disk
+        if (!bc_dirty[s]) memcpy(bc_data + s * 512, src, 512);
+        if (bc_lru_head != s) { bc_lru_unlink(s); bc_lru_push_front(s); }
+        bc_stats.fills++;
+    }
+}
+
+int bcache_write(uint32_t blk, const void* data) {
+    if (!bc_init()) return 0;
+    int s = bc_find(blk);
+    if (s == BC_NONE || !bc_dirty[s]) {
+        if (bc_ndirty >= BCACHE_DIRTY_MAX) return 0;
+        s = bc_get_slot(blk);
+        if (s == BC_NONE) return 0;
+        bc_dirty[s] = 1;
+        bc_ndirty++;
+    }
+    memcpy(bc_data + s * 512, data, 512);
+    if (bc_lru_head != s) { bc_lru_unlink(s); bc_lru_push_front(s); }
+    return 1;
+}
+
+uint32_t bcache_dirty_count(void) {
+    return bc_ndirty;
+}
+
+int bcache_is_dirty(uint32_t blk) {
+    if (!bc_ndirty) return 0;
+    int s = bc_find(blk);
+    return s != BC_NONE && bc_dirty[s];
+}
+
+void bcache_overlay_dirty(uint32_t blk, uint32_t count, void* buf) {
+    if (!bc_ndirty) return;
+    uint8_t* dst = (uint8_t*)buf;
+    for (uint32_t i = 0; i < count; i++, dst += 512) {
+        int s = bc_find(blk + i);
+        if (s != BC_NONE && bc_dirty[s]) memcpy(dst, bc_data + s * 512, 512);
+    }
+}
+
+// Queue every dirty block and unplug once; the elevator writes them in
+// LBA order, merging neighbours. Slots stay dirty if the write fails.
+int bcache_writeback(void) {
+    if (!bc_ndirty) return 0;
+    blkdev_t* dev = disk_get_device();
+    if (!dev) return -1;
+
+    int failed = 0;
+    for (int s = 0; s < BCACHE_BLOCKS; s++) {
+        if (!bc_dirty[s]) continue;
+        if (blkdev_queue(dev, bc_block[s], 1, bc_data + s * 512, 1) != 0) { failed = 1; break; }
+    }
+    if (blkdev_unplug(dev) != 0 || failed) return -1;
+
+    for (int s = 0; s < BCACHE_BLOCKS; s++) {
+        if (bc_dirty[s]) { bc_dirty[s] = 0; bc_stats.writebacks++; }
+    }
+    bc_ndirty = 0;
+    return 0;
+}
+
+void bcache_update(uint32_t blk, uint32_t count, const void* data) {
+    if (!bc_data) return;
+    const uint8_t* src = (const uint8_t*)data;
+    for (uint32_t i = 0; i < count; i++, src += 512) {
+        int s = bc_find(blk + i);
+        if (s == BC_NONE) continue;
+        if (bc_data + s * 512 != src) memcpy(bc_data + s * 512, src, 512);
+        // The disk now has this version
+        if (bc_dirty[s]) { bc_dirty[s] = 0; bc_ndirty--; }
+    }
+}
+
+void bcache_invalidate(uint32_t blk, uint32_t count) {
+    if (!bc_data) return;
+    for (uint32_t i = 0; i < count; i++) {
+        int s = bc_find(blk + i);
+        if (s == BC_NONE) continue;
+        bc_hash_remove(s);
+        bc_block[s] = BC_EMPTY;
+        if (bc_dirty[s]) { bc_dirty[s] = 0; bc_ndirty--; }
+        // Free slots are reused first
+        bc_lru_unlink(s);
+        bc_lru_next[s] = BC_NONE;
+        bc_lru_prev[s] = bc_lru_tail;
+        if (bc_lru_tail != BC_NONE) bc_lru_next[bc_lru_tail] = s;
+        bc_lru_tail = s;
+        if (bc_lru_head == BC_NONE) bc_lru_head = s;
+    }
+}
+
+void bcache_invalidate_all(void) {
+    if (!bc_data) return;
+    for (int i = 0; i < BCACHE_HASH_SIZE; i++) bc_hash_head[i] = BC_NONE;
+    for (int i = 0; i < BCACHE_BLOCKS; i++) {
+        bc_block[i] = BC_EMPTY;
+        bc_hash_next[i] = BC_NONE;
+        bc_dirty[i] = 0;
+    }
+    bc_ndirty = 0;
+}
+
+void bcache_get_stats(bcache_stats_t* out) {
+    if (out) *out = bc_stats;
+}
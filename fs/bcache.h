@@ -0,0 +1,51 @@
+// fs/bcache.h - Data block cache (absolute disk block numbers)
+// Recently read blocks, filled by readahead, plus dirty blocks held for
+// write-back. fs/disk.c keeps it coherent: every write updates any cached
+// copy and every read sees dirty data.
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "../include/types.h"
+
+#define BCACHE_BLOCKS    1024   // 512 KB
+#define BCACHE_HASH_SIZE 2048   // Power of two
+#define BCACHE_DIRTY_MAX 256    // Dirty blocks held before bcache_write refuses
+
+// Copy block `blk` into `out` if cached. Returns 1 on a hit.
+int bcache_lookup(uint32_t blk, void* out);
+
+// Is block `blk` cached? (no LRU update)
+int bcache_contains(uint32_t blk);
+
+// Insert `count` consecutive blocks read from disk
+void bcache_fill(uint32_t blk, uint32_t count, const void* data);
+
+// A write went to disk: refresh cached copies in the range
+void bcache_update(uint32_t blk, uint32_t count, const void* data);
+
+// Store a newer version of `blk` to be written back later. Returns 0 if
+// the dirty limit is reached; the caller must write back or write through.
+int bcache_write(uint32_t blk, const void* data);
+uint32_t bcache_dirty_count(void);
+int bcache_is_dirty(uint32_t blk);
+
+// Copy dirty cached blocks over `count` blocks just read from disk
+void bcache_overlay_dirty(uint32_t blk, uint32_t count, void* buf);
+
+// Write all dirty blocks to the active disk in LBA order. 0 on success.
+int bcache_writeback(void);
+
+// Forget the range (dirty data included) (e.g. the device changed)
+void bcache_invalidate(uint32_t blk, uint32_t count);
+void bcache_invalidate_all(void);
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t fills;       // Blocks inserted (readahead + demand)
+    uint32_t writebacks;  // Dirty blocks written back
+} bcache_stats_t;
+
+void bcache_get_stats(bcache_stats_t* out);
+
+#endif
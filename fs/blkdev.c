@@ -0,0 +1,253 @@
+// fs/blkdev.c - Generic block device layer with a merging elevator
+#include "blkdev.h"
+#include "memory.h"
+#include "string.h"
+
+static blkdev_t* devices[BLKDEV_MAX_DEVICES];
+static int device_count = 0;
+
+static bio_t bio_pool[BLKDEV_POOL_SIZE];
+static bio_t* bio_free = 0;
+static int pool_ready = 0;
+
+static void pool_init(void) {
+    if (pool_ready) return;
+    for (int i = 0; i < BLKDEV_POOL_SIZE; i++) {
+        bio_pool[i].next = bio_free;
+        bio_free = &bio_pool[i];
+    }
+    pool_ready = 1;
+}
+
+static bio_t* bio_alloc(void) {
+    pool_init();
+    bio_t* b = bio_free;
+    if (b) bio_free = b->next;
+    return b;
+}
+
+static void bio_release(bio_t* b) {
+    b->next = bio_free;
+    bio_free = b;
+}
+
+// --- Registry ---
+
+int blkdev_register(blkdev_t* dev) {
+    if (!dev || !dev->rw || dev->max_transfer == 0) return -1;
+    for (int i = 0; i < device_count; i++) {
+        if (devices[i] == dev) return 0;
+        if (strcmp(devices[i]->name, dev->name) == 0) {
+            devices[i] = dev; // Driver re-probed with a new descriptor
+            return 0;
+        }
+    }
+    if (device_count >= BLKDEV_MAX_DEVICES) return -1;
+
+    dev->queue = 0;
+    dev->head_pos = 0;
+    if (!dev->bounce) dev->bounce = (uint8_t*)kmalloc(BLKDEV_BOUNCE_BLOCKS * BLKDEV_BLOCK_SIZE);
+    devices[device_count++] = dev;
+    return 0;
+}
+
+blkdev_t* blkdev_get(const char* name) {
+    for (int i = 0; i < device_count; i++) {
+        if (strcmp(devices[i]->name, name) == 0) return devices[i];
+    }
+    return 0;
+}
+
+int blkdev_count(void) {
+    return device_count;
+}
+
+blkdev_t* blkdev_get_index(int index) {
+    if (index < 0 || index >= device_count) return 0;
+    return devices[index];
+}
+
+// --- Elevator ---
+
+// Try to absorb [lba, lba+count) into a queued bio of the same direction.
+// A merge that leaves more than one segment is capped at the bounce size
+// so dispatch can still issue it as one command.
+static int bio_try_merge(blkdev_t* dev, bio_t* b, uint32_t lba, uint32_t count, uint8_t* buf) {
+    uint32_t total = b->count + count;
+    if (total > dev->max_transfer) return 0;
+
+    if (b->lba + b->count == lba) {
+        blk_seg_t* last = &b->segs[b->nsegs - 1];
+        if (last->buf + last->count * BLKDEV_BLOCK_SIZE == buf) {
+            last->count += count;
+        } else {
+            if (b->nsegs == BIO_MAX_SEGS || !dev->bounce || total > BLKDEV_BOUNCE_BLOCKS) return 0;
+            b->segs[b->nsegs].buf = buf;
+            b->segs[b->nsegs].count = count;
+            b->nsegs++;
+        }
+        b->count = total;
+        return 1;
+    }
+
+    if (lba + count == b->lba) {
+        blk_seg_t* first = &b->segs[0];
+        if (buf + count * BLKDEV_BLOCK_SIZE == first->buf) {
+            first->buf = buf;
+            first->count += count;
+        } else {
+            if (b->nsegs == BIO_MAX_SEGS || !dev->bounce || total > BLKDEV_BOUNCE_BLOCKS) return 0;
+            for (int i = b->nsegs; i > 0; i--) b->segs[i] = b->segs[i - 1];
+            b->segs[0].buf = buf;
+            b->segs[0].count = count;
+            b->nsegs++;
+        }
+        b->lba = lba;
+        b->count = total;
+        return 1;
+    }
+    return 0;
+}
+
+// After a merge grew `b`, it may now touch its successor
+static void bio_merge_next(blkdev_t* dev, bio_t* b) {
+    bio_t* n = b->next;
+    if (!n || n->write != b->write || b->lba + b->count != n->lba) return;
+    if (b->nsegs + n->nsegs > BIO_MAX_SEGS) return;
+    if (b->count + n->count > dev->max_transfer) return;
+    if (b->nsegs + n->nsegs > 1 && (!dev->bounce || b->count + n->count > BLKDEV_BOUNCE_BLOCKS)) return;
+
+    for (int i = 0; i < n->nsegs; i++) b->segs[b->nsegs++] = n->segs[i];
+    b->count += n->count;
+    b->next = n->next;
+    bio_release(n);
+    dev->stat_merges++;
+}
+
+static int queue_one(blkdev_t* dev, uint32_t lba, uint32_t count, uint8_t* buf, int write) {
+    // Requests are reordered freely, so a read or write overlapping a
+    // queued request of which either side is a write must wait for it
+    for (bio_t* b = dev->queue; b; b = b->next) {
+        if (lba < b->lba + b->count && b->lba < lba + count && (write || b->write)) {
+            if (blkdev_unplug(dev) != 0) return -1;
+            break;
+        }
+    }
+
+    bio_t* prev = 0;
+    for (bio_t* b = dev->queue; b; prev = b, b = b->next) {
+        if (b->write == write && bio_try_merge(dev, b, lba, count, buf)) {
+            dev->stat_merges++;
+            bio_merge_next(dev, b);
+            if (prev) bio_merge_next(dev, prev);
+            return 0;
+        }
+    }
+
+    bio_t* nb = bio_alloc();
+    if (!nb) {
+        if (blkdev_unplug(dev) != 0) return -1;
+        nb = bio_alloc();
+        if (!nb) {
+            // Other devices hold the pool
+            for (int i = 0; i < device_count; i++) blkdev_unplug(devices[i]);
+            nb = bio_alloc();
+            if (!nb) return -1;
+        }
+    }
+    nb->lba = lba;
+    nb->count = count;
+    nb->write = write;
+    nb->nsegs = 1;
+    nb->segs[0].buf = buf;
+    nb->segs[0].count = count;
+
+    // Insert sorted by LBA
+    bio_t** link = &dev->queue;
+    while (*link && (*link)->lba < lba) link = &(*link)->next;
+    nb->next = *link;
+    *link = nb;
+    return 0;
+}
+
+int blkdev_queue(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf, int write) {
+    if (!dev || count == 0) return -1;
+    if (lba >= dev->total_blocks || count > dev->total_blocks - lba) return -1;
+    dev->stat_requests++;
+
+    uint8_t* p = (uint8_t*)buf;
+    while (count > 0) {
+        uint32_t n = count > dev->max_transfer ? dev->max_transfer : count;
+        if (queue_one(dev, lba, n, p, write) != 0) return -1;
+        lba += n;
+        p += n * BLKDEV_BLOCK_SIZE;
+        count -= n;
+    }
+    return 0;
+}
+
+static int bio_dispatch(blkdev_t* dev, bio_t* b) {
+    if (b->nsegs == 1) {
+        dev->stat_commands++;
+        return dev->rw(dev, b->lba, b->count, b->segs[0].buf, b->write);
+    }
+
+    // Gather the scatter list through the bounce buffer: one command
+    // instead of one per segment
+    int res;
+    if (b->write) {
+        uint8_t* p = dev->bounce;
+        for (int i = 0; i < b->nsegs; i++) {
+            memcpy(p, b->segs[i].buf, b->segs[i].count * BLKDEV_BLOCK_SIZE);
+            p += b->segs[i].count * BLKDEV_BLOCK_SIZE;
+        }
+        dev->stat_commands++;
+        res = dev->rw(dev, b->lba, b->count, dev->bounce, 1);
+    } else {
+        dev->stat_commands++;
+        res = dev->rw(dev, b->lba, b->count, dev->bounce, 0);
+        if (res == 0) {
+            uint8_t* p = dev->bounce;
+            for (int i = 0; i < b->nsegs; i++) {
+                memcpy(b->segs[i].buf, p, b->segs[i].count * BLKDEV_BLOCK_SIZE);
+                p += b->segs[i].count * BLKDEV_BLOCK_SIZE;
+            }
+        }
+    }
+    return res;
+}
+
+int blkdev_unplug(blkdev_t* dev) {
+    if (!dev) return -1;
+    bio_t* list = dev->queue;
+    dev->queue = 0;
+    if (!list) return 0;
+
+    // One sweep upward from the head position, then wrap to the lowest
+    // LBA (C-LOOK)
+    bio_t* start = list;
+    while (start && start->lba < dev->head_pos) start = start->next;
+
+    int result = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        bio_t* b = pass == 0 ? start : list;
+        while (b && (pass == 0 || b != start)) {
+            bio_t* next = b->next;
+            if (bio_dispatch(dev, b) != 0) result = -1;
+            dev->head_pos = b->lba + b->count;
+            bio_release(b);
+            b = next;
+        }
+    }
+    return result;
+}
+
+int blkdev_read(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf) {
+    if (blkdev_queue(dev, lba, count, buf, 0) != 0) return -1;
+    return blkdev_unplug(dev);
+}
+
+int blkdev_write(blkdev_t* dev, uint32_t lba, uint32_t count, const void* buf) {
+    if (blkdev_queue(dev, lba, count, (void*)buf, 1) != 0) return -1;
+    return blkdev_unplug(dev);
+}
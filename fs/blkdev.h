@@ -0,0 +1,67 @@
+// fs/blkdev.h - Generic block device layer
+// Drivers register a blkdev_t with a single transfer callback. Requests
+// (bios) queue per device; the elevator merges adjacent ones and
+// dispatches them in ascending LBA order starting from the head position.
+#ifndef BLKDEV_H
+#define BLKDEV_H
+
+#include "../include/types.h"
+
+#define BLKDEV_BLOCK_SIZE    512
+#define BLKDEV_MAX_DEVICES   8
+#define BLKDEV_POOL_SIZE     64     // bios shared by all queues
+#define BIO_MAX_SEGS         16     // Scatter list length per bio
+#define BLKDEV_BOUNCE_BLOCKS 256    // Largest merged multi-segment bio
+
+// One piece of a scatter list: `count` blocks at `buf`
+typedef struct {
+    uint8_t* buf;
+    uint32_t count;
+} blk_seg_t;
+
+typedef struct bio {
+    uint32_t lba;
+    uint32_t count;               // Total blocks across all segments
+    int write;
+    int nsegs;
+    blk_seg_t segs[BIO_MAX_SEGS];
+    struct bio* next;             // Queue link (sorted by lba)
+} bio_t;
+
+typedef struct blkdev {
+    char name[16];
+    uint32_t total_blocks;
+    uint32_t max_transfer;        // Blocks per driver call
+    // Driver transfer into/out of one contiguous buffer. 0 = success.
+    int (*rw)(struct blkdev* dev, uint32_t lba, uint32_t count, void* buf, int write);
+    void* priv;                   // Driver data
+
+    // Queue state (owned by blkdev.c)
+    bio_t* queue;
+    uint32_t head_pos;            // LBA after the last dispatched request
+    uint8_t* bounce;              // Gathers multi-segment bios
+
+    // Statistics
+    uint32_t stat_requests;       // Calls to blkdev_queue
+    uint32_t stat_merges;         // Requests absorbed into a queued bio
+    uint32_t stat_commands;       // Driver calls issued
+} blkdev_t;
+
+// Add (or re-add) a device. Name must be unique.
+int blkdev_register(blkdev_t* dev);
+blkdev_t* blkdev_get(const char* name);
+int blkdev_count(void);
+blkdev_t* blkdev_get_index(int index);
+
+// Queue a request without dispatching it. The buffer must stay valid
+// until the next blkdev_unplug on this device. 0 = queued.
+int blkdev_queue(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf, int write);
+
+// Dispatch everything queued on the device. Returns 0 if all succeeded.
+int blkdev_unplug(blkdev_t* dev);
+
+// Synchronous helpers (queue + unplug)
+int blkdev_read(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf);
+int blkdev_write(blkdev_t* dev, uint32_t lba, uint32_t count, const void* buf);
+
+#endif
@@ -0,0 +1,138 @@
+// fs/dcache.c - Path lookup cache (hashed, LRU)
+#include "dcache.h"
+#include "string.h"
+
+#define DC_NONE (-1)
+
+typedef struct {
+    int used;
+    int negative;
+    uint32_t dir;
+    char name[DCACHE_NAME_MAX + 1];
+    uint32_t blk;
+    int idx;
+} dentry_t;
+
+static dentry_t dc_ent[DCACHE_ENTRIES];
+static int dc_hash_head[DCACHE_HASH_SIZE];
+static int dc_hash_next[DCACHE_ENTRIES];
+static int dc_lru_prev[DCACHE_ENTRIES];      // Towards most recently used
+static int dc_lru_next[DCACHE_ENTRIES];      // Towards least recently used
+static int dc_lru_head = DC_NONE;
+static int dc_lru_tail = DC_NONE;
+static int dc_ready = 0;
+static dcache_stats_t dc_stats;
+
+static uint32_t dc_hash(uint32_t dir, const char* name) {
+    uint32_t h = 2166136261u ^ dir;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h & (DCACHE_HASH_SIZE - 1);
+}
+
+static void dc_lru_unlink(int s) {
+    if (dc_lru_prev[s] != DC_NONE) dc_lru_next[dc_lru_prev[s]] = dc_lru_next[s];
+    else dc_lru_head = dc_lru_next[s];
+    if (dc_lru_next[s] != DC_NONE) dc_lru_prev[dc_lru_next[s]] = dc_lru_prev[s];
+    else dc_lru_tail = dc_lru_prev[s];
+}
+
+static void dc_lru_push_front(int s) {
+    dc_lru_prev[s] = DC_NONE;
+    dc_lru_next[s] = dc_lru_head;
+    if (dc_lru_head != DC_NONE) dc_lru_prev[dc_lru_head] = s;
+    dc_lru_head = s;
+    if (dc_lru_tail == DC_NONE) dc_lru_tail = s;
+}
+
+static void dc_lru_push_back(int s) {
+    dc_lru_next[s] = DC_NONE;
+    dc_lru_prev[s] = dc_lru_tail;
+    if (dc_lru_tail != DC_NONE) dc_lru_next[dc_lru_tail] = s;
+    dc_lru_tail = s;
+    if (dc_lru_head == DC_NONE) dc_lru_head = s;
+}
+
+static void dc_hash_remove(int s) {
+    int* link = &dc_hash_head[dc_hash(dc_ent[s].dir, dc_ent[s].name)];
+    while (*link != DC_NONE) {
+        if (*link == s) { *link = dc_hash_next[s]; return; }
+        link = &dc_hash_next[*link];
+    }
+}
+
+void dcache_clear(void) {
+    for (int i = 0; i < DCACHE_HASH_SIZE; i++) dc_hash_head[i] = DC_NONE;
+    dc_lru_head = dc_lru_tail = DC_NONE;
+    for (int i = 0; i < DCACHE_ENTRIES; i++) {
+        dc_ent[i].used = 0;
+        dc_hash_next[i] = DC_NONE;
+        dc_lru_push_front(i);
+    }
+    dc_ready = 1;
+}
+
+static int dc_find(uint32_t dir, const char* name) {
+    if (!dc_ready) return DC_NONE;
+    for (int s = dc_hash_head[dc_hash(dir, name)]; s != DC_NONE; s = dc_hash_next[s]) {
+        if (dc_ent[s].dir == dir && strcmp(dc_ent[s].name, name) == 0) return s;
+    }
+    return DC_NONE;
+}
+
+int dcache_lookup(uint32_t dir, const char* name, uint32_t* blk, int* idx) {
+    int s = dc_find(dir, name);
+    if (s == DC_NONE) { dc_stats.misses++; return DCACHE_MISS; }
+    if (dc_lru_head != s) { dc_lru_unlink(s); dc_lru_push_front(s); }
+    if (dc_ent[s].negative) { dc_stats.negative_hits++; return DCACHE_NEGATIVE; }
+    *blk = dc_ent[s].blk;
+    *idx = dc_ent[s].idx;
+    dc_stats.hits++;
+    return DCACHE_FOUND;
+}
+
+static void dc_store(uint32_t dir, const char* name, int negative, uint32_t blk, int idx) {
+    if (strlen(name) > DCACHE_NAME_MAX) return;
+    if (!dc_ready) dcache_clear();
+
+    int s = dc_find(dir, name);
+    if (s == DC_NONE) {
+        // Recycle the least recently used entry
+        s = dc_lru_tail;
+        if (dc_ent[s].used) dc_hash_remove(s);
+        dc_ent[s].used = 1;
+        dc_ent[s].dir = dir;
+        strcpy(dc_ent[s].name, name);
+        uint32_t h = dc_hash(dir, name);
+        dc_hash_next[s] = dc_hash_head[h];
+        dc_hash_head[h] = s;
+    }
+    dc_ent[s].negative = negative;
+    dc_ent[s].blk = blk;
+    dc_ent[s].idx = idx;
+    if (dc_lru_head != s) { dc_lru_unlink(s); dc_lru_push_front(s); }
+}
+
+void dcache_insert(uint32_t dir, const char* name, uint32_t blk, int idx) {
+    dc_store(dir, name, 0, blk, idx);
+}
+
+void dcache_insert_negative(uint32_t dir, const char* name) {
+    dc_store(dir, name, 1, 0, -1);
+}
+
+void dcache_remove(uint32_t dir, const char* name) {
+    int s = dc_find(dir, name);
+    if (s == DC_NONE) return;
+    dc_hash_remove(s);
+    dc_ent[s].used = 0;
+    // Free entries are reused first
+    dc_lru_unlink(s);
+    dc_lru_push_back(s);
+}
+
+void dcache_get_stats(dcache_stats_t* out) {
+    if (out) *out = dc_stats;
+}
@@ -0,0 +1,38 @@
+// fs/dcache.h - Path lookup cache (hashed, LRU)
+// Maps (directory start block, name) to the location of the entry in
+// the directory chain, or records that the name does not exist.
+// pfs32.c keeps it in step with create, delete and rename.
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include "../include/types.h"
+
+#define DCACHE_ENTRIES   512
+#define DCACHE_HASH_SIZE 1024   // Power of two
+#define DCACHE_NAME_MAX  40     // Longer names are not cached
+
+#define DCACHE_MISS      0
+#define DCACHE_FOUND     1
+#define DCACHE_NEGATIVE  (-1)
+
+// Look up `name` in the directory starting at `dir`. On DCACHE_FOUND the
+// entry is slot *idx of block *blk.
+int dcache_lookup(uint32_t dir, const char* name, uint32_t* blk, int* idx);
+
+// Remember a positive (blk, idx) or negative (DCACHE_NEGATIVE) result
+void dcache_insert(uint32_t dir, const char* name, uint32_t blk, int idx);
+void dcache_insert_negative(uint32_t dir, const char* name);
+
+// Forget one name, or everything (format, mount, directory removal)
+void dcache_remove(uint32_t dir, const char* name);
+void dcache_clear(void);
+
+typedef struct {
+    uint32_t hits;
+    uint32_t negative_hits;
+    uint32_t misses;
+} dcache_stats_t;
+
+void dcache_get_stats(dcache_stats_t* out);
+
+#endif
@@ -1,42 +1,82 @@
 #include "disk.h"
+#include "bcache.h"
 #include "../hal/drivers/ata.h"
 
-// The currently active drive for the Filesystem (0 = Master, 1 = Slave)
-static int fs_drive_id = 0;
+// The block device backing the Filesystem (ata0 by default)
+static blkdev_t* fs_dev = 0;
 
 uint32_t disk_total_blocks = 0;
 
 void disk_init(void) {
-    // Identify master by default
+    if (fs_dev) return;
+
+    // Identify master by default; ATA drives register as ata0/ata1
     ata_identify_device(0);
     if(ide_devices[0].present) {
-        disk_total_blocks = ide_devices[0].sectors;
-        fs_drive_id = 0;
+        disk_set_device(blkdev_get("ata0"));
     } else {
         ata_identify_device(1);
         if(ide_devices[1].present) {
-            disk_total_blocks = ide_devices[1].sectors;
-            fs_drive_id = 1;
+            disk_set_device(blkdev_get("ata1"));
         }
     }
 }
 
 // Allow Installer/Kernel to change the active disk
 void disk_set_drive(int drive_id) {
-    fs_drive_id = drive_id;
-    if(ide_devices[drive_id].present) {
-        disk_total_blocks = ide_devices[drive_id].sectors;
-    } else {
+    if(!ide_devices[drive_id].present) {
         // Probe it just in case
         ata_identify_device(drive_id);
-        disk_total_blocks = ide_devices[drive_id].sectors;
     }
+    disk_set_device(blkdev_get(drive_id ? "ata1" : "ata0"));
+}
+
+void disk_set_device(blkdev_t* dev) {
+    if (fs_dev && fs_dev != dev) blkdev_unplug(fs_dev);
+    if (fs_dev != dev) bcache_invalidate_all();
+    fs_dev = dev;
+    disk_total_blocks = dev ? dev->total_blocks : 0;
 }
 
+blkdev_t* disk_get_device(void) {
+    return fs_dev;
+}
+
+// Reads see dirty blocks still waiting in the cache
 int disk_read_block(uint32_t block, void* buffer) {
-    return ata_read_sector(fs_drive_id, block, (uint8_t*)buffer);
+    if (!fs_dev) return 1;
+    if (blkdev_read(fs_dev, block, 1, buffer) != 0) return 1;
+    bcache_overlay_dirty(block, 1, buffer);
+    return 0;
 }
 
+// Writes keep the block cache coherent by refreshing any cached copy
 int disk_write_block(uint32_t block, const void* buffer) {
-    return ata_write_sector(fs_drive_id, block, (const uint8_t*)buffer);
+    if (!fs_dev) return 1;
+    bcache_update(block, 1, buffer);
+    return blkdev_write(fs_dev, block, 1, buffer) == 0 ? 0 : 1;
+}
+
+int disk_read_blocks(uint32_t block, uint32_t count, void* buffer) {
+    if (!fs_dev) return 1;
+    if (blkdev_read(fs_dev, block, count, buffer) != 0) return 1;
+    bcache_overlay_dirty(block, count, buffer);
+    return 0;
+}
+
+int disk_write_blocks(uint32_t block, uint32_t count, const void* buffer) {
+    if (!fs_dev) return 1;
+    bcache_update(block, count, buffer);
+    return blkdev_write(fs_dev, block, count, buffer) == 0 ? 0 : 1;
+}
+
+int disk_queue_write(uint32_t block, uint32_t count, const void* buffer) {
+    if (!fs_dev) return 1;
+    bcache_update(block, count, buffer);
+    return blkdev_queue(fs_dev, block, count, (void*)buffer, 1) == 0 ? 0 : 1;
+}
+
+int disk_unplug(void) {
+    if (!fs_dev) return 1;
+    return blkdev_unplug(fs_dev) == 0 ? 0 : 1;
 }
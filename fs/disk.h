@@ -11,13 +11,30 @@ typedef signed int int32_t;
 typedef unsigned long long uint64_t;
 typedef signed long long int64_t;
 
+#include "blkdev.h"
+
 #define DISK_BLOCK_SIZE 512
 
 extern uint32_t disk_total_blocks;
 
 void disk_init(void);
 void disk_set_drive(int drive_id);
+
+// Any registered block device (ATA, AHCI, RAM disk) can back the FS
+void disk_set_device(blkdev_t* dev);
+blkdev_t* disk_get_device(void);
+
 int disk_read_block(uint32_t block, void* buffer);
 int disk_write_block(uint32_t block, const void* buffer);
 
+// Multi-block transfers; split by the device's max_transfer
+int disk_read_blocks(uint32_t block, uint32_t count, void* buffer);
+int disk_write_blocks(uint32_t block, uint32_t count, const void* buffer);
+
+// Deferred writes: queued to the elevator (sorted and merged) and issued
+// on disk_unplug() or the next synchronous transfer. The buffer must stay
+// valid until then.
+int disk_queue_write(uint32_t block, uint32_t count, const void* buffer);
+int disk_unplug(void);
+
 #endif
@@ -0,0 +1,135 @@
+// fs/lz4.c - LZ4 block compression for PFS32 compressed files
+#include "lz4.h"
+#include "string.h"
+
+#define LZ4_HASH_BITS     12
+#define LZ4_MIN_MATCH     4
+#define LZ4_LAST_LITERALS 5     // The block always ends with this many literals
+#define LZ4_MF_LIMIT      12    // No match starts this close to the end
+#define LZ4_MAX_OFFSET    65535
+
+// Last position of each 4-byte hash; the filesystem is never entered
+// twice at once, so one table serves every caller
+static uint16_t hash_table[1 << LZ4_HASH_BITS];
+
+static inline uint32_t read32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+// Length field overflow: 255s then the remainder
+static uint8_t* put_len(uint8_t* op, uint32_t n) {
+    while (n >= 255) { *op++ = 255; n -= 255; }
+    *op++ = (uint8_t)n;
+    return op;
+}
+
+// One sequence: literals then (unless `mlen` is 0) a match
+static uint8_t* put_seq(uint8_t* op, uint8_t* oend, const uint8_t* lit, uint32_t nlit, uint32_t off, uint32_t mlen) {
+    uint32_t need = 1 + nlit + nlit / 255 + 1 + (mlen ? 2 + mlen / 255 + 1 : 0);
+    if (need > (uint32_t)(oend - op)) return 0;
+
+    uint32_t ml = mlen ? mlen - LZ4_MIN_MATCH : 0;
+    uint8_t* token = op++;
+    *token = (uint8_t)(((nlit < 15 ? nlit : 15) << 4) | (ml < 15 ? ml : 15));
+    if (nlit >= 15) op = put_len(op, nlit - 15);
+    memcpy(op, lit, nlit);
+    op += nlit;
+    if (!mlen) return op;
+
+    *op++ = (uint8_t)off;
+    *op++ = (uint8_t)(off >> 8);
+    if (ml >= 15) op = put_len(op, ml - 15);
+    return op;
+}
+
+// Greedy single-pass matcher; the step grows over incompressible data
+// so it is skipped quickly
+uint32_t lz4_compress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t cap) {
+    if (len > LZ4_MAX_INPUT) return 0;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + cap;
+    uint32_t anchor = 0, ip = 0;
+
+    memset(hash_table, 0, sizeof(hash_table));
+    if (len > LZ4_MF_LIMIT) {
+        uint32_t limit = len - LZ4_MF_LIMIT;
+        while (ip < limit) {
+            uint32_t seq = read32(src + ip);
+            uint32_t h = hash4(seq);
+            uint32_t ref = hash_table[h];
+            hash_table[h] = (uint16_t)ip;
+            if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || read32(src + ref) != seq) {
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            uint32_t mlen = LZ4_MIN_MATCH;
+            uint32_t mmax = len - LZ4_LAST_LITERALS - ip;
+            while (mlen < mmax && src[ref + mlen] == src[ip + mlen]) mlen++;
+
+            op = put_seq(op, oend, src + anchor, ip - anchor, ip - ref, mlen);
+            if (!op) return 0;
+            ip += mlen;
+            anchor = ip;
+        }
+    }
+
+    op = put_seq(op, oend, src + anchor, len - anchor, 0, 0);
+    return op ? (uint32_t)(op - dst) : 0;
+}
+
+int lz4_decompress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t cap) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + len;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + cap;
+
+    while (ip < iend) {
+        uint32_t token = *ip++;
+
+        uint32_t nlit = token >> 4;
+        if (nlit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                nlit += b;
+            } while (b == 255 && nlit < LZ4_MAX_INPUT);
+        }
+        if (nlit > (uint32_t)(iend - ip) || nlit > (uint32_t)(oend - op)) return -1;
+        memcpy(op, ip, nlit);
+        op += nlit;
+        ip += nlit;
+        if (ip == iend) break; // The last sequence has no match
+
+        if (iend - ip < 2) return -1;
+        uint32_t off = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (off == 0 || off > (uint32_t)(op - dst)) return -1;
+
+        uint32_t mlen = (token & 15) + LZ4_MIN_MATCH;
+        if ((token & 15) == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                mlen += b;
+            } while (b == 255 && mlen < LZ4_MAX_INPUT);
+        }
+        if (mlen > (uint32_t)(oend - op)) return -1;
+
+        // Overlapping matches repeat the last `off` bytes
+        const uint8_t* m = op - off;
+        if (off >= mlen) {
+            memcpy(op, m, mlen);
+            op += mlen;
+        } else {
+            while (mlen--) *op++ = *m++;
+        }
+    }
+    return (int)(op - dst);
+}
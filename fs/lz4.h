@@ -0,0 +1,20 @@
+// fs/lz4.h - LZ4 block compression for PFS32 compressed files
+// Plain LZ4 block format (no frame), so chunks can be checked with the
+// reference tools. Inputs are limited to 64 KB, which lets the matcher
+// keep 16-bit positions.
+#ifndef LZ4_H
+#define LZ4_H
+
+#include "../include/types.h"
+
+#define LZ4_MAX_INPUT 65536
+
+// Compress `len` bytes into at most `cap` bytes of `dst`. Returns the
+// compressed size, or 0 if it does not fit (store the data raw instead).
+uint32_t lz4_compress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t cap);
+
+// Decompress a block; every length and offset is checked against both
+// buffers. Returns the bytes produced, or -1 for a corrupt block.
+int lz4_decompress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t cap);
+
+#endif
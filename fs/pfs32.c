@@ -1,9 +1,13 @@
-// fs/pfs32.c - Hardened & Optimized PFS32 Implementation (v2.0)
+// fs/pfs32.c - Hardened & Optimized PFS32 Implementation (v3.0)
 #include "pfs32.h"
 #include "disk.h"
+#include "bcache.h"
+#include "dcache.h"
+#include "lz4.h"
 #include "memory.h"
 #include "string.h"
 #include "../hal/drivers/serial.h"
+#include "../hal/cpu/timer.h"
 #include "../core/task.h" // For get_current_uid()
 
 // --- Concurrency / Thread Safety (BUG-001) ---
@@ -20,21 +24,140 @@ static pfs32_stats_t stats = {0};
 uint32_t get_current_gid() { return 0; } // Placeholder: Hook into task/OS
 uint32_t pfs32_time_now() { return 0; }  // Placeholder: Hook into RTC
 
-// --- FAT CACHE (LRU Implementation PERF-004) ---
-#define FAT_CACHE_SIZE 8
+// --- FAT CACHE (Hashed LRU, PERF-004) ---
+// Slots are found through a hash of the FAT sector index and kept on a
+// doubly linked LRU list, so both lookup and victim selection are O(1).
+#define FAT_CACHE_SIZE 256
+#define FAT_HASH_SIZE  512 // Power of two
+#define FAT_NO_SLOT    (-1)
 static uint32_t fat_cache_block[FAT_CACHE_SIZE];
 static uint32_t fat_cache_data[FAT_CACHE_SIZE][PFS32_BLOCK_SIZE/4];
 static int fat_cache_dirty[FAT_CACHE_SIZE];
-static uint32_t fat_cache_lru[FAT_CACHE_SIZE]; // Last access timestamp
-static uint32_t fat_access_counter = 0;        // Logical clock
+static int fat_hash_head[FAT_HASH_SIZE];      // First slot in bucket
+static int fat_hash_next[FAT_CACHE_SIZE];     // Next slot in same bucket
+static int fat_lru_prev[FAT_CACHE_SIZE];      // Towards most recently used
+static int fat_lru_next[FAT_CACHE_SIZE];      // Towards least recently used
+static int fat_lru_head = FAT_NO_SLOT;        // Most recently used
+static int fat_lru_tail = FAT_NO_SLOT;        // Eviction candidate
+
+// --- Resident FAT (PFS32_MOUNT_FAT_RESIDENT) ---
+// Whole table in RAM; dirty sectors tracked in a bitmap for write-back.
+// With the journal the table also holds the images of logged sectors
+// until the checkpoint writes them home (fat_write_home).
+static uint32_t* fat_resident = 0;
+static uint8_t* fat_resident_dirty = 0;
+static uint8_t* fat_resident_logged = 0;
+static uint32_t mount_opts = 0;
 
 // --- Allocation Optimization ---
 static uint32_t last_alloc_search_ptr = 0;
 
+// Blocks per cluster on volumes with PFS32_FEAT_EXTENTS, 0 = FAT chains only
+static uint32_t cluster_blocks = 0;
+
+// --- Free-Space Bitmap (1 bit per block, set = in use) ---
+// Built from the FAT at mount/format time and kept in sync by set_fat(),
+// so the allocator never has to walk the FAT looking for free blocks.
+static uint8_t* free_map = 0;
+#define ALLOC_MAX_CANDIDATES 64 // Free runs examined per allocation
+#define PFS32_MAX_RUN 2048      // Blocks per clustered transfer (1 MB)
+#define COPY_BUF_BLOCKS 256     // Bounce buffer for block copies (128 KB)
+
+// --- Write-Back (PFS32_MOUNT_WRITEBACK, PERF-006) ---
+// pfs32_write_file keeps small files in RAM with no blocks allocated
+// beyond the first; directory blocks go dirty into the block cache and
+// the FAT is no longer flushed per call. pfs32_writeback_pump writes
+// everything back once it is old enough or too much is held, in the
+// order data, FAT, metadata. pfs32_sync is the durability barrier.
+#define WB_MAX_FILES       32
+#define WB_MAX_FILE_BYTES  (256 * 1024)      // Larger writes go straight to disk
+#define WB_MAX_BYTES       (2 * 1024 * 1024) // Held before a forced writeback
+#define WB_EXPIRE_TICKS    250               // 5 s at 50 Hz
+
+typedef struct {
+    int active;
+    uint32_t entry_blk;         // Directory entry of the file
+    int entry_idx;
+    uint32_t start_block;
+    uint8_t* data;              // Rounded up to whole blocks, tail zeroed
+    uint32_t size;
+} wb_file_t;
+
+static wb_file_t wb_files[WB_MAX_FILES];
+static uint32_t wb_bytes = 0;           // Held in wb_files
+static int wb_dirty = 0;                // Anything waiting for writeback
+static uint32_t wb_dirty_since = 0;     // Tick of the oldest unwritten change
+
+// --- Lazy Timestamps (PFS32_MOUNT_LAZYTIME) ---
+// Access times waiting to be folded into their directory blocks by the
+// next metadata flush
+#define LAZY_MAX_TIMES     64
+#define RELATIME_SECS      86400             // relatime refreshes at least daily
+
+typedef struct {
+    int active;
+    uint32_t entry_blk;
+    int entry_idx;
+    uint32_t atime;
+} lazy_time_t;
+
+static lazy_time_t lazy_times[LAZY_MAX_TIMES];
+static int lazy_count = 0;
+
+// --- Metadata Journal (PFS32_FEAT_JOURNAL, PERF-008) ---
+// Every metadata block (directories, extent maps, FAT sectors, the
+// superblock) joins the running transaction and waits dirty in the block
+// cache, or in the table for a resident FAT. A commit writes the whole
+// transaction to the journal as one sequential run; with write-back that
+// happens once per flush, so many operations share it. Logged blocks
+// reach their home locations only at a checkpoint, when the journal or
+// the dirty limit is nearly full. Each operation first reserves the room
+// it needs in both (jnl_reserve), so commits and checkpoints only ever
+// fall between operations.
+static int jnl_on = 0;
+static uint8_t* jnl_buf = 0;            // Descriptor, images and commit of one transaction
+static uint32_t jnl_txn[PFS32_JOURNAL_TXN_MAX]; // Home blocks of the running transaction
+static uint32_t jnl_txn_count = 0;
+static uint32_t* jnl_logged = 0;        // Home blocks committed since the last checkpoint
+static uint32_t jnl_logged_count = 0;
+#define JNL_FREED_HOLD 128              // Held blocks that bring the next checkpoint forward
+static uint32_t* jnl_freed = 0;         // Logged blocks freed since the last checkpoint
+static uint32_t jnl_freed_count = 0;
+static uint8_t* jnl_pend_map = 0;       // Blocks freed by the running transaction (1 bit each)
+static uint32_t jnl_pend_lo = 0, jnl_pend_hi = 0; // Range of set bits
+static uint32_t jnl_pend_count = 0;
+static uint32_t jnl_head = 1;           // Next free journal block
+static uint32_t jnl_seq = 1;            // Sequence number of the next transaction
+// Room jnl_reserve() makes for a small operation (create, rename, the
+// entry of a delete): directory, index and superblock blocks, and FAT
+// sectors
+#define JNL_OP_META 8
+#define JNL_OP_FAT  4
+
 // Forward Declarations
 char* get_basename(const char* path);
 char* get_parent_path(const char* path);
 int find_entry_in_dir(uint32_t dir_start, const char* name, pfs32_direntry_t* out, uint32_t* out_blk, int* out_idx);
+static void fsmap_set(uint32_t blk, int used);
+uint32_t get_fat(uint32_t cluster);
+void flush_fat();
+static uint32_t fat_dirty_count(void);
+static int fat_write_home(void);
+static int jnl_room(uint32_t meta, uint32_t fat);
+static int jnl_reserve(uint32_t meta, uint32_t fat);
+static uint32_t fat_span(uint32_t blocks, uint32_t runs);
+static uint32_t fat_alloc(uint32_t blocks);
+static uint32_t chain_fat(uint32_t start);
+static void fat_count(uint32_t blk, uint32_t* sec, uint32_t* n);
+static int wb_writeback_all(void);
+static void wb_discard_all(void);
+void free_chain(uint32_t start_block);
+static int write_chain(uint32_t blk, const uint8_t* data, uint32_t size, int queue);
+static int handles_reload(uint32_t entry_blk, int entry_idx);
+static uint8_t* copy_buf(uint32_t* cap);
+static int copy_blocks(const pfs32_extent_map_t* sm, uint32_t sblk,
+                       const pfs32_extent_map_t* dm, uint32_t dblk, uint32_t blocks);
+static int chain_fit(uint32_t start, uint32_t blocks);
 
 // --- Helper: Disk I/O with Bounds Checking ---
 static int disk_rw(int write, uint32_t block, void* buf) {
@@ -44,14 +167,17 @@ static int disk_rw(int write, uint32_t block, void* buf) {
         return PFS_ERR_IO;
     }
     
+    // Cached copies (readahead or dirty metadata) save the transfer
+    if (!write && mounted && bcache_lookup(disk_start + block, buf)) return PFS_OK;
+
     int ret = 0;
     for(int i=0; i<3; i++) {
         if (write) {
             ret = disk_write_block(disk_start + block, buf);
-            if(ret == 0) stats.disk_writes++;
+            if(ret == 0) { stats.disk_writes++; stats.write_requests++; }
         } else {
             ret = disk_read_block(disk_start + block, buf);
-            if(ret == 0) stats.disk_reads++;
+            if(ret == 0) { stats.disk_reads++; stats.read_requests++; }
         }
         
         if (ret == 0) return PFS_OK;
@@ -60,6 +186,442 @@ static int disk_rw(int write, uint32_t block, void* buf) {
     return PFS_ERR_IO;
 }
 
+// --- Helper: Multi-block I/O for physically contiguous runs ---
+static int disk_rw_multi(int write, uint32_t block, uint32_t count, void* buf) {
+    if (count == 1) return disk_rw(write, block, buf);
+    if (!mounted || count == 0) return PFS_ERR_IO;
+    if (block >= sb.total_blocks || count > sb.total_blocks - block) return PFS_ERR_IO;
+
+    int ret = 0;
+    for(int i=0; i<3; i++) {
+        if (write) {
+            ret = disk_write_blocks(disk_start + block, count, buf);
+            if(ret == 0) { stats.disk_writes += count; stats.write_requests++; }
+        } else {
+            ret = disk_read_blocks(disk_start + block, count, buf);
+            if(ret == 0) { stats.disk_reads += count; stats.read_requests++; }
+        }
+
+        if (ret == 0) return PFS_OK;
+        for(volatile int k=0; k<1000; k++);
+    }
+    return PFS_ERR_IO;
+}
+
+// Queue a run for the elevator; the caller unplugs and keeps `buf` alive
+static int disk_queue_run(uint32_t block, uint32_t count, void* buf) {
+    if (!mounted || count == 0) return PFS_ERR_IO;
+    if (block >= sb.total_blocks || count > sb.total_blocks - block) return PFS_ERR_IO;
+    if (disk_queue_write(disk_start + block, count, buf) != 0) return PFS_ERR_IO;
+    stats.disk_writes += count;
+    stats.write_requests++;
+    return PFS_OK;
+}
+
+// --- Metadata Journal ---
+
+// A resident FAT sector is its own journal image: it stays out of the
+// block cache and its dirty limit
+static uint8_t* fat_image(uint32_t block) {
+    if (!fat_resident || block < 1 || block > sb.fat_blocks) return 0;
+    return (uint8_t*)fat_resident + (block - 1) * PFS32_BLOCK_SIZE;
+}
+
+static uint32_t jnl_sum(uint32_t h, const uint8_t* blk) {
+    for (int i = 0; i < 512; i++) h = (h ^ blk[i]) * 16777619u;
+    return h;
+}
+
+static int jnl_write_header(uint32_t seq) {
+    pfs32_journal_header_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = PFS32_JOURNAL_MAGIC;
+    h.seq = seq;
+    h.blocks = sb.journal_blocks;
+    return disk_rw(1, sb.journal_start, &h);
+}
+
+static int jnl_commit(void);
+static int jnl_write(uint32_t block, void* buf);
+static int jnl_part_open = 0;           // A part flagged JCOMMIT_MORE awaits its last part
+
+// Blocks freed by a transaction are only reused once it is committed:
+// data written to them before that would land in files a crash brings
+// back. Logged metadata blocks wait longer, see jnl_forget().
+static int jnl_hold(uint32_t block) {
+    if (!jnl_pend_map || block >= sb.total_blocks) return 0;
+    if (!jnl_pend_count || block < jnl_pend_lo) jnl_pend_lo = block;
+    if (!jnl_pend_count || block >= jnl_pend_hi) jnl_pend_hi = block + 1;
+    if (!(jnl_pend_map[block >> 3] & (1 << (block & 7)))) jnl_pend_count++;
+    jnl_pend_map[block >> 3] |= (1 << (block & 7));
+    return 1;
+}
+
+static void jnl_release(void) {
+    for (uint32_t b = jnl_pend_lo; jnl_pend_count && b < jnl_pend_hi; b++) {
+        if ((b & 7) == 0 && jnl_pend_map[b >> 3] == 0) { b += 7; continue; }
+        if (!(jnl_pend_map[b >> 3] & (1 << (b & 7)))) continue;
+        jnl_pend_map[b >> 3] &= ~(1 << (b & 7));
+        jnl_pend_count--;
+        if (get_fat(b) == PFS32_FREE_BLOCK) fsmap_set(b, 0);
+    }
+    jnl_pend_count = 0;
+}
+
+// Write every logged block home and empty the journal. The header is
+// only advanced once the home writes are done, so a crash in between
+// replays the same images again. Only ever between transactions: the
+// blocks of a running one must not reach home before its commit.
+static int jnl_write_home(void) {
+    if (jnl_head == 1) return PFS_OK;
+    if (jnl_txn_count || jnl_part_open || fat_dirty_count()) return PFS_ERR_IO;
+    if (fat_write_home() != PFS_OK || bcache_writeback() != 0) return PFS_ERR_IO;
+    if (jnl_write_header(jnl_seq) != PFS_OK) return PFS_ERR_IO;
+    jnl_head = 1;
+    jnl_logged_count = 0;
+    jnl_part_open = 0;
+    stats.checkpoints++;
+
+    // No image of these is replayed any more: the allocator may have them
+    for (uint32_t i = 0; i < jnl_freed_count; i++) {
+        if (get_fat(jnl_freed[i]) == PFS32_FREE_BLOCK) fsmap_set(jnl_freed[i], 0);
+    }
+    jnl_freed_count = 0;
+    return PFS_OK;
+}
+
+static int jnl_checkpoint(void) {
+    if (!jnl_on) return PFS_OK;
+    if (jnl_commit() != PFS_OK) return PFS_ERR_IO;
+    return jnl_write_home();
+}
+
+// Write the running transaction to the journal as one part: descriptor,
+// images and commit record in one transfer
+static int jnl_write_part(uint32_t flags) {
+    uint32_t n = jnl_txn_count;
+    if (n == 0) return PFS_OK;
+    // jnl_reserve() keeps room for the whole transaction; a running one
+    // cannot be checkpointed to make more
+    if (jnl_head + n + 2 > sb.journal_blocks) return PFS_ERR_FULL;
+
+    pfs32_journal_desc_t* d = (pfs32_journal_desc_t*)jnl_buf;
+    memset(d, 0, 512);
+    d->magic = PFS32_JDESC_MAGIC;
+    d->seq = jnl_seq;
+    d->count = n;
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t* img = jnl_buf + (1 + i) * 512;
+        uint8_t* fat = fat_image(jnl_txn[i]);
+        d->home[i] = jnl_txn[i];
+        if (fat) memcpy(img, fat, 512);
+        else if (!bcache_lookup(disk_start + jnl_txn[i], img) && disk_rw(0, jnl_txn[i], img) != PFS_OK) {
+            return PFS_ERR_IO;
+        }
+    }
+    uint32_t sum = 2166136261u;
+    for (uint32_t i = 0; i <= n; i++) sum = jnl_sum(sum, jnl_buf + i * 512);
+
+    pfs32_journal_commit_t* c = (pfs32_journal_commit_t*)(jnl_buf + (n + 1) * 512);
+    memset(c, 0, 512);
+    c->magic = PFS32_JCOMMIT_MAGIC;
+    c->seq = jnl_seq;
+    c->count = n;
+    c->checksum = sum;
+    c->flags = flags;
+    if (disk_rw_multi(1, sb.journal_start + jnl_head, n + 2, jnl_buf) != PFS_OK) return PFS_ERR_IO;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t b = jnl_txn[i];
+        jnl_logged[jnl_logged_count++] = b;
+        if (fat_image(b)) fat_resident_logged[(b - 1) / 8] |= (1 << ((b - 1) % 8));
+    }
+    jnl_head += n + 2;
+    jnl_seq++;
+    jnl_txn_count = 0;
+    jnl_part_open = (flags & PFS32_JCOMMIT_MORE) != 0;
+    stats.journal_commits++;
+    stats.journal_blocks += n;
+    return PFS_OK;
+}
+
+// Commit the running transaction; it is durable once this returns. The
+// dirty FAT sectors are pulled in first, as directory and extent-map
+// images must never be replayed without the chains they point at. A
+// transaction that outgrew one part (see jnl_write) only counts once
+// this last part is written, so none is replayed holding half of an
+// operation. Called between operations only.
+static int jnl_commit(void) {
+    if (!jnl_on) return PFS_OK;
+    flush_fat();
+    if (fat_dirty_count()) return PFS_ERR_FULL;
+    // The last part must carry an image: forgotten blocks may have left
+    // the transaction empty
+    if (jnl_part_open && jnl_txn_count == 0 && jnl_write(0, &sb) != PFS_OK) return PFS_ERR_IO;
+    int res = jnl_write_part(0);
+    if (res != PFS_OK) return res;
+    jnl_release();
+
+    // Keep room for a transaction of two parts, and keep the cache from
+    // filling with blocks that cannot be evicted
+    if (jnl_head + 2 * (PFS32_JOURNAL_TXN_MAX + 2) > sb.journal_blocks ||
+        bcache_dirty_count() >= BCACHE_DIRTY_MAX / 2 ||
+        jnl_freed_count >= JNL_FREED_HOLD) return jnl_write_home();
+    return PFS_OK;
+}
+
+// Add a metadata block image to the running transaction. A full one is
+// written out as a part and continues in the next. The image waits in
+// the block cache, where jnl_reserve() made room for it before the
+// operation started; nothing here may commit or checkpoint to make more.
+static int jnl_write(uint32_t block, void* buf) {
+    if (!mounted || block >= sb.total_blocks) return PFS_ERR_IO;
+    int present = 0;
+    for (uint32_t i = 0; i < jnl_txn_count && !present; i++) present = jnl_txn[i] == block;
+    if (!present && jnl_txn_count == PFS32_JOURNAL_TXN_MAX) {
+        int res = jnl_write_part(PFS32_JCOMMIT_MORE);
+        if (res != PFS_OK) return res;
+    }
+
+    if (!fat_image(block) && !bcache_write(disk_start + block, buf)) return PFS_ERR_FULL;
+    if (!present) jnl_txn[jnl_txn_count++] = block;
+    return PFS_OK;
+}
+
+// A metadata block is being freed. Its logged images must not be
+// replayed over whatever the block holds next, so a block that has some
+// stays out of the allocator until the next checkpoint. jnl_freed has
+// room for every block the journal can hold. Returns 1 if the block is
+// held.
+static int jnl_forget(uint32_t block) {
+    if (!bcache_is_dirty(disk_start + block)) return 0;
+    for (uint32_t i = 0; i < jnl_txn_count; i++) {
+        if (jnl_txn[i] == block) { jnl_txn[i] = jnl_txn[--jnl_txn_count]; break; }
+    }
+    for (uint32_t i = 0; i < jnl_logged_count; i++) {
+        if (jnl_logged[i] != block) continue;
+        if (jnl_freed_count < sb.journal_blocks) jnl_freed[jnl_freed_count++] = block;
+        return 1;
+    }
+    return 0;
+}
+
+// Open the journal of the volume just read: replay every complete
+// transaction, then start logging after an empty journal
+static int jnl_open(void) {
+    jnl_on = 0;
+    jnl_txn_count = 0;
+    jnl_part_open = 0;
+    jnl_logged_count = 0;
+    jnl_freed_count = 0;
+    jnl_pend_count = 0;
+    if (jnl_pend_map) kfree(jnl_pend_map);
+    jnl_pend_map = 0;
+    if (!(sb.features & PFS32_FEAT_JOURNAL)) return PFS_OK;
+    if (sb.journal_blocks < 2 * (PFS32_JOURNAL_TXN_MAX + 2) + 1 || sb.journal_start < sb.data_start_block ||
+        sb.journal_start >= sb.total_blocks || sb.journal_blocks > sb.total_blocks - sb.journal_start) {
+        return PFS_ERR_NO_FS;
+    }
+    if (!jnl_buf) jnl_buf = (uint8_t*)kmalloc((PFS32_JOURNAL_TXN_MAX + 2) * 512);
+    if (jnl_logged) kfree(jnl_logged);
+    if (jnl_freed) kfree(jnl_freed);
+    jnl_logged = (uint32_t*)kmalloc(sb.journal_blocks * sizeof(uint32_t));
+    jnl_freed = (uint32_t*)kmalloc(sb.journal_blocks * sizeof(uint32_t));
+    if (!jnl_buf || !jnl_logged || !jnl_freed) return PFS_ERR_FULL;
+    // Without it freed blocks are reused at once, as before the journal
+    jnl_pend_map = (uint8_t*)kzalloc((sb.total_blocks + 7) / 8);
+
+    pfs32_journal_header_t h;
+    if (disk_rw(0, sb.journal_start, &h) != PFS_OK) return PFS_ERR_IO;
+    if (h.magic != PFS32_JOURNAL_MAGIC) return PFS_ERR_NO_FS;
+
+    // Find where the last complete transaction ends, then replay up to it
+    uint32_t end = 1, seq = h.seq, pos = 1, replayed = 0;
+    for (int apply = 0; apply < 2; apply++) {
+        seq = h.seq;
+        pos = 1;
+        while (pos + 2 <= sb.journal_blocks && (!apply || pos < end)) {
+            pfs32_journal_desc_t* d = (pfs32_journal_desc_t*)jnl_buf;
+            if (disk_rw(0, sb.journal_start + pos, d) != PFS_OK) break;
+            uint32_t n = d->count;
+            if (d->magic != PFS32_JDESC_MAGIC || d->seq != seq || n == 0 || n > PFS32_JOURNAL_TXN_MAX ||
+                pos + n + 2 > sb.journal_blocks) break;
+            if (disk_rw_multi(0, sb.journal_start + pos + 1, n + 1, jnl_buf + 512) != PFS_OK) break;
+
+            uint32_t sum = 2166136261u;
+            for (uint32_t i = 0; i <= n; i++) sum = jnl_sum(sum, jnl_buf + i * 512);
+            pfs32_journal_commit_t* c = (pfs32_journal_commit_t*)(jnl_buf + (n + 1) * 512);
+            if (c->magic != PFS32_JCOMMIT_MAGIC || c->seq != seq || c->count != n || c->checksum != sum) break;
+
+            for (uint32_t i = 0; apply && i < n; i++) {
+                if (d->home[i] >= sb.total_blocks) continue;
+                if (disk_queue_run(d->home[i], 1, jnl_buf + (1 + i) * 512) != PFS_OK) return PFS_ERR_IO;
+            }
+            if (apply && disk_unplug() != 0) return PFS_ERR_IO;
+            if (apply) replayed += n;
+            pos += n + 2;
+            seq++;
+            if (!apply && !(c->flags & PFS32_JCOMMIT_MORE)) end = pos;
+        }
+    }
+    // Parts of an unfinished transaction are skipped; new transactions
+    // continue after their sequence numbers
+    if (end > 1 || pos > 1) {
+        if (jnl_write_header(seq) != PFS_OK) return PFS_ERR_IO;
+        char num[12];
+        int_to_str((int)replayed, num);
+        s_printf("[PFS32] Journal replayed, blocks: ");
+        s_printf(num);
+        s_printf("\n");
+    }
+    jnl_seq = seq;
+    jnl_head = 1;
+    jnl_on = 1;
+    return PFS_OK;
+}
+
+// --- Write-back helpers ---
+
+static void wb_touch(void) {
+    if (!wb_dirty) {
+        wb_dirty = 1;
+        wb_dirty_since = get_tick_count();
+    }
+}
+
+// Metadata block update. With the journal it joins the running
+// transaction. With write-back it only dirties the block cache; if the
+// cache is at its dirty limit everything is written back first.
+static int meta_write(uint32_t block, void* buf) {
+    if (jnl_on) {
+        int res = jnl_write(block, buf);
+        if (res != PFS_OK) return res;
+        if (mount_opts & PFS32_MOUNT_WRITEBACK) wb_touch();
+        return PFS_OK;
+    }
+    if (!(mount_opts & PFS32_MOUNT_WRITEBACK)) return disk_rw(1, block, buf);
+    if (!mounted || block >= sb.total_blocks) return PFS_ERR_IO;
+    if (!bcache_write(disk_start + block, buf)) {
+        wb_writeback_all();
+        if (!bcache_write(disk_start + block, buf)) return disk_rw(1, block, buf);
+    }
+    wb_touch();
+    return PFS_OK;
+}
+
+static lazy_time_t* lazy_find(uint32_t entry_blk, int entry_idx) {
+    if (!lazy_count) return 0;
+    for (int i = 0; i < LAZY_MAX_TIMES; i++) {
+        if (lazy_times[i].active && lazy_times[i].entry_blk == entry_blk &&
+            lazy_times[i].entry_idx == entry_idx) return &lazy_times[i];
+    }
+    return 0;
+}
+
+static void lazy_drop(lazy_time_t* lz) {
+    lz->active = 0;
+    lazy_count--;
+}
+
+// Overlay held timestamps onto a directory block just read from disk
+static void lazy_apply(uint32_t blk, uint8_t* dbuf) {
+    if (!lazy_count) return;
+    pfs32_direntry_t* d = (pfs32_direntry_t*)dbuf;
+    for (int i = 0; i < LAZY_MAX_TIMES; i++) {
+        if (lazy_times[i].active && lazy_times[i].entry_blk == blk) {
+            d[lazy_times[i].entry_idx].access_time = lazy_times[i].atime;
+        }
+    }
+}
+
+// Write held timestamps, one read-modify-write per directory block. Those
+// the running transaction has no room for stay held.
+static void lazy_flush(void) {
+    for (int i = 0; i < LAZY_MAX_TIMES && lazy_count; i++) {
+        if (!lazy_times[i].active) continue;
+        if (!jnl_room(1, 0)) return;
+        uint32_t blk = lazy_times[i].entry_blk;
+        uint8_t dbuf[512];
+        if (disk_rw(0, blk, dbuf) != PFS_OK) continue;
+        lazy_apply(blk, dbuf);
+        if (meta_write(blk, dbuf) != PFS_OK) continue;
+        for (int k = i; k < LAZY_MAX_TIMES; k++) {
+            if (lazy_times[k].active && lazy_times[k].entry_blk == blk) lazy_drop(&lazy_times[k]);
+        }
+    }
+}
+
+// Record a read of the file at (entry_blk, entry_idx) according to the
+// atime mount options. `e` is the entry as found on disk.
+static void touch_atime(const pfs32_direntry_t* e, uint32_t entry_blk, int entry_idx) {
+    if (mount_opts & PFS32_MOUNT_NOATIME) return;
+
+    uint32_t now = pfs32_time_now();
+    lazy_time_t* lz = lazy_find(entry_blk, entry_idx);
+    uint32_t atime = lz ? lz->atime : e->access_time;
+    if (atime == now) return; // Nothing would change
+
+    if ((mount_opts & PFS32_MOUNT_RELATIME) && atime > e->modify_time &&
+        atime > e->create_time && now - atime < RELATIME_SECS) return;
+
+    if (mount_opts & PFS32_MOUNT_LAZYTIME) {
+        if (!lz) {
+            if (lazy_count == LAZY_MAX_TIMES) lazy_flush();
+            for (int i = 0; i < LAZY_MAX_TIMES && !lz; i++) {
+                if (!lazy_times[i].active) lz = &lazy_times[i];
+            }
+        }
+        if (lz) {
+            if (!lz->active) {
+                lz->active = 1;
+                lz->entry_blk = entry_blk;
+                lz->entry_idx = entry_idx;
+                lazy_count++;
+            }
+            lz->atime = now;
+            wb_touch();
+            return;
+        }
+    }
+
+    uint8_t dbuf[512];
+    if (!jnl_room(1, 0) || disk_rw(0, entry_blk, dbuf) != PFS_OK) return;
+    ((pfs32_direntry_t*)dbuf)[entry_idx].access_time = now;
+    meta_write(entry_blk, dbuf);
+}
+
+// Directory block read. The block is kept in the block cache, so repeat
+// lookups in the same directory never reach the disk.
+static int meta_read(uint32_t block, void* buf) {
+    if (disk_rw(0, block, buf) != PFS_OK) return PFS_ERR_IO;
+    if (!bcache_contains(disk_start + block)) bcache_fill(disk_start + block, 1, buf);
+    return PFS_OK;
+}
+
+// End of a metadata change: flush the FAT and commit now, or leave it to
+// the flusher
+static void meta_commit(void) {
+    if (mount_opts & PFS32_MOUNT_WRITEBACK) {
+        wb_touch();
+        return;
+    }
+    flush_fat();
+    jnl_commit();
+}
+
+// Length of the physically contiguous run of chain blocks starting at
+// `blk`, capped at `max`. *last receives the final block of the run.
+static uint32_t chain_run_length(uint32_t blk, uint32_t max, uint32_t* last) {
+    uint32_t len = 1;
+    while (len < max) {
+        uint32_t next = get_fat(blk + len - 1);
+        if (next != blk + len) break;
+        len++;
+    }
+    *last = blk + len - 1;
+    return len;
+}
+
 // --- Helper: Sanitize Filename ---
 void sanitize_name(char* dest, const char* src, int max_len) {
     int i = 0, j = 0;
@@ -113,80 +675,220 @@ int check_permission(uint8_t file_uid, uint8_t file_gid, uint8_t file_perm, int
 
 // --- FAT Management (LRU) ---
 
+static inline uint32_t fat_hash(uint32_t fat_blk_idx) {
+    return (fat_blk_idx * 2654435761u) & (FAT_HASH_SIZE - 1);
+}
+
+static void fat_lru_unlink(int slot) {
+    if (fat_lru_prev[slot] != FAT_NO_SLOT) fat_lru_next[fat_lru_prev[slot]] = fat_lru_next[slot];
+    else fat_lru_head = fat_lru_next[slot];
+    if (fat_lru_next[slot] != FAT_NO_SLOT) fat_lru_prev[fat_lru_next[slot]] = fat_lru_prev[slot];
+    else fat_lru_tail = fat_lru_prev[slot];
+}
+
+static void fat_lru_push_front(int slot) {
+    fat_lru_prev[slot] = FAT_NO_SLOT;
+    fat_lru_next[slot] = fat_lru_head;
+    if (fat_lru_head != FAT_NO_SLOT) fat_lru_prev[fat_lru_head] = slot;
+    fat_lru_head = slot;
+    if (fat_lru_tail == FAT_NO_SLOT) fat_lru_tail = slot;
+}
+
+static void fat_hash_remove(int slot) {
+    uint32_t h = fat_hash(fat_cache_block[slot]);
+    int* link = &fat_hash_head[h];
+    while (*link != FAT_NO_SLOT) {
+        if (*link == slot) { *link = fat_hash_next[slot]; return; }
+        link = &fat_hash_next[*link];
+    }
+}
+
+static void fat_resident_release() {
+    if (fat_resident) kfree(fat_resident);
+    if (fat_resident_dirty) kfree(fat_resident_dirty);
+    if (fat_resident_logged) kfree(fat_resident_logged);
+    fat_resident = 0;
+    fat_resident_dirty = 0;
+    fat_resident_logged = 0;
+}
+
 void init_fat_cache() {
     PFS_LOCK();
+    for(int i=0; i<FAT_HASH_SIZE; i++) fat_hash_head[i] = FAT_NO_SLOT;
+    fat_lru_head = FAT_NO_SLOT;
+    fat_lru_tail = FAT_NO_SLOT;
     for(int i=0; i<FAT_CACHE_SIZE; i++) {
         fat_cache_block[i] = PFS32_END_BLOCK;
         fat_cache_dirty[i] = 0;
-        fat_cache_lru[i] = 0;
-        memset(fat_cache_data[i], 0, PFS32_BLOCK_SIZE);
+        fat_hash_next[i] = FAT_NO_SLOT;
+        fat_lru_push_front(i);
     }
-    fat_access_counter = 0;
+    fat_resident_release();
     PFS_UNLOCK();
 }
 
+// Load the entire FAT into RAM. Falls back to the sector cache if the
+// table does not fit in the heap or a sector cannot be read.
+static int fat_load_resident() {
+    uint32_t bytes = sb.fat_blocks * PFS32_BLOCK_SIZE;
+    fat_resident = (uint32_t*)kmalloc(bytes);
+    fat_resident_dirty = (uint8_t*)kmalloc((sb.fat_blocks + 7) / 8);
+    fat_resident_logged = (uint8_t*)kzalloc((sb.fat_blocks + 7) / 8);
+    if (!fat_resident || !fat_resident_dirty || !fat_resident_logged) {
+        fat_resident_release();
+        return PFS_ERR_FULL;
+    }
+    memset(fat_resident_dirty, 0, (sb.fat_blocks + 7) / 8);
+
+    // The FAT is contiguous on disk: stream it in with large transfers
+    if (disk_rw_multi(0, 1, sb.fat_blocks, fat_resident) != PFS_OK) {
+        fat_resident_release();
+        return PFS_ERR_IO;
+    }
+    return PFS_OK;
+}
+
 void flush_fat() {
     if (!mounted) return;
     PFS_LOCK();
+    if (jnl_on) {
+        // Dirty sectors join the running transaction
+        for (uint32_t i = 0; fat_resident && i < sb.fat_blocks; i++) {
+            if (!(fat_resident_dirty[i / 8] & (1 << (i % 8)))) continue;
+            if (meta_write(1 + i, (uint8_t*)fat_resident + i * PFS32_BLOCK_SIZE) == PFS_OK) {
+                fat_resident_dirty[i / 8] &= ~(1 << (i % 8));
+            }
+        }
+        for (int i = 0; !fat_resident && i < FAT_CACHE_SIZE; i++) {
+            if (fat_cache_block[i] == PFS32_END_BLOCK || !fat_cache_dirty[i]) continue;
+            if (meta_write(1 + fat_cache_block[i], fat_cache_data[i]) == PFS_OK) fat_cache_dirty[i] = 0;
+        }
+        PFS_UNLOCK();
+        return;
+    }
+    if (fat_resident) {
+        // Coalesce adjacent dirty sectors into one write each
+        uint8_t* src = (uint8_t*)fat_resident;
+        uint32_t i = 0;
+        while (i < sb.fat_blocks) {
+            if (!(fat_resident_dirty[i / 8] & (1 << (i % 8)))) { i++; continue; }
+            uint32_t n = 1;
+            while (i + n < sb.fat_blocks && (fat_resident_dirty[(i + n) / 8] & (1 << ((i + n) % 8)))) n++;
+            if (disk_rw_multi(1, 1 + i, n, src + i * PFS32_BLOCK_SIZE) == PFS_OK) {
+                for (uint32_t k = i; k < i + n; k++) fat_resident_dirty[k / 8] &= ~(1 << (k % 8));
+            }
+            i += n;
+        }
+        PFS_UNLOCK();
+        return;
+    }
+    // Queue every dirty sector and let the elevator sort and merge them
+    int queued = 0, failed = 0;
     for(int i=0; i<FAT_CACHE_SIZE; i++) {
         if(fat_cache_block[i] != PFS32_END_BLOCK && fat_cache_dirty[i]) {
-            if (disk_rw(1, 1 + fat_cache_block[i], fat_cache_data[i]) == PFS_OK) {
-                fat_cache_dirty[i] = 0;
+            if (disk_queue_write(disk_start + 1 + fat_cache_block[i], 1, fat_cache_data[i]) != 0) {
+                failed = 1;
+                break;
             }
+            queued++;
+        }
+    }
+    if (queued && disk_unplug() == 0 && !failed) {
+        for(int i=0; i<FAT_CACHE_SIZE; i++) {
+            if (fat_cache_block[i] != PFS32_END_BLOCK) fat_cache_dirty[i] = 0;
         }
+        stats.disk_writes += queued;
+        stats.write_requests += queued;
     }
     PFS_UNLOCK();
 }
 
-uint32_t get_fat(uint32_t cluster) {
-    if (PFS32_BLOCK_SIZE == 0) return PFS32_END_BLOCK;
-    PFS_LOCK();
-    
-    uint32_t entries_per_block = PFS32_BLOCK_SIZE / 4;
-    uint32_t fat_blk_idx = cluster / entries_per_block;
-    uint32_t fat_offset = cluster % entries_per_block;
-    fat_access_counter++;
+// FAT sectors changed since they last joined the journal or reached disk
+static uint32_t fat_dirty_count(void) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; fat_resident && i < (sb.fat_blocks + 7) / 8; i++) {
+        for (uint8_t bits = fat_resident_dirty[i]; bits; bits &= bits - 1) n++;
+    }
+    for (int i = 0; !fat_resident && i < FAT_CACHE_SIZE; i++) {
+        if (fat_cache_block[i] != PFS32_END_BLOCK && fat_cache_dirty[i]) n++;
+    }
+    return n;
+}
 
-    // Check Cache
-    for(int i=0; i<FAT_CACHE_SIZE; i++) {
-        if(fat_cache_block[i] == fat_blk_idx) {
-            fat_cache_lru[i] = fat_access_counter; // Update LRU
+// Journal checkpoint of a resident FAT: the sectors logged since the
+// last one go home from the table, adjacent ones in one write
+static int fat_write_home(void) {
+    if (!fat_resident) return PFS_OK;
+    uint8_t* src = (uint8_t*)fat_resident;
+    uint32_t i = 0;
+    while (i < sb.fat_blocks) {
+        if (!(fat_resident_logged[i / 8] & (1 << (i % 8)))) { i++; continue; }
+        uint32_t n = 1;
+        while (i + n < sb.fat_blocks && (fat_resident_logged[(i + n) / 8] & (1 << ((i + n) % 8)))) n++;
+        if (disk_rw_multi(1, 1 + i, n, src + i * PFS32_BLOCK_SIZE) != PFS_OK) return PFS_ERR_IO;
+        for (uint32_t k = i; k < i + n; k++) fat_resident_logged[k / 8] &= ~(1 << (k % 8));
+        i += n;
+    }
+    return PFS_OK;
+}
+
+// Returns the cache slot holding FAT sector `fat_blk_idx`, loading it
+// (and writing back the evicted victim) on a miss. Caller holds the lock.
+static int fat_cache_slot(uint32_t fat_blk_idx) {
+    for (int i = fat_hash_head[fat_hash(fat_blk_idx)]; i != FAT_NO_SLOT; i = fat_hash_next[i]) {
+        if (fat_cache_block[i] == fat_blk_idx) {
             stats.cache_hits++;
-            uint32_t val = fat_cache_data[i][fat_offset];
-            PFS_UNLOCK();
-            return val;
+            if (fat_lru_head != i) {
+                fat_lru_unlink(i);
+                fat_lru_push_front(i);
+            }
+            return i;
         }
     }
-    
+
     stats.cache_misses++;
 
-    // LRU Victim Selection
-    int victim = 0;
-    uint32_t min_lru = fat_cache_lru[0];
-    for(int i=1; i<FAT_CACHE_SIZE; i++) {
-        if (fat_cache_lru[i] < min_lru) {
-            min_lru = fat_cache_lru[i];
-            victim = i;
+    int victim = fat_lru_tail;
+    if (fat_cache_block[victim] != PFS32_END_BLOCK) {
+        if (fat_cache_dirty[victim]) {
+            if (jnl_on) meta_write(1 + fat_cache_block[victim], fat_cache_data[victim]);
+            else disk_rw(1, 1 + fat_cache_block[victim], fat_cache_data[victim]);
         }
+        fat_hash_remove(victim);
     }
+    fat_lru_unlink(victim);
+    fat_lru_push_front(victim);
 
-    // Flush victim
-    if(fat_cache_block[victim] != PFS32_END_BLOCK && fat_cache_dirty[victim]) {
-        disk_rw(1, 1 + fat_cache_block[victim], fat_cache_data[victim]);
+    fat_cache_block[victim] = PFS32_END_BLOCK;
+    fat_cache_dirty[victim] = 0;
+    if (disk_rw(0, 1 + fat_blk_idx, fat_cache_data[victim]) != PFS_OK) {
+        return FAT_NO_SLOT;
     }
 
-    // Load new
+    uint32_t h = fat_hash(fat_blk_idx);
     fat_cache_block[victim] = fat_blk_idx;
-    fat_cache_dirty[victim] = 0;
-    fat_cache_lru[victim] = fat_access_counter;
-    
-    if (disk_rw(0, 1 + fat_blk_idx, fat_cache_data[victim]) != PFS_OK) {
-        fat_cache_block[victim] = PFS32_END_BLOCK; // Invalidate
+    fat_hash_next[victim] = fat_hash_head[h];
+    fat_hash_head[h] = victim;
+    return victim;
+}
+
+uint32_t get_fat(uint32_t cluster) {
+    if (PFS32_BLOCK_SIZE == 0) return PFS32_END_BLOCK;
+    PFS_LOCK();
+
+    uint32_t entries_per_block = PFS32_BLOCK_SIZE / 4;
+    uint32_t fat_blk_idx = cluster / entries_per_block;
+
+    if (fat_resident) {
+        uint32_t val = (fat_blk_idx < sb.fat_blocks) ? fat_resident[cluster] : PFS32_END_BLOCK;
+        stats.cache_hits++;
         PFS_UNLOCK();
-        return PFS32_END_BLOCK;
+        return val;
     }
 
-    uint32_t val = fat_cache_data[victim][fat_offset];
+    int slot = fat_cache_slot(fat_blk_idx);
+    uint32_t val = (slot == FAT_NO_SLOT) ? PFS32_END_BLOCK
+                                         : fat_cache_data[slot][cluster % entries_per_block];
     PFS_UNLOCK();
     return val;
 }
@@ -194,67 +896,454 @@ uint32_t get_fat(uint32_t cluster) {
 void set_fat(uint32_t cluster, uint32_t val) {
     if (PFS32_BLOCK_SIZE == 0) return;
     PFS_LOCK();
-    
+    int held = jnl_on && val == PFS32_FREE_BLOCK && (jnl_forget(cluster) || jnl_hold(cluster));
+    fsmap_set(cluster, val != PFS32_FREE_BLOCK || held);
+
     uint32_t entries_per_block = PFS32_BLOCK_SIZE / 4;
     uint32_t fat_blk_idx = cluster / entries_per_block;
-    uint32_t fat_offset = cluster % entries_per_block;
-    fat_access_counter++;
 
-    int slot = -1;
-    for(int i=0; i<FAT_CACHE_SIZE; i++) {
-        if(fat_cache_block[i] == fat_blk_idx) { slot = i; break; }
-    }
-
-    if(slot == -1) {
-        // Must load it first (Read-Modify-Write)
-        PFS_UNLOCK(); // Release lock before calling get_fat which locks
-        get_fat(cluster); 
-        PFS_LOCK(); // Re-acquire
-        
-        // Find where it ended up
-        for(int i=0; i<FAT_CACHE_SIZE; i++) {
-            if(fat_cache_block[i] == fat_blk_idx) { slot = i; break; }
+    if (fat_resident) {
+        if (fat_blk_idx < sb.fat_blocks) {
+            fat_resident[cluster] = val;
+            fat_resident_dirty[fat_blk_idx / 8] |= (1 << (fat_blk_idx % 8));
         }
+        PFS_UNLOCK();
+        return;
     }
 
-    if (slot != -1) {
-        fat_cache_data[slot][fat_offset] = val;
+    // Read-Modify-Write through the cache; no lock juggling needed
+    int slot = fat_cache_slot(fat_blk_idx);
+    if (slot != FAT_NO_SLOT) {
+        fat_cache_data[slot][cluster % entries_per_block] = val;
         fat_cache_dirty[slot] = 1;
-        fat_cache_lru[slot] = fat_access_counter;
     }
     PFS_UNLOCK();
 }
 
-uint32_t alloc_block() {
+// --- Free-Space Bitmap ---
+
+static inline int fsmap_used(uint32_t blk) {
+    return free_map[blk >> 3] & (1 << (blk & 7));
+}
+
+// Mark a block used/free, keeping the superblock free counter exact
+static void fsmap_set(uint32_t blk, int used) {
+    if (!free_map || blk >= sb.total_blocks) return;
+    int was_used = fsmap_used(blk) ? 1 : 0;
+    if (was_used == used) return;
+    if (used) {
+        free_map[blk >> 3] |= (1 << (blk & 7));
+        sb.free_blocks--;
+    } else {
+        free_map[blk >> 3] &= ~(1 << (blk & 7));
+        sb.free_blocks++;
+    }
+}
+
+static void fsmap_release() {
+    if (free_map) kfree(free_map);
+    free_map = 0;
+}
+
+// Build the bitmap with one sequential pass over the FAT
+// Both callers (mount, format) run with an empty FAT sector cache, so
+// without a resident copy the table is streamed in with large reads
+// rather than a sector at a time through get_fat()
+static int fsmap_build() {
+    fsmap_release();
+    free_map = (uint8_t*)kmalloc((sb.total_blocks + 7) / 8);
+    if (!free_map) return PFS_ERR_FULL;
+    memset(free_map, 0, (sb.total_blocks + 7) / 8);
+
+    uint32_t cap = 0;
+    uint8_t* buf = fat_resident ? 0 : copy_buf(&cap);
+    uint32_t free_count = 0;
+    uint32_t per_block = PFS32_BLOCK_SIZE / 4;
+    uint32_t first = 0, end = 0; // Entries held in `buf`
+    for (uint32_t i = 0; i < sb.total_blocks; i++) {
+        if (buf && i == end) {
+            uint32_t fblk = i / per_block;
+            uint32_t n = (sb.fat_blocks - fblk < cap) ? sb.fat_blocks - fblk : cap;
+            if (disk_rw_multi(0, 1 + fblk, n, buf) == PFS_OK) {
+                first = i;
+                end = i + n * per_block;
+            } else {
+                kfree(buf);
+                buf = 0;
+            }
+        }
+        uint32_t val = buf ? ((uint32_t*)buf)[i - first] : get_fat(i);
+        if (i < sb.data_start_block || val != PFS32_FREE_BLOCK) {
+            free_map[i >> 3] |= (1 << (i & 7));
+        } else {
+            free_count++;
+        }
+    }
+    if (buf) kfree(buf);
+    sb.free_blocks = free_count;
+    return PFS_OK;
+}
+
+// First free block in [from, to), or 0 if none
+static uint32_t fsmap_find_free(uint32_t from, uint32_t to) {
+    uint32_t i = from;
+    while (i < to) {
+        if ((i & 7) == 0 && free_map[i >> 3] == 0xFF) { i += 8; continue; }
+        if (!fsmap_used(i)) return i;
+        i++;
+    }
+    return 0;
+}
+
+// Length of the free run starting at `start`, capped at `max`
+static uint32_t fsmap_run_length(uint32_t start, uint32_t max) {
+    uint32_t len = 0;
+    while (len < max && start + len < sb.total_blocks && !fsmap_used(start + len)) len++;
+    return len;
+}
+
+// Legacy allocator used when the bitmap could not be allocated
+static uint32_t alloc_block_scan() {
     uint32_t start_search = last_alloc_search_ptr;
     if (start_search < sb.data_start_block || start_search >= sb.total_blocks) {
         start_search = sb.data_start_block;
     }
 
     for(uint32_t i = start_search; i < sb.total_blocks; i++) {
-        if(get_fat(i) == PFS32_FREE_BLOCK) {
-            set_fat(i, PFS32_END_BLOCK);
-            uint8_t z[512]; memset(z, 0, 512);
-            disk_rw(1, i, z);
-            last_alloc_search_ptr = i + 1;
-            return i;
-        }
+        if(get_fat(i) == PFS32_FREE_BLOCK) return i;
     }
     
     // Wrap around
     for(uint32_t i = sb.data_start_block; i < start_search; i++) {
-        if(get_fat(i) == PFS32_FREE_BLOCK) {
-            set_fat(i, PFS32_END_BLOCK);
-            uint8_t z[512]; memset(z, 0, 512);
-            disk_rw(1, i, z);
-            last_alloc_search_ptr = i + 1;
-            return i;
-        }
+        if(get_fat(i) == PFS32_FREE_BLOCK) return i;
     }
 
     return 0; 
 }
 
+// Allocate up to `want` physically contiguous blocks and mark them in the
+// FAT: chained and terminated with END when `chain` is set, otherwise each
+// one END (extent data). With `align` > 1 the run starts on an `align`
+// boundary of the data area and is a whole multiple of it; unaligned
+// space is only taken when no aligned run is left. Returns the first
+// block (0 = disk full) and the run length in *got. Blocks are only
+// zeroed when `zero` is set; callers that overwrite the whole block
+// immediately skip that I/O.
+static uint32_t alloc_run(uint32_t want, uint32_t align, int chain, uint32_t* got, int zero) {
+    if (want == 0) want = 1;
+    if (align == 0) align = 1;
+    *got = 0;
+
+    uint32_t start_search = last_alloc_search_ptr;
+    if (start_search < sb.data_start_block || start_search >= sb.total_blocks) {
+        start_search = sb.data_start_block;
+    }
+
+    uint32_t best = 0, best_len = 0;
+    uint32_t loose = 0, loose_len = 0; // Longest run ignoring alignment
+    if (!free_map) {
+        best = alloc_block_scan();
+        best_len = best ? 1 : 0;
+    } else {
+        // First-fit from the rotor, remembering the longest run seen in
+        // case no single run is large enough for the whole request.
+        uint32_t pos = start_search;
+        int wrapped = 0;
+        for (int cand = 0; cand < ALLOC_MAX_CANDIDATES; cand++) {
+            uint32_t blk = fsmap_find_free(pos, wrapped ? start_search : sb.total_blocks);
+            if (!blk) {
+                if (wrapped) break;
+                wrapped = 1;
+                pos = sb.data_start_block;
+                continue;
+            }
+            uint32_t len = fsmap_run_length(blk, want + align - 1);
+            if (len > loose_len) { loose = blk; loose_len = len > want ? want : len; }
+
+            uint32_t a = sb.data_start_block + ((blk - sb.data_start_block + align - 1) / align) * align;
+            uint32_t alen = (blk + len > a) ? (blk + len - a) / align * align : 0;
+            if (alen > want) alen = want;
+            if (alen > best_len) { best = a; best_len = alen; }
+            if (best_len >= want) break;
+            pos = blk + len;
+        }
+        if (!best) { best = loose; best_len = loose_len; }
+    }
+    if (!best) return 0;
+
+    for (uint32_t i = 0; i < best_len; i++) {
+        set_fat(best + i, (chain && i + 1 < best_len) ? best + i + 1 : PFS32_END_BLOCK);
+    }
+    if (zero) {
+        // Same source buffer for every block; the elevator gathers the run
+        // into one command
+        uint8_t z[512]; memset(z, 0, 512);
+        for (uint32_t i = 0; i < best_len; i++) {
+            if (disk_queue_write(disk_start + best + i, 1, z) != 0) break;
+        }
+        disk_unplug();
+        stats.disk_writes += best_len;
+        stats.write_requests++;
+    }
+
+    last_alloc_search_ptr = best + best_len;
+    *got = best_len;
+    return best;
+}
+
+// Up to `want` contiguous blocks chained in the FAT
+static uint32_t alloc_blocks(uint32_t want, uint32_t* got, int zero) {
+    return alloc_run(want, 1, 1, got, zero);
+}
+
+// Single zero-filled block (directories, sparse extension)
+uint32_t alloc_block() {
+    uint32_t got;
+    return alloc_blocks(1, &got, 1);
+}
+
+// --- Extent-Mapped Files (v3) ---
+// Files of at least a cluster keep their data in cluster-aligned runs
+// listed in one map block, so reads and seeks never walk the FAT. The
+// map block's FAT entry (PFS32_EXTENT_MAP) is what tells the layouts
+// apart; everything else (small files, directories, v2 volumes, files too
+// fragmented for the map) is a FAT chain.
+
+static int is_extent_file(uint32_t start) {
+    return cluster_blocks && start >= sb.data_start_block && start < sb.total_blocks &&
+           get_fat(start) == PFS32_EXTENT_MAP;
+}
+
+static int ext_load(uint32_t map_blk, pfs32_extent_map_t* m) {
+    if (meta_read(map_blk, m) != PFS_OK) return PFS_ERR_IO;
+    if (m->magic != PFS32_EXTENT_MAGIC || m->count > PFS32_MAX_EXTENTS) return PFS_ERR_IO;
+    return PFS_OK;
+}
+
+static void ext_init(pfs32_extent_map_t* m) {
+    memset(m, 0, sizeof(*m));
+    m->magic = PFS32_EXTENT_MAGIC;
+}
+
+// Data blocks needed for `size` bytes, rounded up to whole clusters
+static uint32_t ext_blocks_for(uint32_t size) {
+    uint32_t blocks = (size + PFS32_BLOCK_SIZE - 1) / PFS32_BLOCK_SIZE;
+    return (blocks + cluster_blocks - 1) / cluster_blocks * cluster_blocks;
+}
+
+static uint32_t ext_first(const pfs32_extent_map_t* m) {
+    return m->count ? m->ext[0].start : PFS32_END_BLOCK;
+}
+
+static int ext_find(const pfs32_extent_map_t* m, uint32_t blk) {
+    for (int i = 0; i < m->count; i++) {
+        if (blk >= m->ext[i].start && blk - m->ext[i].start < m->ext[i].length) return i;
+    }
+    return -1;
+}
+
+// File block after `blk`: the FAT chain's successor
+static uint32_t ext_next(const pfs32_extent_map_t* m, uint32_t blk) {
+    int i = ext_find(m, blk);
+    if (i < 0) return PFS32_END_BLOCK;
+    if (blk + 1 < m->ext[i].start + m->ext[i].length) return blk + 1;
+    return (i + 1 < m->count) ? m->ext[i + 1].start : PFS32_END_BLOCK;
+}
+
+// Owners of an extent data block (reflinked files share them)
+static uint32_t ext_refs(uint32_t blk) {
+    uint32_t v = get_fat(blk);
+    return (v >= PFS32_REF_BASE + 2 && v <= PFS32_REF_BASE + PFS32_REF_MAX) ? v - PFS32_REF_BASE : 1;
+}
+
+// Drop one owner; the last one frees the block
+static void ext_put(uint32_t blk) {
+    uint32_t n = ext_refs(blk);
+    if (n > 2) set_fat(blk, PFS32_REF_BASE + n - 1);
+    else set_fat(blk, n == 2 ? PFS32_END_BLOCK : PFS32_FREE_BLOCK);
+}
+
+// Layout-neutral walkers: `m` is the file's extent map, or 0 for a chain
+static uint32_t file_next(const pfs32_extent_map_t* m, uint32_t blk) {
+    return m ? ext_next(m, blk) : get_fat(blk);
+}
+
+static uint32_t file_run(const pfs32_extent_map_t* m, uint32_t blk, uint32_t max, uint32_t* last) {
+    if (!m) return chain_run_length(blk, max, last);
+    int i = ext_find(m, blk);
+    uint32_t len = (i < 0) ? 1 : m->ext[i].start + m->ext[i].length - blk;
+    if (len > max) len = max;
+    *last = blk + len - 1;
+    return len;
+}
+
+// Grow or shrink the map to `blocks` data blocks (a cluster multiple).
+// New space is merged into the last extent when it follows on. Returns
+// PFS_ERR_FULL when the disk or the map runs out; the map is consistent
+// (possibly partly grown) either way and the caller writes it back.
+static int ext_resize(pfs32_extent_map_t* m, uint32_t blocks, int zero) {
+    while (m->blocks > blocks) {
+        pfs32_extent_t* e = &m->ext[m->count - 1];
+        uint32_t drop = m->blocks - blocks;
+        if (drop > e->length) drop = e->length;
+        for (uint32_t i = e->length - drop; i < e->length; i++) {
+            if (m->flags & PFS32_EXTENT_SHARED) ext_put(e->start + i);
+            else set_fat(e->start + i, PFS32_FREE_BLOCK);
+        }
+        e->length -= drop;
+        m->blocks -= drop;
+        if (e->length == 0) m->count--;
+    }
+    while (m->blocks < blocks) {
+        uint32_t got;
+        uint32_t blk = alloc_run(blocks - m->blocks, cluster_blocks, 0, &got, zero);
+        if (!blk) return PFS_ERR_FULL;
+        pfs32_extent_t* e = m->count ? &m->ext[m->count - 1] : 0;
+        if (e && e->start + e->length == blk) {
+            e->length += got;
+        } else if (m->count < PFS32_MAX_EXTENTS) {
+            m->ext[m->count].start = blk;
+            m->ext[m->count].length = got;
+            m->count++;
+        } else {
+            for (uint32_t i = 0; i < got; i++) set_fat(blk + i, PFS32_FREE_BLOCK);
+            return PFS_ERR_FULL;
+        }
+        m->blocks += got;
+    }
+    return PFS_OK;
+}
+
+// Write `size` bytes into the extents; same `queue` contract as write_chain
+static int ext_write(const pfs32_extent_map_t* m, const uint8_t* data, uint32_t size, int queue) {
+    uint32_t total_blocks = (size + 511) / 512;
+    uint32_t idx = 0;
+
+    for (int i = 0; i < m->count && idx < total_blocks; i++) {
+        uint32_t blk = m->ext[i].start;
+        uint32_t left = m->ext[i].length;
+        while (left > 0 && idx < total_blocks) {
+            uint32_t run = total_blocks - idx;
+            if (run > left) run = left;
+            if (run > PFS32_MAX_RUN) run = PFS32_MAX_RUN;
+
+            uint32_t offset = idx * 512;
+            uint32_t full = run;
+            if (offset + run * 512 > size) full--;
+            if (full > 0) {
+                int res = queue ? disk_queue_run(blk, full, (void*)(data + offset))
+                                : disk_rw_multi(1, blk, full, (void*)(data + offset));
+                if (res != PFS_OK) return PFS_ERR_IO;
+            }
+            if (full < run) {
+                uint8_t buf[512]; memset(buf, 0, 512);
+                memcpy(buf, data + offset + full * 512, size - offset - full * 512);
+                if (disk_rw(1, blk + full, buf) != PFS_OK) return PFS_ERR_IO;
+            }
+            idx += run;
+            blk += run;
+            left -= run;
+        }
+    }
+    return idx >= total_blocks ? PFS_OK : PFS_ERR_IO;
+}
+
+// Release a file's blocks, whatever its layout
+static void free_file(uint32_t start) {
+    if (!is_extent_file(start)) { free_chain(start); return; }
+    pfs32_extent_map_t m;
+    if (ext_load(start, &m) == PFS_OK) ext_resize(&m, 0, 0);
+    set_fat(start, PFS32_FREE_BLOCK);
+}
+
+// Give the file starting at *start a layout for `size` bytes: extents
+// when the volume has them and the data fills a cluster, a FAT chain
+// otherwise (write_chain grows it as it writes). Extents are allocated
+// here; *start changes when the layout does and the old one is freed.
+static int file_prepare(uint32_t* start, uint32_t size) {
+    int was_ext = is_extent_file(*start);
+
+    if (cluster_blocks && size >= cluster_blocks * PFS32_BLOCK_SIZE) {
+        pfs32_extent_map_t m;
+        uint32_t map = *start;
+        if (was_ext) {
+            if (ext_load(map, &m) != PFS_OK) return PFS_ERR_IO;
+            if (m.flags & PFS32_EXTENT_SHARED) {
+                // Everything is rewritten, so a reflinked file simply
+                // lets go of its blocks instead of copying them
+                ext_resize(&m, 0, 0);
+                m.flags = 0;
+            }
+        } else {
+            map = alloc_block();
+            if (!map) return PFS_ERR_FULL;
+            set_fat(map, PFS32_EXTENT_MAP);
+            ext_init(&m);
+        }
+        int res = ext_resize(&m, ext_blocks_for(size), 0);
+        if (res == PFS_OK) {
+            if (meta_write(map, &m) != PFS_OK) return PFS_ERR_IO;
+            if (!was_ext) { free_chain(*start); *start = map; }
+            return PFS_OK;
+        }
+        // Too fragmented for the map (or the disk is full): fall back to
+        // a chain, which write_chain reports on if space really is gone
+        ext_resize(&m, 0, 0);
+        set_fat(map, PFS32_FREE_BLOCK);
+        if (!was_ext) return PFS_OK;
+    } else if (was_ext) {
+        free_file(*start);
+    } else {
+        return PFS_OK;
+    }
+
+    uint32_t blk = alloc_block();
+    if (!blk) return PFS_ERR_FULL;
+    *start = blk;
+    return PFS_OK;
+}
+
+// Write a file's data along its layout (prepared by file_prepare)
+static int write_data(uint32_t start, const uint8_t* data, uint32_t size, int queue) {
+    if (is_extent_file(start)) {
+        pfs32_extent_map_t m;
+        if (ext_load(start, &m) != PFS_OK) return PFS_ERR_IO;
+        return ext_write(&m, data, size, queue);
+    }
+    return write_chain(start, data, size, queue);
+}
+
+// Zero bytes [from, to) of the file at `start` (`m` as for file_run).
+// Whole blocks go through the elevator from one zero buffer; a partial
+// block at either end is read, patched and written back.
+static int zero_range(const pfs32_extent_map_t* m, uint32_t start, uint32_t from, uint32_t to) {
+    if (from >= to) return PFS_OK;
+    uint8_t z[512]; memset(z, 0, 512);
+    uint32_t blk = start, last;
+    for (uint32_t skip = from / 512; skip > 0; ) {
+        if (blk < sb.data_start_block || blk >= sb.total_blocks) return PFS_ERR_IO;
+        skip -= file_run(m, blk, skip, &last);
+        blk = file_next(m, last);
+    }
+    int res = PFS_OK;
+    for (uint32_t off = from / 512 * 512; off < to && res == PFS_OK; off += 512) {
+        if (blk < sb.data_start_block || blk >= sb.total_blocks) { res = PFS_ERR_IO; break; }
+        uint32_t a = (from > off) ? from - off : 0;
+        uint32_t b = (to - off < 512) ? to - off : 512;
+        if (a == 0 && b == 512) {
+            if (disk_queue_run(blk, 1, z) != PFS_OK) res = PFS_ERR_IO;
+        } else {
+            uint8_t buf[512];
+            if (disk_rw(0, blk, buf) != PFS_OK) { res = PFS_ERR_IO; break; }
+            memset(buf + a, 0, b - a);
+            if (disk_rw(1, blk, buf) != PFS_OK) res = PFS_ERR_IO;
+        }
+        blk = file_next(m, blk);
+    }
+    if (disk_unplug() != 0) res = PFS_ERR_IO;
+    return res;
+}
+
 // --- Directory Logic ---
 
 int find_entry_in_buf(uint8_t* buf, const char* name, pfs32_direntry_t* out) {
@@ -270,28 +1359,716 @@ int find_entry_in_buf(uint8_t* buf, const char* name, pfs32_direntry_t* out) {
     return -1;
 }
 
-int find_entry_in_dir(uint32_t dir_start, const char* name, pfs32_direntry_t* out, uint32_t* out_blk, int* out_idx) {
-    uint32_t curr = dir_start;
-    while(curr != PFS32_END_BLOCK && curr != 0) {
-        uint8_t buf[512];
-        if(disk_rw(0, curr, buf) != PFS_OK) break;
-        
-        int idx = find_entry_in_buf(buf, name, out);
-        if (idx != -1) {
-            if(out_blk) *out_blk = curr;
-            if(out_idx) *out_idx = idx;
-            return PFS_OK;
-        }
-        curr = get_fat(curr);
+// --- Hashed Directories (PFS32_FEAT_DIR_HASH) ---
+// A linear directory whose chain reaches DIR_HASH_MIN_BLOCKS is rebuilt
+// in place as a hashed one (see pfs32_dir_header_t), so its start block
+// and everything pointing at it stay valid. A bucket chain reaching
+// DIR_HASH_MAX_CHAIN grows the table fourfold. v2 directories without
+// the header stay linear and work as before.
+#define DIR_HASH_MIN_BLOCKS  8      // 64 entries
+#define DIR_HASH_MIN_BUCKETS 16
+#define DIR_HASH_MAX_BUCKETS 4096   // 2 MB of bucket blocks
+#define DIR_HASH_MAX_CHAIN   4      // Blocks per bucket before growing
+
+static uint32_t dir_name_hash(const char* name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int is_dot_name(const char* name) {
+    return strcmp(name, ".") == 0 || strcmp(name, "..") == 0;
+}
+
+// Reads the first block of `dir`; returns 1 if it is a hashed header
+static int dir_hash_header(uint32_t dir, pfs32_dir_header_t* hdr) {
+    if (meta_read(dir, hdr) != PFS_OK) return 0;
+    return (hdr->dot.attributes & PFS32_ATTR_INDEXED) && hdr->magic == PFS32_DIR_HASH_MAGIC &&
+           hdr->bucket_count != 0 && (hdr->bucket_count & (hdr->bucket_count - 1)) == 0;
+}
+
+// Walks every block of a directory that can hold entries: the chain of a
+// linear one, or the header and then each bucket chain of a hashed one
+typedef struct {
+    uint32_t next;
+    int hashed;
+    uint32_t bucket;            // Next bucket to start
+    uint32_t bucket_start;
+    uint32_t bucket_count;
+} dir_iter_t;
+
+static void dir_iter_init(dir_iter_t* it, uint32_t dir) {
+    pfs32_dir_header_t hdr;
+    it->hashed = dir_hash_header(dir, &hdr);
+    it->next = dir;
+    it->bucket = 0;
+    it->bucket_start = it->hashed ? hdr.bucket_start : 0;
+    it->bucket_count = it->hashed ? hdr.bucket_count : 0;
+}
+
+// Next block, or 0 when done
+static uint32_t dir_iter_next(dir_iter_t* it) {
+    while (it->next == PFS32_END_BLOCK || it->next == 0) {
+        if (!it->hashed || it->bucket >= it->bucket_count) return 0;
+        it->next = it->bucket_start + it->bucket++;
+    }
+    uint32_t blk = it->next;
+    it->next = get_fat(blk);
+    return blk;
+}
+
+// Free every block of a directory
+static void dir_free_blocks(uint32_t dir) {
+    pfs32_dir_header_t hdr;
+    if (dir_hash_header(dir, &hdr)) {
+        for (uint32_t i = 0; i < hdr.bucket_count; i++) free_chain(hdr.bucket_start + i);
+    }
+    free_chain(dir);
+}
+
+typedef struct dir_extra {
+    uint32_t blk;
+    struct dir_extra* next;
+    uint8_t data[512];
+} dir_extra_t;
+
+// Rebuild `dir` as a hashed directory with `buckets` buckets (0 = sized
+// from the entry count). The new buckets are written before the header
+// that points at them; the old blocks are freed last.
+static int dir_rebuild(uint32_t dir, uint32_t buckets) {
+    pfs32_dir_header_t hdr;
+    uint8_t buf[512];
+    dir_iter_t it;
+    int old_hashed = dir_hash_header(dir, &hdr);
+    uint32_t old_start = hdr.bucket_start, old_count = hdr.bucket_count;
+
+    uint32_t n = 0, old_fat = 0, sec = 0;
+    dir_iter_init(&it, dir);
+    for (uint32_t blk = dir_iter_next(&it); blk; blk = dir_iter_next(&it)) {
+        if (meta_read(blk, buf) != PFS_OK) return PFS_ERR_IO;
+        fat_count(blk, &sec, &old_fat);
+        pfs32_direntry_t* d = (pfs32_direntry_t*)buf;
+        for (int i = 0; i < 8; i++) {
+            if (d[i].filename[0] != 0 && !(blk == dir && i < 2)) n++;
+        }
+    }
+    if (!buckets) {
+        buckets = DIR_HASH_MIN_BUCKETS;
+        while (buckets * 4 < n && buckets < DIR_HASH_MAX_BUCKETS) buckets <<= 1;
+    }
+    if (buckets > DIR_HASH_MAX_BUCKETS || (old_hashed && buckets <= old_count)) return PFS_ERR_FULL;
+
+    // Count the overflow blocks the entries will need, so the FAT of the
+    // buckets (one run), the overflow blocks and the old blocks can be
+    // reserved before anything changes
+    uint32_t* fill = (uint32_t*)kzalloc(buckets * sizeof(uint32_t));
+    uint32_t extra = 0;
+    if (!fill) return PFS_ERR_FULL;
+    dir_iter_init(&it, dir);
+    for (uint32_t blk = dir_iter_next(&it); blk; blk = dir_iter_next(&it)) {
+        if (meta_read(blk, buf) != PFS_OK) { kfree(fill); return PFS_ERR_IO; }
+        pfs32_direntry_t* d = (pfs32_direntry_t*)buf;
+        for (int i = 0; i < 8; i++) {
+            if (d[i].filename[0] == 0 || (blk == dir && i < 2)) continue;
+            char clean[41]; sanitize_name(clean, d[i].filename, 40);
+            uint32_t b = dir_name_hash(clean) & (buckets - 1);
+            if (++fill[b] > 8 && fill[b] % 8 == 1) extra++;
+        }
+    }
+    kfree(fill);
+
+    // Pending data and timestamps are keyed by entry location
+    if (wb_writeback_all() != PFS_OK) return PFS_ERR_IO;
+    int res = jnl_reserve(2, fat_span(buckets, 1) + fat_span(extra, extra) + old_fat);
+    if (res != PFS_OK) return res;
+
+    uint32_t got;
+    uint32_t start = alloc_blocks(buckets, &got, 0);
+    if (!start) return PFS_ERR_FULL;
+    uint8_t* run = 0;
+    uint8_t** tail = 0;
+    uint32_t* tail_blk = 0;
+    dir_extra_t* extras = 0;
+    res = PFS_ERR_FULL;
+    if (got < buckets) goto fail;
+
+    run = (uint8_t*)kmalloc(buckets * 512);
+    tail = (uint8_t**)kmalloc(buckets * sizeof(uint8_t*));
+    tail_blk = (uint32_t*)kmalloc(buckets * sizeof(uint32_t));
+    if (!run || !tail || !tail_blk) goto fail;
+    memset(run, 0, buckets * 512);
+    for (uint32_t b = 0; b < buckets; b++) {
+        set_fat(start + b, PFS32_END_BLOCK);
+        tail[b] = run + b * 512;
+        tail_blk[b] = start + b;
+    }
+
+    // Distribute the entries; a full bucket block gets an overflow block
+    dir_iter_init(&it, dir);
+    for (uint32_t blk = dir_iter_next(&it); blk; blk = dir_iter_next(&it)) {
+        if (meta_read(blk, buf) != PFS_OK) { res = PFS_ERR_IO; goto fail; }
+        pfs32_direntry_t* d = (pfs32_direntry_t*)buf;
+        for (int i = 0; i < 8; i++) {
+            if (d[i].filename[0] == 0 || (blk == dir && i < 2)) continue;
+            char clean[41]; sanitize_name(clean, d[i].filename, 40);
+            uint32_t b = dir_name_hash(clean) & (buckets - 1);
+            pfs32_direntry_t* slots = (pfs32_direntry_t*)tail[b];
+            int k = 0;
+            while (k < 8 && slots[k].filename[0] != 0) k++;
+            if (k == 8) {
+                dir_extra_t* x = (dir_extra_t*)kmalloc(sizeof(dir_extra_t));
+                uint32_t xgot;
+                uint32_t nb = x ? alloc_blocks(1, &xgot, 0) : 0;
+                if (!nb) { if (x) kfree(x); goto fail; }
+                memset(x->data, 0, 512);
+                x->blk = nb;
+                x->next = extras;
+                extras = x;
+                set_fat(tail_blk[b], nb);
+                tail[b] = x->data;
+                tail_blk[b] = nb;
+                slots = (pfs32_direntry_t*)x->data;
+                k = 0;
+            }
+            slots[k] = d[i];
+        }
+    }
+
+    res = PFS_ERR_IO;
+    if (disk_rw_multi(1, start, buckets, run) != PFS_OK) goto fail;
+    for (dir_extra_t* x = extras; x; x = x->next) {
+        if (disk_rw(1, x->blk, x->data) != PFS_OK) goto fail;
+    }
+
+    // Switch the header over, then release the old layout
+    uint32_t old_next = get_fat(dir);
+    hdr.dot.attributes |= PFS32_ATTR_INDEXED;
+    memset(&hdr.zero, 0, 512 - 2 * sizeof(pfs32_direntry_t));
+    hdr.version = PFS32_DIR_HASH_VERSION;
+    hdr.magic = PFS32_DIR_HASH_MAGIC;
+    hdr.bucket_start = start;
+    hdr.bucket_count = buckets;
+    if (meta_write(dir, &hdr) != PFS_OK) goto fail;
+    set_fat(dir, PFS32_END_BLOCK);
+    if (old_hashed) {
+        for (uint32_t b = 0; b < old_count; b++) free_chain(old_start + b);
+    } else {
+        free_chain(old_next);
+    }
+
+    if (!(sb.features & PFS32_FEAT_DIR_HASH)) {
+        sb.features |= PFS32_FEAT_DIR_HASH;
+        meta_write(0, &sb);
+    }
+    dcache_clear();
+    meta_commit();
+    // The caller's operation reserved its room before this used it up
+    jnl_reserve(JNL_OP_META, JNL_OP_FAT);
+    res = PFS_OK;
+    start = 0; // Now owned by the directory
+
+fail:
+    if (start) {
+        for (dir_extra_t* x = extras; x; x = x->next) set_fat(x->blk, PFS32_FREE_BLOCK);
+        for (uint32_t b = 0; b < got && b < buckets; b++) set_fat(start + b, PFS32_FREE_BLOCK);
+    }
+    while (extras) {
+        dir_extra_t* x = extras;
+        extras = x->next;
+        kfree(x);
+    }
+    if (run) kfree(run);
+    if (tail) kfree(tail);
+    if (tail_blk) kfree(tail_blk);
+    return res;
+}
+
+// Find a free slot for `name` (already sanitized) in directory `dir`,
+// extending it as needed. `buf` receives the slot's block.
+static int dir_alloc_slot(uint32_t dir, const char* name, uint32_t* out_blk, int* out_idx, uint8_t* buf) {
+    pfs32_dir_header_t hdr;
+    int hashed = dir_hash_header(dir, &hdr);
+    uint32_t curr = hashed ? hdr.bucket_start + (dir_name_hash(name) & (hdr.bucket_count - 1)) : dir;
+    uint32_t len = 0;
+
+    while(1) {
+        if (meta_read(curr, buf) != PFS_OK) return PFS_ERR_IO;
+        pfs32_direntry_t* entries = (pfs32_direntry_t*)buf;
+        for(int i=0; i<8; i++) {
+            if(entries[i].filename[0] == 0 && !(hashed && curr == dir)) {
+                *out_blk = curr;
+                *out_idx = i;
+                return PFS_OK;
+            }
+        }
+        len++;
+
+        uint32_t next = get_fat(curr);
+        if(next == PFS32_END_BLOCK || next == 0) {
+            // Too long to keep scanning: switch to (or grow) the hash table
+            uint32_t limit = hashed ? DIR_HASH_MAX_CHAIN : DIR_HASH_MIN_BLOCKS;
+            if (len >= limit && dir_rebuild(dir, hashed ? hdr.bucket_count * 4 : 0) == PFS_OK) {
+                return dir_alloc_slot(dir, name, out_blk, out_idx, buf);
+            }
+
+            // Fully rewritten by the caller, no need to zero it first
+            uint32_t got;
+            uint32_t new_blk = alloc_blocks(1, &got, 0);
+            if(new_blk == 0) return PFS_ERR_FULL;
+            set_fat(curr, new_blk);
+
+            memset(buf, 0, 512);
+            *out_blk = new_blk;
+            *out_idx = 0;
+            return PFS_OK;
+        }
+        curr = next;
+    }
+}
+
+int find_entry_in_dir(uint32_t dir_start, const char* name, pfs32_direntry_t* out, uint32_t* out_blk, int* out_idx) {
+    uint8_t buf[512];
+    uint32_t blk;
+    int idx;
+
+    // Dentry cache first. A positive hit is checked against the block, so
+    // a stale location costs a scan rather than a wrong answer.
+    int cached = dcache_lookup(dir_start, name, &blk, &idx);
+    if (cached == DCACHE_NEGATIVE) return PFS_ERR_NOT_FOUND;
+    if (cached == DCACHE_FOUND) {
+        if (meta_read(blk, buf) == PFS_OK) {
+            lazy_apply(blk, buf);
+            pfs32_direntry_t* e = &((pfs32_direntry_t*)buf)[idx];
+            char clean[41]; sanitize_name(clean, e->filename, 40);
+            if (e->filename[0] != 0 && strcmp(clean, name) == 0) {
+                if(out) *out = *e;
+                if(out_blk) *out_blk = blk;
+                if(out_idx) *out_idx = idx;
+                return PFS_OK;
+            }
+        }
+        dcache_remove(dir_start, name);
+    }
+
+    // A hashed directory only needs the one bucket chain
+    pfs32_dir_header_t hdr;
+    uint32_t curr = dir_start;
+    if (!is_dot_name(name) && dir_hash_header(dir_start, &hdr)) {
+        curr = hdr.bucket_start + (dir_name_hash(name) & (hdr.bucket_count - 1));
+    }
+    while(curr != PFS32_END_BLOCK && curr != 0) {
+        if(meta_read(curr, buf) != PFS_OK) return PFS_ERR_NOT_FOUND; // Not cached: I/O error
+        lazy_apply(curr, buf);
+        
+        idx = find_entry_in_buf(buf, name, out);
+        if (idx != -1) {
+            if(out_blk) *out_blk = curr;
+            if(out_idx) *out_idx = idx;
+            dcache_insert(dir_start, name, curr, idx);
+            return PFS_OK;
+        }
+        curr = get_fat(curr);
+    }
+    dcache_insert_negative(dir_start, name);
+    return PFS_ERR_NOT_FOUND;
+}
+
+// --- Filename Index (PFS32_FEAT_NAME_INDEX) ---
+// The records are held in RAM while mounted, next to the disk block of
+// each group of eight. Directory records are also hashed by their start
+// block, which is how a hit's path is put back together. An index that
+// could not be loaded (or a volume without one) is rebuilt by the next
+// search. v2 kernels would change the tree without it, so a v2 volume
+// keeps its index in RAM only.
+#define NIX_PER_BLOCK (PFS32_BLOCK_SIZE / sizeof(pfs32_name_record_t))
+#define NIX_DIR_HASH  1024      // Power of two
+#define NIX_MAX_DEPTH 32        // Directories followed up from a hit
+#define NIX_NONE      0xFFFFFFFF
+
+static pfs32_name_record_t* nix_rec = 0;
+static uint32_t* nix_blk = 0;          // Disk block of each record block
+static uint32_t* nix_dir_next = 0;     // Next directory record in the bucket
+static uint32_t nix_dir_head[NIX_DIR_HASH];
+static uint32_t nix_blocks = 0;
+static uint32_t nix_free = 0;          // No free record below this one
+static int nix_on = 0;                 // Loaded and kept up to date
+
+static inline int nix_on_disk(void) {
+    return sb.version >= PFS32_VERSION;
+}
+
+static void nix_release(void) {
+    if (nix_rec) kfree(nix_rec);
+    if (nix_blk) kfree(nix_blk);
+    if (nix_dir_next) kfree(nix_dir_next);
+    nix_rec = 0;
+    nix_blk = 0;
+    nix_dir_next = 0;
+    nix_blocks = 0;
+    nix_free = 0;
+    nix_on = 0;
+    for (int i = 0; i < NIX_DIR_HASH; i++) nix_dir_head[i] = NIX_NONE;
+}
+
+// Room for `blocks` record blocks; new records read as free
+static int nix_grow(uint32_t blocks) {
+    if (blocks <= nix_blocks) return PFS_OK;
+    uint32_t n = blocks * NIX_PER_BLOCK;
+    pfs32_name_record_t* r = (pfs32_name_record_t*)krealloc(nix_rec, n * sizeof(pfs32_name_record_t));
+    if (!r) return PFS_ERR_FULL;
+    nix_rec = r;
+    uint32_t* b = (uint32_t*)krealloc(nix_blk, blocks * sizeof(uint32_t));
+    if (!b) return PFS_ERR_FULL;
+    nix_blk = b;
+    uint32_t* d = (uint32_t*)krealloc(nix_dir_next, n * sizeof(uint32_t));
+    if (!d) return PFS_ERR_FULL;
+    nix_dir_next = d;
+    memset(&nix_rec[nix_blocks * NIX_PER_BLOCK], 0, (n - nix_blocks * NIX_PER_BLOCK) * sizeof(pfs32_name_record_t));
+    for (uint32_t i = nix_blocks; i < blocks; i++) nix_blk[i] = 0;
+    nix_blocks = blocks;
+    return PFS_OK;
+}
+
+static inline char nix_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static void nix_signature(const char* name, uint32_t sig[2]) {
+    sig[0] = sig[1] = 0;
+    for (int i = 0; name[i] && name[i + 1] && name[i + 2]; i++) {
+        uint32_t h = ((uint32_t)(uint8_t)nix_lower(name[i]) * 31 + (uint8_t)nix_lower(name[i + 1])) * 31 +
+                     (uint8_t)nix_lower(name[i + 2]);
+        h %= PFS32_INDEX_SIG_BITS;
+        sig[h / 32] |= 1u << (h % 32);
+    }
+}
+
+// Case-insensitive substring test
+static int nix_contains(const char* name, const char* pat) {
+    for (; *name; name++) {
+        int k = 0;
+        while (pat[k] && nix_lower(name[k]) == nix_lower(pat[k])) k++;
+        if (!pat[k]) return 1;
+    }
+    return !*pat;
+}
+
+static inline uint32_t nix_dir_hash(uint32_t start) {
+    return (start * 2654435761u) & (NIX_DIR_HASH - 1);
+}
+
+// Directory record whose start block is `start`, or NIX_NONE
+static uint32_t nix_dir_find(uint32_t start) {
+    for (uint32_t i = nix_dir_head[nix_dir_hash(start)]; i != NIX_NONE; i = nix_dir_next[i]) {
+        if (nix_rec[i].start_block == start) return i;
+    }
+    return NIX_NONE;
+}
+
+static void nix_dir_link(uint32_t i) {
+    uint32_t h = nix_dir_hash(nix_rec[i].start_block);
+    nix_dir_next[i] = nix_dir_head[h];
+    nix_dir_head[h] = i;
+}
+
+static void nix_dir_unlink(uint32_t i) {
+    uint32_t* link = &nix_dir_head[nix_dir_hash(nix_rec[i].start_block)];
+    while (*link != NIX_NONE) {
+        if (*link == i) { *link = nix_dir_next[i]; return; }
+        link = &nix_dir_next[*link];
+    }
+}
+
+static void nix_set(uint32_t i, uint32_t parent, const char* name, uint32_t start) {
+    pfs32_name_record_t* r = &nix_rec[i];
+    memset(r, 0, sizeof(*r));
+    strncpy(r->filename, name, 39);
+    r->parent = parent;
+    r->start_block = start;
+    r->attributes = start ? PFS32_ATTR_DIRECTORY : 0;
+    uint32_t sig[2];
+    nix_signature(r->filename, sig);
+    r->signature[0] = sig[0];
+    r->signature[1] = sig[1];
+}
+
+// Log the block holding record `i`
+static int nix_store(uint32_t i) {
+    if (!nix_on_disk()) return PFS_OK;
+    uint32_t b = i / NIX_PER_BLOCK;
+    return meta_write(nix_blk[b], &nix_rec[b * NIX_PER_BLOCK]);
+}
+
+// Read the chain from sb.index_start. A volume that has the feature but
+// no blocks yet simply has no records. Every block must be in use and
+// the chain exactly sb.index_blocks long; anything else means the index
+// was not kept (a v2 kernel, a crash before the fix-up) and it is
+// dropped. Its blocks are left for fsck rather than freed on trust.
+static int nix_load(void) {
+    nix_release();
+    if (!(sb.features & PFS32_FEAT_NAME_INDEX)) return PFS_ERR_NOT_FOUND;
+
+    uint32_t blk = sb.index_start, n = 0;
+    while (blk != 0 && blk != PFS32_END_BLOCK) {
+        if (blk < sb.data_start_block || blk >= sb.total_blocks) goto fail;
+        uint32_t last;
+        uint32_t run = chain_run_length(blk, PFS32_MAX_RUN, &last);
+        uint32_t next = get_fat(last);
+        if (n + run > sb.index_blocks || next == PFS32_FREE_BLOCK || next == PFS32_EXTENT_MAP) goto fail;
+        if (nix_grow(n + run) != PFS_OK) goto fail;
+        if (disk_rw_multi(0, blk, run, &nix_rec[n * NIX_PER_BLOCK]) != PFS_OK) goto fail;
+        for (uint32_t k = 0; k < run; k++) nix_blk[n + k] = blk + k;
+        n += run;
+        blk = next;
+    }
+    if (n != sb.index_blocks) goto fail;
+
+    for (uint32_t i = 0; i < n * NIX_PER_BLOCK; i++) {
+        nix_rec[i].filename[39] = 0;
+        if (nix_rec[i].filename[0] && (nix_rec[i].attributes & PFS32_ATTR_DIRECTORY)) nix_dir_link(i);
+    }
+    nix_on = 1;
+    return PFS_OK;
+
+fail:
+    nix_release();
+    sb.index_start = 0;
+    sb.index_blocks = 0;
+    sb.features &= ~PFS32_FEAT_NAME_INDEX;
+    meta_write(0, &sb);
+    s_printf("[PFS32] Filename index unreadable, rebuilt on the next search\n");
+    return PFS_ERR_IO;
+}
+
+// The records no longer match the tree: drop the index, and let the
+// next search build a new one
+static void nix_fail(void) {
+    if (sb.index_start) free_chain(sb.index_start);
+    sb.index_start = 0;
+    sb.index_blocks = 0;
+    sb.features &= ~PFS32_FEAT_NAME_INDEX;
+    meta_write(0, &sb);
+    nix_release();
+}
+
+// A free record; a block is added to the chain when all are taken
+static uint32_t nix_alloc(void) {
+    uint32_t total = nix_blocks * NIX_PER_BLOCK;
+    while (nix_free < total && nix_rec[nix_free].filename[0]) nix_free++;
+    if (nix_free < total) return nix_free;
+    if (!nix_on_disk()) return nix_grow(nix_blocks + 1) == PFS_OK ? nix_free : NIX_NONE;
+
+    uint32_t b = alloc_block();
+    if (!b) return NIX_NONE;
+    if (nix_grow(nix_blocks + 1) != PFS_OK) {
+        set_fat(b, PFS32_FREE_BLOCK);
+        return NIX_NONE;
+    }
+    nix_blk[nix_blocks - 1] = b;
+    if (nix_blocks == 1) sb.index_start = b;
+    else set_fat(nix_blk[nix_blocks - 2], b);
+    sb.index_blocks = nix_blocks;
+    meta_write(0, &sb);
+    return nix_free;
+}
+
+static uint32_t nix_find(uint32_t parent, const char* name) {
+    uint32_t total = nix_blocks * NIX_PER_BLOCK;
+    for (uint32_t i = 0; i < total; i++) {
+        if (nix_rec[i].parent == parent && nix_rec[i].filename[0] &&
+            strncmp(nix_rec[i].filename, name, 39) == 0) return i;
+    }
+    return NIX_NONE;
+}
+
+// Drop record `i` and, for a directory, every record below it
+static void nix_remove(uint32_t i) {
+    uint32_t start = (nix_rec[i].attributes & PFS32_ATTR_DIRECTORY) ? nix_rec[i].start_block : 0;
+    if (start) nix_dir_unlink(i);
+    memset(&nix_rec[i], 0, sizeof(pfs32_name_record_t));
+    nix_store(i);
+    if (i < nix_free) nix_free = i;
+    if (!start) return;
+
+    uint32_t total = nix_blocks * NIX_PER_BLOCK;
+    for (uint32_t k = 0; k < total; k++) {
+        if (nix_rec[k].filename[0] && nix_rec[k].parent == start) nix_remove(k);
+    }
+}
+
+// Entry changes, called inside the transaction that makes them.
+// `dir_start` is a new directory's start block, 0 for a file.
+static void nix_created(uint32_t parent, const char* name, uint32_t dir_start) {
+    if (!nix_on) return;
+    uint32_t i = nix_alloc();
+    if (i == NIX_NONE) { nix_fail(); return; }
+    nix_set(i, parent, name, dir_start);
+    if (dir_start) nix_dir_link(i);
+    if (nix_store(i) != PFS_OK) nix_fail();
+}
+
+static void nix_deleted(uint32_t parent, const char* name) {
+    if (!nix_on) return;
+    uint32_t i = nix_find(parent, name);
+    if (i == NIX_NONE) { nix_fail(); return; }
+    nix_remove(i);
+}
+
+static void nix_renamed(uint32_t parent, const char* oldname, const char* newname) {
+    if (!nix_on) return;
+    uint32_t i = nix_find(parent, oldname);
+    if (i == NIX_NONE) { nix_fail(); return; }
+    nix_set(i, parent, newname, nix_rec[i].start_block);
+    if (nix_store(i) != PFS_OK) nix_fail();
+}
+
+// Index the whole tree. The records double as the queue of directories
+// still to be read, so the walk is breadth-first through one array; a
+// directory reached twice is only read the first time. The chain is
+// written before the superblock points at it, the old one freed last.
+// On a v2 volume the records stay in RAM.
+static int nix_build(void) {
+    uint32_t old = nix_on ? sb.index_start : 0;
+    nix_release();
+
+    uint32_t count = 0, next = 0;
+    uint32_t dir = sb.root_dir_block;
+    int res = PFS_OK;
+    uint8_t buf[512];
+    while (res == PFS_OK) {
+        dir_iter_t it;
+        dir_iter_init(&it, dir);
+        for (uint32_t blk = dir_iter_next(&it); blk && res == PFS_OK; blk = dir_iter_next(&it)) {
+            if (meta_read(blk, buf) != PFS_OK) { res = PFS_ERR_IO; break; }
+            pfs32_direntry_t* d = (pfs32_direntry_t*)buf;
+            for (int k = 0; k < 8; k++) {
+                char name[40];
+                memcpy(name, d[k].filename, 39);
+                name[39] = 0;
+                if (name[0] == 0 || is_dot_name(name)) continue;
+                if (count == nix_blocks * NIX_PER_BLOCK &&
+                    nix_grow(nix_blocks ? nix_blocks * 2 : 8) != PFS_OK) { res = PFS_ERR_FULL; break; }
+
+                uint32_t start = (d[k].attributes & PFS32_ATTR_DIRECTORY) ? d[k].start_block : 0;
+                nix_set(count, dir, name, start);
+                if (start && start != sb.root_dir_block && start >= sb.data_start_block &&
+                    start < sb.total_blocks && nix_dir_find(start) == NIX_NONE) nix_dir_link(count);
+                count++;
+            }
+        }
+
+        while (next < count && !((nix_rec[next].attributes & PFS32_ATTR_DIRECTORY) &&
+                                 nix_dir_find(nix_rec[next].start_block) == next)) next++;
+        if (next == count) break;
+        dir = nix_rec[next++].start_block;
+    }
+
+    if (res == PFS_OK && !nix_on_disk()) {
+        nix_free = count;
+        nix_on = 1;
+        return PFS_OK;
+    }
+
+    uint32_t blocks = (count + NIX_PER_BLOCK - 1) / NIX_PER_BLOCK;
+    uint32_t start = 0;
+    if (res == PFS_OK) res = jnl_reserve(1, fat_alloc(blocks) + (old ? chain_fat(sb.index_start) : 0));
+    if (res == PFS_OK && blocks) {
+        uint32_t got;
+        start = alloc_blocks(blocks, &got, 0);
+        if (!start) res = PFS_ERR_FULL;
+        else if ((res = write_chain(start, (uint8_t*)nix_rec, blocks * PFS32_BLOCK_SIZE, 0)) != PFS_OK) free_chain(start);
+    }
+    if (res != PFS_OK) {
+        nix_release();
+        return res;
+    }
+
+    for (uint32_t i = 0, b = start; i < blocks; i++, b = get_fat(b)) nix_blk[i] = b;
+    nix_blocks = blocks;
+    nix_free = count;
+    nix_on = 1;
+
+    sb.index_start = start;
+    sb.index_blocks = blocks;
+    sb.features |= PFS32_FEAT_NAME_INDEX;
+    meta_write(0, &sb);
+    if (old) free_chain(old);
+    meta_commit();
+    return PFS_OK;
+}
+
+// Absolute path of record `i`, following parent directories up to the root
+static int nix_path(uint32_t i, char* out, uint32_t max) {
+    uint32_t up[NIX_MAX_DEPTH];
+    int depth = 0;
+    for (uint32_t cur = i; ; ) {
+        if (depth == NIX_MAX_DEPTH) return PFS_ERR_NOT_FOUND;
+        up[depth++] = cur;
+        if (nix_rec[cur].parent == sb.root_dir_block) break;
+        cur = nix_dir_find(nix_rec[cur].parent);
+        if (cur == NIX_NONE) return PFS_ERR_NOT_FOUND;
     }
-    return PFS_ERR_NOT_FOUND;
+
+    uint32_t len = 0;
+    while (depth-- > 0) {
+        const char* name = nix_rec[up[depth]].filename;
+        uint32_t n = strlen(name);
+        if (len + 1 + n >= max) return PFS_ERR_NOT_FOUND;
+        out[len++] = '/';
+        memcpy(out + len, name, n);
+        len += n;
+    }
+    out[len] = 0;
+    return PFS_OK;
 }
 
 // --- Lifecycle ---
 
+static int cluster_size_ok(uint32_t size) {
+    return size >= PFS32_CLUSTER_MIN && size <= PFS32_CLUSTER_MAX && (size & (size - 1)) == 0;
+}
+
+// Journal size for a volume: PFS32_JOURNAL_BLOCKS, or a sixteenth of a
+// small one. 0 = too small to be worth it.
+static uint32_t jnl_size_for(uint32_t total) {
+    uint32_t blocks = total / 16;
+    if (blocks > PFS32_JOURNAL_BLOCKS) blocks = PFS32_JOURNAL_BLOCKS;
+    return blocks >= 4 * (PFS32_JOURNAL_TXN_MAX + 2) ? blocks : 0;
+}
+
+// Carve a zeroed, empty journal out of the data area
+static int jnl_create(uint32_t blocks) {
+    uint32_t got;
+    uint32_t start = alloc_run(blocks, 1, 0, &got, 1);
+    if (!start) return PFS_ERR_FULL;
+    if (got < blocks) {
+        for (uint32_t i = 0; i < got; i++) set_fat(start + i, PFS32_FREE_BLOCK);
+        return PFS_ERR_FULL;
+    }
+    sb.journal_start = start;
+    sb.journal_blocks = blocks;
+    if (jnl_write_header(1) != PFS_OK) return PFS_ERR_IO;
+    sb.features |= PFS32_FEAT_JOURNAL;
+    return PFS_OK;
+}
+
 int pfs32_init(uint32_t start, uint32_t total) {
+    return pfs32_mount(start, total, 0);
+}
+
+int pfs32_mount(uint32_t start, uint32_t total, uint32_t opts) {
+    wb_discard_all();
+    dcache_clear();
     init_fat_cache();
+    nix_release();
+    mounted = 0;
+    jnl_on = 0;
     disk_start = start;
+    mount_opts = opts;
+    last_alloc_search_ptr = 0;
     memset(&sb, 0, sizeof(sb));
     memset(&stats, 0, sizeof(stats));
     
@@ -299,18 +2076,92 @@ int pfs32_init(uint32_t start, uint32_t total) {
     if(res != 0) return PFS_ERR_IO;
     
     if (sb.magic != PFS32_MAGIC) return PFS_ERR_NO_FS;
+    if (sb.version > PFS32_VERSION) return PFS_ERR_NO_FS;
+
+    // v3: extent allocation unit. A volume whose cluster size makes no
+    // sense cannot be read safely.
+    cluster_blocks = 0;
+    if (sb.features & PFS32_FEAT_EXTENTS) {
+        if (!cluster_size_ok(sb.cluster_size)) return PFS_ERR_NO_FS;
+        cluster_blocks = sb.cluster_size / PFS32_BLOCK_SIZE;
+    }
     
     mounted = 1;
+
+    // Finish whatever committed transactions did not reach their home
+    // blocks before the FAT and superblock are trusted
+    res = jnl_open();
+    if (res != PFS_OK) {
+        mounted = 0;
+        return res;
+    }
+    if (jnl_on && (disk_read_block(disk_start, &sb) != 0 || sb.magic != PFS32_MAGIC)) {
+        mounted = 0;
+        jnl_on = 0;
+        return PFS_ERR_IO;
+    }
+
+    if (mount_opts & PFS32_MOUNT_FAT_RESIDENT) {
+        if (fat_load_resident() != PFS_OK) {
+            s_printf("[PFS32] Resident FAT unavailable, using sector cache\n");
+        }
+    }
+    if (fsmap_build() != PFS_OK) {
+        s_printf("[PFS32] Free-space bitmap unavailable, using FAT scan\n");
+    }
+    nix_load();
     return PFS_OK;
 }
 
+// Write a fresh FAT in which the first `reserved` blocks (superblock,
+// FAT, root directory) are taken and the rest free. The table is built
+// a buffer-load at a time and written with multi-sector transfers; going
+// through the sector cache costs a read and a write per FAT sector.
+static int fat_format(uint32_t reserved) {
+    uint32_t cap;
+    uint8_t* buf = copy_buf(&cap);
+    if (!buf) return PFS_ERR_FULL;
+
+    uint32_t per_block = PFS32_BLOCK_SIZE / 4;
+    int res = PFS_OK;
+    for (uint32_t i = 0; i < sb.fat_blocks && res == PFS_OK; i += cap) {
+        uint32_t n = (sb.fat_blocks - i < cap) ? sb.fat_blocks - i : cap;
+        memset(buf, 0, n * PFS32_BLOCK_SIZE);
+        uint32_t* ent = (uint32_t*)buf;
+        uint32_t first = i * per_block;
+        for (uint32_t k = first; k < reserved && k < first + n * per_block; k++) {
+            ent[k - first] = PFS32_END_BLOCK;
+        }
+        res = disk_rw_multi(1, 1 + i, n, buf);
+    }
+    kfree(buf);
+    return res;
+}
+
 int pfs32_format(const char* label, uint32_t total) {
+    return pfs32_format_cluster(label, total, PFS32_CLUSTER_DEFAULT);
+}
+
+// cluster_size 0 writes a v2 volume (FAT chains only) for older kernels
+int pfs32_format_cluster(const char* label, uint32_t total, uint32_t cluster_size) {
+    if (cluster_size && !cluster_size_ok(cluster_size)) return PFS_ERR_PARAM;
+    wb_discard_all();
+    dcache_clear();
     init_fat_cache();
+    fsmap_release();
+    nix_release();
+    jnl_on = 0;
     memset(&sb, 0, sizeof(sb));
     sb.magic = PFS32_MAGIC;
-    sb.version = PFS32_VERSION;
+    sb.version = cluster_size ? PFS32_VERSION : PFS32_VERSION_FAT;
     sb.block_size = PFS32_BLOCK_SIZE;
     sb.total_blocks = total;
+    if (cluster_size) {
+        sb.features |= PFS32_FEAT_EXTENTS | PFS32_FEAT_NAME_INDEX;
+        sb.cluster_size = cluster_size;
+    }
+    cluster_blocks = cluster_size / PFS32_BLOCK_SIZE;
+    nix_on = cluster_size != 0; // Empty until the first entry
     
     uint32_t fat_blocks = (total + 127) / 128;
     sb.fat_blocks = fat_blocks;
@@ -326,16 +2177,12 @@ int pfs32_format(const char* label, uint32_t total) {
         return PFS_ERR_IO;
     }
 
-    uint8_t zero[512]; memset(zero, 0, 512);
-    for(uint32_t i=1; i <= fat_blocks; i++) {
-        disk_write_block(disk_start + i, zero);
-    }
-    
-    for(uint32_t i=0; i <= sb.root_dir_block; i++) {
-        set_fat(i, PFS32_END_BLOCK);
+    if (fat_format(sb.root_dir_block + 1) != PFS_OK) {
+        mounted = 0;
+        return PFS_ERR_IO;
     }
-    flush_fat();
 
+    uint8_t zero[512];
     pfs32_direntry_t* root = (pfs32_direntry_t*)zero;
     memset(zero, 0, 512);
     
@@ -358,6 +2205,44 @@ int pfs32_format(const char* label, uint32_t total) {
     if(disk_write_block(disk_start + sb.root_dir_block, zero) != 0) return PFS_ERR_IO;
     
     flush_fat();
+    fsmap_build();
+
+    // v3 volumes journal their metadata; v2 kernels would not replay it
+    uint32_t jblocks = cluster_size ? jnl_size_for(total) : 0;
+    if (jblocks) {
+        if (jnl_create(jblocks) != PFS_OK) return PFS_ERR_IO;
+        flush_fat();
+        if (disk_write_block(disk_start, &sb) != 0) return PFS_ERR_IO;
+        if (jnl_open() != PFS_OK) return PFS_ERR_IO;
+    }
+    return PFS_OK;
+}
+
+// Migrate the mounted volume to v3 in place. Nothing is moved: files keep
+// their FAT chains and become extent-mapped the next time they are
+// rewritten. A journal is added if there is room for one.
+int pfs32_upgrade(uint32_t cluster_size) {
+    if (!mounted) return PFS_ERR_NO_FS;
+    if (!cluster_size_ok(cluster_size)) return PFS_ERR_PARAM;
+    if ((sb.features & PFS32_FEAT_EXTENTS) && sb.cluster_size != cluster_size) return PFS_ERR_EXISTS;
+    uint32_t jblocks = (sb.features & PFS32_FEAT_JOURNAL) ? 0 : jnl_size_for(sb.total_blocks);
+    if ((sb.features & PFS32_FEAT_EXTENTS) && !jblocks) return PFS_OK;
+    if (pfs32_sync() != PFS_OK) return PFS_ERR_IO;
+
+    sb.version = PFS32_VERSION;
+    sb.features |= PFS32_FEAT_EXTENTS;
+    nix_release(); // A RAM-only index is written out by the next search
+    sb.cluster_size = cluster_size;
+    cluster_blocks = cluster_size / PFS32_BLOCK_SIZE;
+    if (jblocks && jnl_create(jblocks) != PFS_OK) {
+        s_printf("[PFS32] No room for a journal\n");
+        jblocks = 0;
+    }
+    // The FAT must describe the journal before the superblock points at it
+    flush_fat();
+    if (disk_rw(1, 0, &sb) != PFS_OK) return PFS_ERR_IO;
+    if (jblocks && jnl_open() != PFS_OK) return PFS_ERR_IO;
+    s_printf(jblocks ? "[PFS32] Upgraded to v3 with journal\n" : "[PFS32] Upgraded to v3\n");
     return PFS_OK;
 }
 
@@ -416,45 +2301,21 @@ int pfs32_create_node(const char* path, int is_dir) {
     uint32_t pblk;
     if(get_dir_block(parent, &pblk) != PFS_OK) return PFS_ERR_NOT_FOUND;
     if(find_entry_in_dir(pblk, name, 0, 0, 0) == PFS_OK) return PFS_ERR_EXISTS;
+    int res = jnl_reserve(JNL_OP_META, JNL_OP_FAT);
+    if (res != PFS_OK) return res;
 
-    uint32_t curr = pblk;
     uint32_t target_blk = 0;
     int target_idx = -1;
     uint8_t buf[512];
+    char clean[40];
+    sanitize_name(clean, name, 39);
 
-    // Find free slot
-    while(1) {
-        disk_rw(0, curr, buf);
-        pfs32_direntry_t* entries = (pfs32_direntry_t*)buf;
-        
-        for(int i=0; i<8; i++) {
-            if(entries[i].filename[0] == 0) {
-                target_blk = curr;
-                target_idx = i;
-                break;
-            }
-        }
-        if (target_idx != -1) break;
-
-        uint32_t next = get_fat(curr);
-        if(next == PFS32_END_BLOCK || next == 0) {
-            uint32_t new_blk = alloc_block();
-            if(new_blk == 0) return PFS_ERR_FULL;
-            set_fat(curr, new_blk);
-            set_fat(new_blk, PFS32_END_BLOCK);
-            flush_fat();
-            
-            memset(buf, 0, 512);
-            target_blk = new_blk;
-            target_idx = 0;
-            break; 
-        }
-        curr = next;
-    }
+    res = dir_alloc_slot(pblk, clean, &target_blk, &target_idx, buf);
+    if (res != PFS_OK) return res;
 
     pfs32_direntry_t* entries = (pfs32_direntry_t*)buf;
     memset(&entries[target_idx], 0, sizeof(pfs32_direntry_t));
-    sanitize_name(entries[target_idx].filename, name, 39);
+    strcpy(entries[target_idx].filename, clean);
     entries[target_idx].attributes = is_dir ? PFS32_ATTR_DIRECTORY : 0;
     entries[target_idx].uid = get_current_uid();
     entries[target_idx].gid = get_current_gid();
@@ -465,7 +2326,8 @@ int pfs32_create_node(const char* path, int is_dir) {
     entries[target_idx].create_time = pfs32_time_now();
     entries[target_idx].modify_time = entries[target_idx].create_time;
 
-    uint32_t data_blk = alloc_block();
+    uint32_t got;
+    uint32_t data_blk = alloc_blocks(1, &got, 0);
     if(data_blk == 0) return PFS_ERR_FULL;
     
     entries[target_idx].start_block = data_blk;
@@ -483,21 +2345,451 @@ int pfs32_create_node(const char* path, int is_dir) {
         dent[1].attributes = PFS32_ATTR_DIRECTORY;
         dent[1].start_block = pblk;
 
-        disk_rw(1, data_blk, z);
-    } else {
+        meta_write(data_blk, z);
+    } else if (!jnl_on) {
         entries[target_idx].file_size = 0;
         uint8_t z[512]; memset(z, 0, 512);
-        disk_rw(1, data_blk, z);
+        meta_write(data_blk, z);
     }
+    // An empty file's block is never read. With the journal it must not
+    // be logged either, or a replay would zero the data written to it.
     
     set_fat(data_blk, PFS32_END_BLOCK);
-    disk_rw(1, target_blk, buf);
-    flush_fat();
+    meta_write(target_blk, buf);
+    nix_created(pblk, clean, is_dir ? data_blk : 0);
+    meta_commit();
+    dcache_insert(pblk, name, target_blk, target_idx);
     return PFS_OK;
 }
 
 // --- File I/O ---
 
+// Write `size` bytes along the chain starting at `blk`, extending it
+// with contiguous runs sized to the rest of the data. With `queue` set
+// runs are only queued (the caller unplugs) and `size` must be whole
+// blocks, so no bounce buffer has to outlive the call.
+static int write_chain(uint32_t blk, const uint8_t* data, uint32_t size, int queue) {
+    uint32_t total_blocks = (size + 511) / 512;
+    uint32_t idx = 0;
+
+    while(idx < total_blocks) {
+        // Extend the chain while it stays physically contiguous
+        uint32_t run = 1, cur = blk;
+        while(idx + run < total_blocks && run < PFS32_MAX_RUN) {
+            uint32_t next = get_fat(cur);
+            if(next == PFS32_END_BLOCK || next == 0) {
+                uint32_t got;
+                next = alloc_blocks(total_blocks - idx - run, &got, 0);
+                if(next == 0) return PFS_ERR_FULL;
+                set_fat(cur, next);
+            }
+            if(next != cur + 1) break;
+            cur = next;
+            run++;
+        }
+
+        // Full blocks go straight from the caller's buffer; a partial
+        // tail block is padded through a bounce buffer.
+        uint32_t offset = idx * 512;
+        uint32_t full = run;
+        if (offset + run * 512 > size) full--;
+        if (full > 0) {
+            int res = queue ? disk_queue_run(blk, full, (void*)(data + offset))
+                            : disk_rw_multi(1, blk, full, (void*)(data + offset));
+            if (res != PFS_OK) return PFS_ERR_IO;
+        }
+        if (full < run) {
+            uint8_t buf[512]; memset(buf, 0, 512);
+            memcpy(buf, data + offset + full * 512, size - offset - full * 512);
+            if (disk_rw(1, cur, buf) != PFS_OK) return PFS_ERR_IO;
+        }
+        idx += run;
+
+        if(idx < total_blocks) {
+            uint32_t next = get_fat(cur);
+            if(next == PFS32_END_BLOCK || next == 0) {
+                uint32_t got;
+                next = alloc_blocks(total_blocks - idx, &got, 0);
+                if(next == 0) return PFS_ERR_FULL;
+                set_fat(cur, next);
+            }
+            blk = next;
+        }
+    }
+    return PFS_OK;
+}
+
+static wb_file_t* wb_find(uint32_t entry_blk, int entry_idx) {
+    for (int i = 0; i < WB_MAX_FILES; i++) {
+        if (wb_files[i].active && wb_files[i].entry_blk == entry_blk &&
+            wb_files[i].entry_idx == entry_idx) return &wb_files[i];
+    }
+    return 0;
+}
+
+static void wb_release(wb_file_t* w) {
+    if (w->data) kfree(w->data);
+    wb_bytes -= (w->size + 511) & ~511u;
+    w->data = 0;
+    w->active = 0;
+}
+
+// Discard pending data without writing it (unmount, format)
+static void wb_discard_all(void) {
+    for (int i = 0; i < WB_MAX_FILES; i++) {
+        if (wb_files[i].active) wb_release(&wb_files[i]);
+    }
+    wb_bytes = 0;
+    wb_dirty = 0;
+    memset(lazy_times, 0, sizeof(lazy_times));
+    lazy_count = 0;
+}
+
+// Allocate and write pending file data, lowest first block first, as one
+// elevator batch. Only `only` is written when it is set.
+static int wb_write_files(wb_file_t* only) {
+    int order[WB_MAX_FILES];
+    int n = 0;
+    for (int i = 0; i < WB_MAX_FILES; i++) {
+        if (!wb_files[i].active || (only && &wb_files[i] != only)) continue;
+        int k = n++;
+        while (k > 0 && wb_files[order[k - 1]].start_block > wb_files[i].start_block) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = i;
+    }
+    if (n == 0) return PFS_OK;
+
+    int res = PFS_OK;
+    for (int k = 0; k < n && res == PFS_OK; k++) {
+        wb_file_t* w = &wb_files[order[k]];
+        res = write_data(w->start_block, w->data, (w->size + 511) & ~511u, 1);
+    }
+    if (disk_unplug() != 0) res = PFS_ERR_IO;
+    if (res != PFS_OK) return res; // Still pending; a later pass retries
+
+    for (int k = 0; k < n; k++) wb_release(&wb_files[order[k]]);
+    return PFS_OK;
+}
+
+// Everything held in memory goes to disk: data, then the FAT that points
+// at it, then the directory blocks that point at the chains. With the
+// journal the metadata is committed to the log instead.
+static int wb_writeback_all(void) {
+    if (!mounted) return PFS_OK;
+    int res = wb_write_files(0);
+    flush_fat();
+    lazy_flush();
+    if (jnl_on) {
+        // One transaction for everything since the last flush; timestamps
+        // it had no room for follow in one of their own
+        if (jnl_commit() != PFS_OK) res = PFS_ERR_IO;
+        if (lazy_count) {
+            lazy_flush();
+            if (jnl_commit() != PFS_OK) res = PFS_ERR_IO;
+        }
+    } else if (bcache_writeback() != 0) res = PFS_ERR_IO;
+    if (res == PFS_OK) wb_dirty = 0;
+    return res;
+}
+
+// Background flusher, called by the kernel's cooperative worker
+void pfs32_writeback_pump(void) {
+    if (!mounted || !wb_dirty) return;
+    int expired = (get_tick_count() - wb_dirty_since) >= WB_EXPIRE_TICKS;
+    int pressure = wb_bytes >= WB_MAX_BYTES / 2 || bcache_dirty_count() >= BCACHE_DIRTY_MAX / 2;
+    if (expired || pressure) wb_writeback_all();
+}
+
+// Make room to hold `size` bytes for the entry before an operation
+// changes anything: the writeback commits, and that commit must not
+// carry half of the operation
+static void wb_reserve(uint32_t entry_blk, int entry_idx, uint32_t size) {
+    if (!(mount_opts & PFS32_MOUNT_WRITEBACK) || size > WB_MAX_FILE_BYTES) return;
+    wb_file_t* w = wb_find(entry_blk, entry_idx);
+    uint32_t held = w ? (w->size + 511) & ~511u : 0;
+    int slot = w != 0;
+    for (int i = 0; i < WB_MAX_FILES && !slot; i++) slot = !wb_files[i].active;
+    if (!slot || wb_bytes - held + ((size + 511) & ~511u) > WB_MAX_BYTES) wb_writeback_all();
+}
+
+// Blocks freed since the last commit only come back with the next one
+// (jnl_hold). An operation needing `blocks` that are not free otherwise
+// commits before it changes anything.
+static void jnl_reclaim(uint32_t blocks) {
+    if (!jnl_pend_count || sb.free_blocks >= blocks) return;
+    if (mount_opts & PFS32_MOUNT_WRITEBACK) wb_writeback_all();
+    else jnl_commit();
+}
+
+// FAT sectors the entries of `blocks` blocks in up to `runs` runs may
+// lie in; a run may start and end mid-sector.
+static uint32_t fat_span(uint32_t blocks, uint32_t runs) {
+    uint32_t n = blocks / (PFS32_BLOCK_SIZE / 4) + 2 * runs;
+    if (n > blocks + 1) n = blocks + 1;
+    return (n < sb.fat_blocks) ? n : sb.fat_blocks;
+}
+
+// FAT sectors new storage of `blocks` blocks for a file may take: a
+// cluster or more is in at most PFS32_MAX_EXTENTS runs of a map, less in
+// a few runs of a chain.
+static uint32_t fat_alloc(uint32_t blocks) {
+    return fat_span(blocks, (cluster_blocks && blocks >= cluster_blocks) ? PFS32_MAX_EXTENTS + 1 : 4);
+}
+
+// Count the FAT sector of `blk` in `n` unless it is `*sec`, the last one
+static void fat_count(uint32_t blk, uint32_t* sec, uint32_t* n) {
+    uint32_t s = blk / (PFS32_BLOCK_SIZE / 4);
+    if (*n && s == *sec) return;
+    *sec = s;
+    (*n)++;
+}
+
+// FAT sectors the chain from `start` lies in
+static uint32_t chain_fat(uint32_t start) {
+    uint32_t sec = 0, n = 0;
+    for (uint32_t blk = start, k = 0; blk >= sb.data_start_block && blk < sb.total_blocks &&
+         k < sb.total_blocks; blk = get_fat(blk), k++) {
+        fat_count(blk, &sec, &n);
+    }
+    return n;
+}
+
+// FAT sectors the extents of map `m` lie in
+static uint32_t ext_fat(const pfs32_extent_map_t* m) {
+    uint32_t n = 0;
+    for (int i = 0; i < m->count; i++) {
+        if (!m->ext[i].length) continue;
+        n += (m->ext[i].start + m->ext[i].length - 1) / (PFS32_BLOCK_SIZE / 4) -
+             m->ext[i].start / (PFS32_BLOCK_SIZE / 4) + 1;
+    }
+    return n;
+}
+
+// FAT sectors the blocks of the file or directory of entry `e` lie in
+static uint32_t entry_fat(const pfs32_direntry_t* e) {
+    uint32_t n = 0;
+    if (e->attributes & PFS32_ATTR_DIRECTORY) {
+        dir_iter_t it;
+        uint32_t sec = 0, k = 0;
+        dir_iter_init(&it, e->start_block);
+        for (uint32_t blk = dir_iter_next(&it); blk && k < sb.total_blocks; blk = dir_iter_next(&it), k++) {
+            fat_count(blk, &sec, &n);
+        }
+    } else if (is_extent_file(e->start_block)) {
+        pfs32_extent_map_t m;
+        n = 1 + ((ext_load(e->start_block, &m) == PFS_OK) ? ext_fat(&m) : 0);
+    } else {
+        n = chain_fat(e->start_block);
+    }
+    return (n < sb.fat_blocks) ? n : sb.fat_blocks;
+}
+
+// FAT sectors giving the file of entry `e` `blocks` blocks of storage
+// may change. An extent map of its own only gains or loses clusters at
+// the end; any other layout may be replaced whole.
+static uint32_t fat_change(const pfs32_direntry_t* e, uint32_t blocks) {
+    pfs32_extent_map_t m;
+    if (cluster_blocks && blocks >= cluster_blocks && is_extent_file(e->start_block) &&
+        ext_load(e->start_block, &m) == PFS_OK && !(m.flags & PFS32_EXTENT_SHARED)) {
+        return fat_alloc(m.blocks > blocks ? m.blocks - blocks : blocks - m.blocks);
+    }
+    return entry_fat(e) + fat_alloc(blocks);
+}
+
+// Can the running transaction take `meta` more metadata blocks and `fat`
+// more FAT sectors? Both count against the journal, with a descriptor
+// and commit block per PFS32_JOURNAL_TXN_MAX images; metadata, and the
+// FAT unless it is resident, against the block cache's dirty limit. The
+// dirty FAT, the chains of held files and the superblock image a last
+// part may need join at the commit.
+static int jnl_room(uint32_t meta, uint32_t fat) {
+    if (!jnl_on) return 1;
+    fat += fat_dirty_count();
+    for (int i = 0; i < WB_MAX_FILES; i++) {
+        if (wb_files[i].active) fat += fat_alloc((wb_files[i].size + 511) / 512);
+    }
+    uint32_t images = jnl_txn_count + meta + fat + 1;
+    uint32_t parts = (images + PFS32_JOURNAL_TXN_MAX - 1) / PFS32_JOURNAL_TXN_MAX;
+    if (jnl_head + images + 2 * parts > sb.journal_blocks) return 0;
+    return bcache_dirty_count() + meta + 1 + (fat_resident ? 0 : fat) <= BCACHE_DIRTY_MAX;
+}
+
+// Make room in the running transaction for an operation changing up to
+// `meta` metadata blocks and `fat` FAT sectors, before it changes
+// anything: once it has started nothing may commit or checkpoint (see
+// jnl_write). PFS_ERR_FULL, with nothing changed, if even an empty
+// journal could not take the operation.
+static int jnl_reserve(uint32_t meta, uint32_t fat) {
+    if (jnl_room(meta, fat)) return PFS_OK;
+    if (mount_opts & PFS32_MOUNT_WRITEBACK) wb_writeback_all();
+    else jnl_commit();
+    if (!jnl_room(meta, fat) && jnl_write_home() != PFS_OK) return PFS_ERR_IO;
+    return jnl_room(meta, fat) ? PFS_OK : PFS_ERR_FULL;
+}
+
+// Hold a copy of a small file's new contents. Returns PFS_ERR_FULL when
+// it should be written through instead.
+static int wb_hold(uint32_t entry_blk, int entry_idx, uint32_t start_block, const uint8_t* data, uint32_t size) {
+    if (size > WB_MAX_FILE_BYTES) return PFS_ERR_FULL;
+    uint32_t padded = (size + 511) & ~511u;
+
+    wb_file_t* w = wb_find(entry_blk, entry_idx);
+    if (w) wb_release(w);
+    if (wb_bytes + padded > WB_MAX_BYTES) wb_writeback_all();
+    if (!w) {
+        for (int i = 0; i < WB_MAX_FILES; i++) {
+            if (!wb_files[i].active) { w = &wb_files[i]; break; }
+        }
+        if (!w) {
+            wb_writeback_all();
+            w = &wb_files[0];
+            if (w->active) return PFS_ERR_FULL;
+        }
+    }
+
+    uint8_t* copy = (uint8_t*)kmalloc(padded ? padded : 1);
+    if (!copy) return PFS_ERR_FULL;
+    memcpy(copy, data, size);
+    memset(copy + size, 0, padded - size);
+
+    w->active = 1;
+    w->entry_blk = entry_blk;
+    w->entry_idx = entry_idx;
+    w->start_block = start_block;
+    w->data = copy;
+    w->size = size;
+    wb_bytes += padded;
+    wb_touch();
+    return PFS_OK;
+}
+
+// --- Compressed Files (PFS32_ATTR_COMPRESSED) ---
+static uint8_t lz_in[PFS32_LZ4_CHUNK];  // A stored chunk on its way to the decoder
+static uint8_t lz_out[PFS32_LZ4_CHUNK]; // Decoded chunk only partly wanted
+
+static uint32_t lz_chunks(uint32_t size) {
+    return (size + PFS32_LZ4_CHUNK - 1) / PFS32_LZ4_CHUNK;
+}
+
+// Plain length of chunk `i` of a `size` byte file
+static uint32_t lz_chunk_len(uint32_t size, uint32_t i) {
+    uint32_t left = size - i * PFS32_LZ4_CHUNK;
+    return left < PFS32_LZ4_CHUNK ? left : PFS32_LZ4_CHUNK;
+}
+
+// Does the stream header (and the index, when given) fit a file of
+// `size` plain bytes? Chunks must follow each other and never grow.
+static int lz_check(const pfs32_lz4_header_t* hdr, const uint32_t* index, uint32_t size) {
+    uint32_t count = lz_chunks(size);
+    uint32_t pos = sizeof(pfs32_lz4_header_t) + (count + 1) * 4;
+    if (hdr->magic != PFS32_LZ4_MAGIC || hdr->chunk_size != PFS32_LZ4_CHUNK ||
+        hdr->chunk_count != count || hdr->stored_size < pos) return 0;
+    if (!index) return 1;
+    for (uint32_t i = 0; i < count; i++) {
+        if (index[i] != pos || index[i + 1] <= pos || index[i + 1] - pos > lz_chunk_len(size, i)) return 0;
+        pos = index[i + 1];
+    }
+    return pos == hdr->stored_size;
+}
+
+// Build the stream for `size` plain bytes; 0 when out of memory
+static uint8_t* lz_encode(const uint8_t* data, uint32_t size, uint32_t* out_size) {
+    uint32_t count = lz_chunks(size);
+    uint32_t pos = sizeof(pfs32_lz4_header_t) + (count + 1) * 4;
+    uint8_t* s = (uint8_t*)kmalloc(pos + size);
+    if (!s) return 0;
+
+    pfs32_lz4_header_t* hdr = (pfs32_lz4_header_t*)s;
+    uint32_t* index = (uint32_t*)(hdr + 1);
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* src = data + i * PFS32_LZ4_CHUNK;
+        uint32_t n = lz_chunk_len(size, i);
+        uint32_t c = lz4_compress(src, n, s + pos, n - 1);
+        if (c == 0) {
+            memcpy(s + pos, src, n);
+            c = n;
+        }
+        index[i] = pos;
+        pos += c;
+    }
+    index[count] = pos;
+    hdr->magic = PFS32_LZ4_MAGIC;
+    hdr->chunk_size = PFS32_LZ4_CHUNK;
+    hdr->chunk_count = count;
+    hdr->stored_size = pos;
+
+    stats.lz4_raw_written += size;
+    stats.lz4_stored_written += pos;
+    *out_size = pos;
+    return s;
+}
+
+// Decode one stored chunk of `clen` bytes into its `n` plain bytes
+static int lz_decode(const uint8_t* src, uint32_t clen, uint8_t* dst, uint32_t n) {
+    uint32_t t0 = get_tick_count();
+    if (clen == n) memcpy(dst, src, n);
+    else if (clen > n || lz4_decompress(src, clen, dst, n) != (int)n) return PFS_ERR_IO;
+    stats.lz4_decode_ticks += get_tick_count() - t0;
+    stats.lz4_chunks_read++;
+    stats.lz4_bytes_in += clen;
+    stats.lz4_bytes_out += n;
+    return PFS_OK;
+}
+
+// Write a file's whole contents given its directory entry. The entry's
+// attributes are stored with it, so they decide whether the data is
+// compressed. Returns `size` or PFS_ERR_*.
+static int write_entry(uint32_t entry_blk, int entry_idx, const pfs32_direntry_t* entry, const uint8_t* data, uint32_t size) {
+    uint8_t* stream = 0;
+    uint32_t stored = size;
+    if (entry->attributes & PFS32_ATTR_COMPRESSED) {
+        stream = lz_encode(data, size, &stored);
+        if (!stream) return PFS_ERR_FULL;
+        data = stream;
+    }
+
+    // Extents are allocated now; chains keep delayed allocation
+    wb_reserve(entry_blk, entry_idx, stored);
+    jnl_reclaim((stored + 511) / 512 + cluster_blocks + 1);
+    int res = jnl_reserve(JNL_OP_META, fat_change(entry, (stored + 511) / 512));
+    if (res != PFS_OK) {
+        if (stream) kfree(stream);
+        return res;
+    }
+    uint32_t start = entry->start_block;
+    res = file_prepare(&start, stored);
+
+    // Delayed allocation: small files wait in RAM for the flusher
+    if (res == PFS_OK && (!(mount_opts & PFS32_MOUNT_WRITEBACK) ||
+        wb_hold(entry_blk, entry_idx, start, data, stored) != PFS_OK)) {
+        wb_file_t* w = wb_find(entry_blk, entry_idx);
+        if (w) wb_release(w);
+        res = write_data(start, data, stored, 0);
+    }
+    if (stream) kfree(stream);
+    if (res != PFS_OK) return res;
+
+    if ((entry->attributes & PFS32_ATTR_COMPRESSED) && !(sb.features & PFS32_FEAT_COMPRESS)) {
+        sb.features |= PFS32_FEAT_COMPRESS;
+        meta_write(0, &sb);
+    }
+
+    // Update size, layout and time
+    uint8_t dbuf[512];
+    disk_rw(0, entry_blk, dbuf);
+    pfs32_direntry_t* de = (pfs32_direntry_t*)dbuf;
+    de[entry_idx].file_size = size;
+    de[entry_idx].start_block = start;
+    de[entry_idx].attributes = entry->attributes;
+    de[entry_idx].modify_time = pfs32_time_now(); 
+    meta_write(entry_blk, dbuf);
+
+    meta_commit();
+    return size;
+}
+
 int pfs32_write_file(const char* path, uint8_t* data, uint32_t size) {
     if(!mounted) return PFS_ERR_NO_FS;
 
@@ -514,39 +2806,97 @@ int pfs32_write_file(const char* path, uint8_t* data, uint32_t size) {
 
     if (!check_permission(entry.uid, entry.gid, entry.permissions, PFS_PERM_WRITE)) return PFS_ERR_ACCESS;
 
-    uint32_t blk = entry.start_block;
-    uint32_t written = 0;
+    res = write_entry(entry_blk, entry_idx, &entry, data, size);
+    // Open handles would decode the new stream through the old index
+    if (res >= 0 && (entry.attributes & PFS32_ATTR_COMPRESSED)) handles_reload(entry_blk, entry_idx);
+    return res;
+}
 
-    while(written < size) {
-        uint8_t buf[512]; memset(buf, 0, 512);
-        uint32_t chunk = (size - written < 512) ? size - written : 512;
-        memcpy(buf, data + written, chunk);
-        
-        disk_rw(1, blk, buf);
-        written += chunk;
+// Read `total` bytes of the file starting at `blk` from disk
+static uint32_t read_blocks(uint32_t blk, uint8_t* buffer, uint32_t total) {
+    uint32_t read = 0;
+    pfs32_extent_map_t m;
+    pfs32_extent_map_t* map = 0;
+    if (is_extent_file(blk)) {
+        if (ext_load(blk, &m) != PFS_OK) return 0;
+        map = &m;
+        blk = ext_first(map);
+    }
 
-        if(written < size) {
-            uint32_t next = get_fat(blk);
-            if(next == PFS32_END_BLOCK || next == 0) {
-                next = alloc_block();
-                if(next == 0) return PFS_ERR_FULL;
-                set_fat(blk, next);
-                set_fat(next, PFS32_END_BLOCK);
-            }
-            blk = next;
+    while(read < total && blk != PFS32_END_BLOCK && blk != 0) {
+        // Whole blocks of a contiguous run land directly in the caller's
+        // buffer with one transfer; only a partial tail is bounced.
+        uint32_t full = (total - read) / 512;
+        if (full > 0) {
+            uint32_t last;
+            uint32_t run = file_run(map, blk, full < PFS32_MAX_RUN ? full : PFS32_MAX_RUN, &last);
+            if(disk_rw_multi(0, blk, run, buffer + read) != PFS_OK) break;
+            read += run * 512;
+            blk = file_next(map, last);
+            continue;
         }
+        uint8_t buf[512];
+        if(disk_rw(0, blk, buf) != PFS_OK) break;
+        uint32_t chunk = total - read;
+        memcpy(buffer + read, buf, chunk);
+        read += chunk;
+        blk = file_next(map, blk);
     }
-    
-    // Update size and time
-    uint8_t dbuf[512];
-    disk_rw(0, entry_blk, dbuf);
-    pfs32_direntry_t* de = (pfs32_direntry_t*)dbuf;
-    de[entry_idx].file_size = size;
-    de[entry_idx].modify_time = pfs32_time_now(); 
-    disk_rw(1, entry_blk, dbuf);
+    return read;
+}
 
-    flush_fat();
-    return size;
+// Bytes a compressed file occupies on disk, from its stream header
+static int lz_stored_size(const pfs32_direntry_t* e, uint32_t* stored) {
+    pfs32_lz4_header_t hdr;
+    if (read_blocks(e->start_block, (uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr)) return PFS_ERR_IO;
+    if (!lz_check(&hdr, 0, e->file_size)) return PFS_ERR_IO;
+    *stored = hdr.stored_size;
+    return PFS_OK;
+}
+
+// Decode the first `total` plain bytes of a compressed file; its stream
+// is read whole, unless it is still held by write-back
+static int lz_read_file(const pfs32_direntry_t* e, wb_file_t* w, uint8_t* buffer, uint32_t total) {
+    uint8_t* s = w ? w->data : 0;
+    if (!s) {
+        uint32_t stored;
+        if (lz_stored_size(e, &stored) != PFS_OK) return PFS_ERR_IO;
+        s = (uint8_t*)kmalloc(stored);
+        if (!s) return PFS_ERR_FULL;
+        if (read_blocks(e->start_block, s, stored) != stored) {
+            kfree(s);
+            return PFS_ERR_IO;
+        }
+    }
+
+    pfs32_lz4_header_t* hdr = (pfs32_lz4_header_t*)s;
+    uint32_t* index = (uint32_t*)(hdr + 1);
+    int res = lz_check(hdr, index, e->file_size) ? (int)total : PFS_ERR_IO;
+    for (uint32_t i = 0, done = 0; res >= 0 && done < total; i++) {
+        uint32_t n = lz_chunk_len(e->file_size, i);
+        uint32_t want = (total - done < n) ? total - done : n;
+        uint8_t* dst = (want == n) ? buffer + done : lz_out;
+        if (lz_decode(s + index[i], index[i + 1] - index[i], dst, n) != PFS_OK) res = PFS_ERR_IO;
+        else if (dst == lz_out) memcpy(buffer + done, lz_out, want);
+        done += want;
+    }
+    if (!w) kfree(s);
+    return res;
+}
+
+// Read up to `max` bytes of the file whose entry is at (entry_blk, entry_idx)
+static int read_entry(uint32_t entry_blk, int entry_idx, const pfs32_direntry_t* entry, uint8_t* buffer, uint32_t max) {
+    uint32_t total = (entry->file_size > max) ? max : entry->file_size;
+
+    // Not written back yet: the data only exists in RAM
+    wb_file_t* w = wb_find(entry_blk, entry_idx);
+    if (entry->attributes & PFS32_ATTR_COMPRESSED) return lz_read_file(entry, w, buffer, total);
+    if (w) {
+        if (total > w->size) total = w->size;
+        memcpy(buffer, w->data, total);
+        return total;
+    }
+    return read_blocks(entry->start_block, buffer, total);
 }
 
 int pfs32_read_file(const char* path, uint8_t* buffer, uint32_t max) {
@@ -561,28 +2911,126 @@ int pfs32_read_file(const char* path, uint8_t* buffer, uint32_t max) {
     if (!check_permission(entry.uid, entry.gid, entry.permissions, PFS_PERM_READ)) return PFS_ERR_ACCESS;
     if(entry.attributes & PFS32_ATTR_DIRECTORY) return PFS_ERR_PARAM;
 
-    // Update Access Time
-    uint8_t dbuf[512];
-    disk_rw(0, entry_blk, dbuf);
-    ((pfs32_direntry_t*)dbuf)[entry_idx].access_time = pfs32_time_now();
-    disk_rw(1, entry_blk, dbuf);
+    touch_atime(&entry, entry_blk, entry_idx);
+    return read_entry(entry_blk, entry_idx, &entry, buffer, max);
+}
 
-    uint32_t blk = entry.start_block;
-    uint32_t read = 0;
-    uint32_t total = (entry.file_size > max) ? max : entry.file_size;
+// Rewrite a file at `new_size` (zero-extended) with `attributes`; how
+// compressed files are resized and switched between the two formats
+static int lz_rewrite(uint32_t entry_blk, int entry_idx, const pfs32_direntry_t* e, uint32_t new_size, uint8_t attributes) {
+    uint8_t* plain = (uint8_t*)kzalloc(new_size ? new_size : 1);
+    if (!plain) return PFS_ERR_FULL;
+    uint32_t keep = (new_size < e->file_size) ? new_size : e->file_size;
+    int res = read_entry(entry_blk, entry_idx, e, plain, keep);
+    if (res == (int)keep) {
+        pfs32_direntry_t entry = *e;
+        entry.attributes = attributes;
+        res = write_entry(entry_blk, entry_idx, &entry, plain, new_size);
+    } else if (res >= 0) res = PFS_ERR_IO;
+    kfree(plain);
+    if (res < 0) return res;
+    return handles_reload(entry_blk, entry_idx);
+}
+
+int pfs32_set_compressed(const char* path, int on) {
+    if(!mounted) return PFS_ERR_NO_FS;
+
+    uint32_t pblk;
+    if(get_dir_block(get_parent_path(path), &pblk) != PFS_OK) return PFS_ERR_NOT_FOUND;
+
+    pfs32_direntry_t entry;
+    uint32_t entry_blk; int entry_idx;
+    if(find_entry_in_dir(pblk, get_basename(path), &entry, &entry_blk, &entry_idx) != PFS_OK) return PFS_ERR_NOT_FOUND;
+    if(entry.attributes & PFS32_ATTR_DIRECTORY) return PFS_ERR_PARAM;
+    if(!check_permission(entry.uid, entry.gid, entry.permissions, PFS_PERM_WRITE)) return PFS_ERR_ACCESS;
+
+    uint8_t attributes = on ? (entry.attributes | PFS32_ATTR_COMPRESSED) : (entry.attributes & ~PFS32_ATTR_COMPRESSED);
+    if (attributes == entry.attributes) return PFS_OK;
+    return lz_rewrite(entry_blk, entry_idx, &entry, entry.file_size, attributes);
+}
+
+// --- FEAT-001: Truncate ---
+// Resize the file whose directory entry is at (entry_blk, entry_idx).
+// Space is allocated in runs without zeroing; on growth bytes from the
+// old end of file up to `zero_to` are zeroed afterwards, and the caller
+// fills the rest (pfs32_pwrite writes its data there directly). A chain that grows
+// to a cluster on a v3 volume moves to extents, changing its start block.
+static int resize_entry(uint32_t entry_blk, int entry_idx, const pfs32_direntry_t* e, uint32_t new_size, uint32_t zero_to) {
+    pfs32_direntry_t entry = *e;
+    if (new_size == entry.file_size) return PFS_OK;
+    int room = jnl_reserve(JNL_OP_META, fat_change(&entry, (new_size + 511) / 512));
+    if (room != PFS_OK) return room;
+
+    // The chain must exist before it can be cut or extended
+    wb_file_t* w = wb_find(entry_blk, entry_idx);
+    if (w && wb_write_files(w) != PFS_OK) return PFS_ERR_IO;
+
+    uint32_t start = entry.start_block;
+    uint32_t used = (entry.file_size + 511) / 512;
+    if (new_size > entry.file_size) jnl_reclaim((new_size + 511) / 512 - used + cluster_blocks + 1);
+    pfs32_extent_map_t m;
+    int ext = is_extent_file(start);
+
+    if (!ext && cluster_blocks && new_size > entry.file_size && new_size >= cluster_blocks * PFS32_BLOCK_SIZE) {
+        uint32_t map = alloc_block();
+        if (map) {
+            set_fat(map, PFS32_EXTENT_MAP);
+            ext_init(&m);
+            int res = ext_resize(&m, ext_blocks_for(new_size), 0);
+            if (res == PFS_OK) res = copy_blocks(0, start, &m, ext_first(&m), used);
+            if (res == PFS_OK) res = meta_write(map, &m);
+            if (res == PFS_OK) {
+                free_chain(start);
+                start = map;
+                ext = 1;
+            } else {
+                // Too fragmented for the map: the chain simply grows
+                ext_resize(&m, 0, 0);
+                set_fat(map, PFS32_FREE_BLOCK);
+            }
+        }
+    }
+
+    if (ext && start == entry.start_block) {
+        // Whole clusters come and go
+        if (ext_load(start, &m) != PFS_OK) return PFS_ERR_IO;
+        int res = ext_resize(&m, ext_blocks_for(new_size), 0);
+        if (meta_write(start, &m) != PFS_OK) return PFS_ERR_IO;
+        if (res != PFS_OK) { meta_commit(); return res; }
+    } else if (!ext) {
+        uint32_t blocks = (new_size + 511) / 512;
+        int res = chain_fit(start, blocks ? blocks : 1);
+        if (res != PFS_OK) { meta_commit(); return res; }
+    }
+    // Nothing past the end of file is kept: a shrink clears the rest of
+    // the last block (cluster, for extents), so growing again reads zeros
+    uint32_t from = entry.file_size, to = (zero_to < new_size) ? zero_to : new_size;
+    if (new_size < entry.file_size) {
+        uint32_t keep = ext ? ext_blocks_for(new_size) : (new_size + 511) / 512;
+        if (!ext && keep == 0) keep = 1;
+        from = new_size;
+        to = (keep * 512 < entry.file_size) ? keep * 512 : entry.file_size;
+    }
+    if (zero_range(ext ? &m : 0, ext ? ext_first(&m) : start, from, to) != PFS_OK) return PFS_ERR_IO;
+
+    // Update Directory Entry
+    uint8_t buf[512];
+    disk_rw(0, entry_blk, buf);
+    pfs32_direntry_t* de = (pfs32_direntry_t*)buf;
+    de[entry_idx].file_size = new_size;
+    de[entry_idx].start_block = start;
+    de[entry_idx].modify_time = pfs32_time_now();
+    meta_write(entry_blk, buf);
+    meta_commit();
+
+    if (start != entry.start_block) return handles_reload(entry_blk, entry_idx);
+    return PFS_OK;
+}
 
-    while(read < total && blk != PFS32_END_BLOCK && blk != 0) {
-        uint8_t buf[512];
-        if(disk_rw(0, blk, buf) != PFS_OK) break;
-        uint32_t chunk = (total - read < 512) ? total - read : 512;
-        memcpy(buffer + read, buf, chunk);
-        read += chunk;
-        blk = get_fat(blk);
-    }
-    return read;
+static int truncate_entry(uint32_t entry_blk, int entry_idx, const pfs32_direntry_t* e, uint32_t new_size) {
+    return resize_entry(entry_blk, entry_idx, e, new_size, new_size);
 }
 
-// --- FEAT-001: Truncate ---
 int pfs32_truncate(const char* path, uint32_t new_size) {
     if(!mounted) return PFS_ERR_NO_FS;
     
@@ -594,133 +3042,192 @@ int pfs32_truncate(const char* path, uint32_t new_size) {
     if(find_entry_in_dir(pblk, get_basename(path), &entry, &entry_blk, &entry_idx) != PFS_OK) return PFS_ERR_NOT_FOUND;
     if(!check_permission(entry.uid, entry.gid, entry.permissions, PFS_PERM_WRITE)) return PFS_ERR_ACCESS;
 
-    if (new_size == entry.file_size) return PFS_OK;
+    if (entry.attributes & PFS32_ATTR_COMPRESSED) return lz_rewrite(entry_blk, entry_idx, &entry, new_size, entry.attributes);
+    return truncate_entry(entry_blk, entry_idx, &entry, new_size);
+}
 
-    uint32_t current_blk = entry.start_block;
-    uint32_t bytes_covered = 0;
+// --- FEAT-002: Copy & Reflink ---
 
-    if (new_size < entry.file_size) {
-        // Shrink
-        while(current_blk != PFS32_END_BLOCK && bytes_covered + 512 <= new_size) {
-            bytes_covered += 512;
-            current_blk = get_fat(current_blk);
+// Bounce buffer for block copies; shrinks when the heap is tight.
+// *cap receives its size in blocks.
+static uint8_t* copy_buf(uint32_t* cap) {
+    for (uint32_t n = COPY_BUF_BLOCKS; n > 0; n /= 2) {
+        uint8_t* buf = (uint8_t*)kmalloc(n * 512);
+        if (buf) { *cap = n; return buf; }
+    }
+    return 0;
+}
+
+// Copy `blocks` file blocks between two layouts (`sm`/`dm` as for
+// file_run). Each buffer-load is gathered with multi-sector reads of the
+// source runs and written through the elevator along the destination's.
+static int copy_blocks(const pfs32_extent_map_t* sm, uint32_t sblk,
+                       const pfs32_extent_map_t* dm, uint32_t dblk, uint32_t blocks) {
+    uint32_t cap;
+    uint8_t* buf = copy_buf(&cap);
+    if (!buf) return PFS_ERR_FULL;
+
+    int res = PFS_OK;
+    while (blocks > 0 && res == PFS_OK) {
+        uint32_t n = blocks < cap ? blocks : cap;
+        uint32_t last;
+        for (uint32_t got = 0; got < n; ) {
+            if (sblk < sb.data_start_block || sblk >= sb.total_blocks) { res = PFS_ERR_IO; break; }
+            uint32_t run = file_run(sm, sblk, n - got, &last);
+            if (disk_rw_multi(0, sblk, run, buf + got * 512) != PFS_OK) { res = PFS_ERR_IO; break; }
+            got += run;
+            sblk = file_next(sm, last);
         }
-        
-        // current_blk is the last valid block.
-        // If we are mid-block, we keep it but zero out the end? (Optional security)
-        // Free the rest of the chain
-        uint32_t next = get_fat(current_blk);
-        set_fat(current_blk, PFS32_END_BLOCK);
-        
-        while(next != PFS32_END_BLOCK && next != 0) {
-            uint32_t temp = get_fat(next);
-            set_fat(next, PFS32_FREE_BLOCK);
-            next = temp;
+        for (uint32_t put = 0; put < n && res == PFS_OK; ) {
+            if (dblk < sb.data_start_block || dblk >= sb.total_blocks) { res = PFS_ERR_IO; break; }
+            uint32_t run = file_run(dm, dblk, n - put, &last);
+            if (disk_queue_run(dblk, run, buf + put * 512) != PFS_OK) { res = PFS_ERR_IO; break; }
+            put += run;
+            dblk = file_next(dm, last);
         }
-    } else {
-        // Expand
-        // Walk to end
-        while(get_fat(current_blk) != PFS32_END_BLOCK) {
-            current_blk = get_fat(current_blk);
-            bytes_covered += 512;
+        // The buffer is refilled next round, so the queue drains here
+        if (disk_unplug() != 0) res = PFS_ERR_IO;
+        blocks -= n;
+    }
+    kfree(buf);
+    return res;
+}
+
+// Make the chain at `start` exactly `blocks` long (at least one),
+// extending it in contiguous runs or freeing the surplus
+static int chain_fit(uint32_t start, uint32_t blocks) {
+    uint32_t cur = start;
+    for (uint32_t i = 1; i < blocks; i++) {
+        uint32_t next = get_fat(cur);
+        if (next == PFS32_END_BLOCK || next == PFS32_FREE_BLOCK) {
+            uint32_t got;
+            next = alloc_blocks(blocks - i, &got, 0);
+            if (!next) return PFS_ERR_FULL;
+            set_fat(cur, next);
         }
-        // Allocate new blocks
-        while (bytes_covered < new_size) {
-            uint32_t new_b = alloc_block();
-            if(!new_b) return PFS_ERR_FULL;
-            set_fat(current_blk, new_b);
-            set_fat(new_b, PFS32_END_BLOCK);
-            current_blk = new_b;
-            bytes_covered += 512;
+        cur = next;
+    }
+    uint32_t rest = get_fat(cur);
+    set_fat(cur, PFS32_END_BLOCK);
+    if (rest != PFS32_END_BLOCK && rest != PFS32_FREE_BLOCK) free_chain(rest);
+    return PFS_OK;
+}
+
+// Give the destination a map of its own over the source's extents. Fails
+// with PFS_ERR_FULL if a block already has the most owners it can count.
+static int reflink_extents(uint32_t src_map, uint32_t* dst_start) {
+    pfs32_extent_map_t m;
+    if (ext_load(src_map, &m) != PFS_OK) return PFS_ERR_IO;
+    for (int i = 0; i < m.count; i++) {
+        for (uint32_t k = 0; k < m.ext[i].length; k++) {
+            if (ext_refs(m.ext[i].start + k) >= PFS32_REF_MAX) return PFS_ERR_FULL;
         }
     }
 
-    // Update Directory Entry
-    uint8_t buf[512];
-    disk_rw(0, entry_blk, buf);
-    pfs32_direntry_t* de = (pfs32_direntry_t*)buf;
-    de[entry_idx].file_size = new_size;
-    de[entry_idx].modify_time = pfs32_time_now();
-    disk_rw(1, entry_blk, buf);
-    flush_fat();
+    uint32_t map = alloc_block();
+    if (!map) return PFS_ERR_FULL;
+    set_fat(map, PFS32_EXTENT_MAP);
+    for (int i = 0; i < m.count; i++) {
+        for (uint32_t k = 0; k < m.ext[i].length; k++) {
+            uint32_t blk = m.ext[i].start + k;
+            set_fat(blk, PFS32_REF_BASE + ext_refs(blk) + 1);
+        }
+    }
+    m.flags |= PFS32_EXTENT_SHARED;
+    if (meta_write(src_map, &m) != PFS_OK || meta_write(map, &m) != PFS_OK) return PFS_ERR_IO;
 
+    if (!(sb.features & PFS32_FEAT_REFLINK)) {
+        sb.features |= PFS32_FEAT_REFLINK;
+        meta_write(0, &sb);
+    }
+    free_file(*dst_start);
+    *dst_start = map;
+    stats.reflinks++;
     return PFS_OK;
 }
 
-// --- FEAT-002: Copy ---
-int pfs32_copy(const char* src, const char* dst) {
-    pfs32_direntry_t s_ent;
-    // Check if source exists
-    if(pfs32_stat(src, &s_ent) != PFS_OK) return PFS_ERR_NOT_FOUND;
-
-    // Check directory
-    if(s_ent.attributes & PFS32_ATTR_DIRECTORY) return PFS_ERR_PARAM;
-
-    // Create destination
-    int res = pfs32_create_file(dst);
-    if(res != PFS_OK && res != PFS_ERR_EXISTS) return res;
+// Copy a file in bulk: the destination's layout is allocated up front
+// and the data moves in multi-block transfers, never through the file
+// paths. With `reflink` an extent-mapped source is shared instead.
+static int copy_file(const char* src, const char* dst, int reflink) {
+    if(!mounted) return PFS_ERR_NO_FS;
 
-    // Allocation for buffer
-    uint32_t buf_size = 4096; // 4KB chunks
-    uint8_t* buf = (uint8_t*)kmalloc(buf_size);
-    if (!buf) return PFS_ERR_IO;
+    uint32_t pblk;
+    pfs32_direntry_t s_ent, d_ent;
+    uint32_t s_blk, d_blk;
+    int s_idx, d_idx;
+    if (get_dir_block(get_parent_path(src), &pblk) != PFS_OK) return PFS_ERR_NOT_FOUND;
+    if (find_entry_in_dir(pblk, get_basename(src), &s_ent, &s_blk, &s_idx) != PFS_OK) return PFS_ERR_NOT_FOUND;
+    if (s_ent.attributes & PFS32_ATTR_DIRECTORY) return PFS_ERR_PARAM;
+    if (!check_permission(s_ent.uid, s_ent.gid, s_ent.permissions, PFS_PERM_READ)) return PFS_ERR_ACCESS;
+
+    // The source's data has to be on disk to be copied or shared
+    wb_file_t* w = wb_find(s_blk, s_idx);
+    if (w && wb_write_files(w) != PFS_OK) return PFS_ERR_IO;
+
+    int res = pfs32_create_node(dst, 0);
+    if (res != PFS_OK && res != PFS_ERR_EXISTS) return res;
+    if (get_dir_block(get_parent_path(dst), &pblk) != PFS_OK) return PFS_ERR_NOT_FOUND;
+    if (find_entry_in_dir(pblk, get_basename(dst), &d_ent, &d_blk, &d_idx) != PFS_OK) return PFS_ERR_NOT_FOUND;
+    if (d_ent.attributes & PFS32_ATTR_DIRECTORY) return PFS_ERR_PARAM;
+    if (!check_permission(d_ent.uid, d_ent.gid, d_ent.permissions, PFS_PERM_WRITE)) return PFS_ERR_ACCESS;
+    if (d_blk == s_blk && d_idx == s_idx) return PFS_OK;
 
-    uint32_t copied = 0;
+    // A compressed file is copied as its stream and stays compressed
     uint32_t size = s_ent.file_size;
-    
-    // Open handles for robust copy
-    int h_src = pfs32_open(src, 0); // Read
-    if (h_src < 0) { kfree(buf); return PFS_ERR_IO; }
-    
-    int h_dst = pfs32_open(dst, 1); // Write
-    if (h_dst < 0) { pfs32_close(h_src); kfree(buf); return PFS_ERR_IO; }
-
-    while(copied < size) {
-        uint32_t chunk = (size - copied < buf_size) ? size - copied : buf_size;
-
-        // Seek to where we are
-        pfs32_seek(h_src, copied);
-        pfs32_seek(h_dst, copied);
-
-        int bytes_read = pfs32_read_handle(h_src, buf, chunk);
-        if (bytes_read > 0) {
-            // Write to destination
-            // Note: We need a pfs32_write_handle. If missing, we fallback to stateless write
-            // But stateless write appends or overwrites? The provided pfs32_write_file
-            // overwrites from block 0.
-            
-            // To fix this properly without write_handle, we must use `pfs32_write_file`
-            // but we have to read the WHOLE file into memory if we can't seek write.
-            // Assuming we added pfs32_write_handle logic similar to read_handle:
-            
-            // Fallback: Since pfs32_write_file writes *size* bytes, it truncates?
-            // The provided `pfs32_write_file` implementation assumes writing the *whole* buffer.
-            
-            // Implementation for small systems: Read whole, Write whole.
-            // For larger files, we need the Handle Write API.
+    uint32_t stored = size;
+    uint8_t compressed = s_ent.attributes & PFS32_ATTR_COMPRESSED;
+    if (compressed && lz_stored_size(&s_ent, &stored) != PFS_OK) return PFS_ERR_IO;
+    uint32_t blocks = (stored + PFS32_BLOCK_SIZE - 1) / PFS32_BLOCK_SIZE;
+    res = jnl_reserve(JNL_OP_META, fat_change(&d_ent, blocks) + (reflink ? entry_fat(&s_ent) : 0));
+    if (res != PFS_OK) return res;
+
+    // Whatever the destination held is replaced
+    w = wb_find(d_blk, d_idx);
+    if (w) wb_release(w);
+
+    uint32_t start = d_ent.start_block;
+    res = PFS_ERR_FULL;
+    if (reflink && is_extent_file(s_ent.start_block)) res = reflink_extents(s_ent.start_block, &start);
+    if (res != PFS_OK) {
+        res = file_prepare(&start, stored);
+        if (res == PFS_OK && !is_extent_file(start)) res = chain_fit(start, blocks);
+        if (res != PFS_OK) { meta_commit(); return res; }
+
+        pfs32_extent_map_t sm, dm;
+        int s_ext = is_extent_file(s_ent.start_block), d_ext = is_extent_file(start);
+        if ((s_ext && ext_load(s_ent.start_block, &sm) != PFS_OK) ||
+            (d_ext && ext_load(start, &dm) != PFS_OK)) {
+            meta_commit();
+            return PFS_ERR_IO;
         }
-
-        // Since the current API is limited, we break the loop if we can't do chunked writes easily
-        // without adding `pfs32_write_handle`.
-        // Let's implement the "Read Whole / Write Whole" fallback for now to make it work.
-        break;
-    }
-    
-    // Fallback implementation: Load entire file to RAM and write back
-    // Warning: Fails for files > Available RAM
-    if (size > 0) {
-        uint8_t* big_buf = (uint8_t*)kmalloc(size);
-        if (big_buf) {
-            pfs32_read_file(src, big_buf, size);
-            pfs32_write_file(dst, big_buf, size);
-            kfree(big_buf);
+        if (blocks) {
+            res = copy_blocks(s_ext ? &sm : 0, s_ext ? ext_first(&sm) : s_ent.start_block,
+                              d_ext ? &dm : 0, d_ext ? ext_first(&dm) : start, blocks);
         }
     }
 
-    pfs32_close(h_src);
-    pfs32_close(h_dst);
-    kfree(buf);
-    return PFS_OK;
+    // The entry follows the new layout even if the data fell short, so
+    // no block is left unowned
+    uint8_t dbuf[512];
+    if (meta_read(d_blk, dbuf) != PFS_OK) { meta_commit(); return PFS_ERR_IO; }
+    pfs32_direntry_t* de = (pfs32_direntry_t*)dbuf;
+    de[d_idx].file_size = (res == PFS_OK) ? size : 0;
+    de[d_idx].start_block = start;
+    de[d_idx].attributes &= ~PFS32_ATTR_COMPRESSED;
+    if (res == PFS_OK) de[d_idx].attributes |= compressed;
+    de[d_idx].modify_time = pfs32_time_now();
+    meta_write(d_blk, dbuf);
+    meta_commit();
+    return res;
+}
+
+int pfs32_copy(const char* src, const char* dst) {
+    return copy_file(src, dst, 0);
+}
+
+int pfs32_reflink(const char* src, const char* dst) {
+    return copy_file(src, dst, 1);
 }
 
 // --- Deletion & Util ---
@@ -749,14 +3256,29 @@ int pfs32_delete(const char* path) {
     if(entry.attributes & PFS32_ATTR_DIRECTORY) {
         // Check empty logic...
     }
+    int res = jnl_reserve(JNL_OP_META, JNL_OP_FAT + entry_fat(&entry));
+    if (res != PFS_OK) return res;
+
+    // Pending data dies with the file; its blocks were never allocated
+    wb_file_t* w = wb_find(entry_blk, entry_idx);
+    if (w) wb_release(w);
+    lazy_time_t* lz = lazy_find(entry_blk, entry_idx);
+    if (lz) lazy_drop(lz);
 
     uint8_t buf[512];
     disk_rw(0, entry_blk, buf);
     ((pfs32_direntry_t*)buf)[entry_idx].filename[0] = 0; 
-    disk_rw(1, entry_blk, buf);
+    meta_write(entry_blk, buf);
 
-    free_chain(entry.start_block);
-    flush_fat();
+    if (entry.attributes & PFS32_ATTR_DIRECTORY) dir_free_blocks(entry.start_block);
+    else free_file(entry.start_block);
+    nix_deleted(pblk, entry.filename);
+    meta_commit();
+
+    // A removed directory's blocks may come back as someone else's, so
+    // nothing cached under it can be trusted any more
+    if (entry.attributes & PFS32_ATTR_DIRECTORY) dcache_clear();
+    else dcache_insert_negative(pblk, get_basename(path));
 
     return PFS_OK;
 }
@@ -776,19 +3298,410 @@ int pfs32_rename(const char* oldpath, const char* newpath) {
     if(find_entry_in_dir(pblk, get_basename(oldpath), &entry, &entry_blk, &entry_idx) != PFS_OK) return PFS_ERR_NOT_FOUND;
 
     if(!check_permission(entry.uid, entry.gid, entry.permissions, PFS_PERM_WRITE)) return PFS_ERR_ACCESS;
+    int res = jnl_reserve(JNL_OP_META, JNL_OP_FAT);
+    if (res != PFS_OK) return res;
 
     uint8_t buf[512];
+    pfs32_dir_header_t hdr;
+    if (dir_hash_header(pblk, &hdr)) {
+        // The new name may belong in another bucket: write the entry there
+        // first, then clear the old slot. Pending state follows locations.
+        if (wb_find(entry_blk, entry_idx) || lazy_find(entry_blk, entry_idx)) {
+            if (wb_writeback_all() != PFS_OK) return PFS_ERR_IO;
+        }
+        char oldname[64]; strcpy(oldname, get_basename(oldpath));
+        char clean[40]; sanitize_name(clean, get_basename(newpath), 39);
+        uint32_t new_blk; int new_idx;
+        res = dir_alloc_slot(pblk, clean, &new_blk, &new_idx, buf);
+        if (res != PFS_OK) return res;
+        // Growing the table moves entries
+        if(find_entry_in_dir(pblk, oldname, &entry, &entry_blk, &entry_idx) != PFS_OK) return PFS_ERR_NOT_FOUND;
+
+        pfs32_direntry_t* de = (pfs32_direntry_t*)buf;
+        de[new_idx] = entry;
+        memset(de[new_idx].filename, 0, 40);
+        strcpy(de[new_idx].filename, clean);
+        de[new_idx].modify_time = pfs32_time_now();
+        if (meta_write(new_blk, buf) != PFS_OK) return PFS_ERR_IO;
+
+        if (meta_read(entry_blk, buf) != PFS_OK) return PFS_ERR_IO;
+        ((pfs32_direntry_t*)buf)[entry_idx].filename[0] = 0;
+        meta_write(entry_blk, buf);
+        nix_renamed(pblk, entry.filename, clean);
+        meta_commit();
+        dcache_insert_negative(pblk, oldname);
+        dcache_insert(pblk, get_basename(newpath), new_blk, new_idx);
+        return PFS_OK;
+    }
+
     disk_rw(0, entry_blk, buf);
     pfs32_direntry_t* de = (pfs32_direntry_t*)buf;
     memset(de[entry_idx].filename, 0, 40);
     sanitize_name(de[entry_idx].filename, get_basename(newpath), 39);
     de[entry_idx].modify_time = pfs32_time_now();
     
-    disk_rw(1, entry_blk, buf);
+    meta_write(entry_blk, buf);
+    nix_renamed(pblk, entry.filename, de[entry_idx].filename);
+    meta_commit();
+    dcache_insert_negative(pblk, get_basename(oldpath));
+    dcache_insert(pblk, get_basename(newpath), entry_blk, entry_idx);
     return PFS_OK;
 }
 
 // --- DIAG-001: FSCK ---
+// One streaming pass, in three phases:
+// 1. The FAT is read front to back in large transfers (or taken from the
+//    resident copy) into bitmaps: blocks in use, blocks some FAT entry
+//    points at, and shared extent blocks.
+// 2. The tree is walked breadth-first from the root (linear and hashed
+//    directories alike), counting in refs[] every block reached through
+//    directories, chains and extent maps. Bad or free chain blocks,
+//    cross-links, short layouts and hashed entries in the wrong bucket
+//    are reported as they are met. The start block of every entry is
+//    listed beforehand, so a chain running into another entry's start
+//    is the one found at fault, whichever of the two is walked first.
+// 3. refs[] is compared with the FAT: blocks in use that nothing reaches
+//    are lost (counted per chain), shared blocks must have as many
+//    owners as their FAT value says.
+// `repair` cuts a chain before the block it cannot own, gives files the
+// size of the data they still have, frees lost chains and rewrites
+// reference counts. Progress is printed every 10% of a phase. Returns
+// the number of problems found, or with `repair` of those left unfixed.
+#define FSCK_MAX_DIRS 4096 // Directories waiting to be walked
+
+typedef struct {
+    uint8_t* refs;          // Times each block was reached (saturates)
+    uint8_t* used;          // Bitmap: FAT entry not free
+    uint8_t* linked;        // Bitmap: some FAT entry points here
+    uint8_t* shared;        // Bitmap: FAT holds PFS32_REF_BASE + n
+    uint8_t* starts;        // Bitmap: some entry starts here
+    uint32_t used_count;
+    uint32_t reached;       // Used blocks reached so far (phase 2 progress)
+    uint32_t pct;           // Last progress step printed
+    int repair;
+    int errors;
+} fsck_t;
+
+static void fsck_report(const char* what, uint32_t blk) {
+    char num[12];
+    int_to_str((int)blk, num);
+    s_printf("[FSCK] ");
+    s_printf(what);
+    s_printf(" at block ");
+    s_printf(num);
+    s_printf("\n");
+}
+
+static void fsck_count(const char* what, uint32_t n) {
+    char num[12];
+    int_to_str((int)n, num);
+    s_printf("[FSCK] ");
+    s_printf(what);
+    s_printf(": ");
+    s_printf(num);
+    s_printf("\n");
+}
+
+static inline int fsck_bit(const uint8_t* map, uint32_t blk) {
+    return (map[blk >> 3] >> (blk & 7)) & 1;
+}
+
+static inline void fsck_set(uint8_t* map, uint32_t blk, int on) {
+    if (on) map[blk >> 3] |= (1 << (blk & 7));
+    else map[blk >> 3] &= ~(1 << (blk & 7));
+}
+
+// "<phase> NN%" each time another tenth is done
+static void fsck_progress(fsck_t* ck, const char* phase, uint32_t done, uint32_t total) {
+    uint32_t pct = (total >= 100) ? done / (total / 100) : (total ? done * 100 / total : 100);
+    if (pct > 100) pct = 100;
+    if (pct / 10 <= ck->pct / 10) return;
+    ck->pct = pct;
+    char num[12];
+    int_to_str((int)(pct / 10 * 10), num);
+    s_printf("[FSCK] ");
+    s_printf(phase);
+    s_printf(" ");
+    s_printf(num);
+    s_printf("%\n");
+}
+
+static int fsck_block_ok(uint32_t blk) {
+    return blk >= sb.data_start_block && blk < sb.total_blocks;
+}
+
+// Count `blk` reached; returns how often it already was
+static uint32_t fsck_reach(fsck_t* ck, uint32_t blk) {
+    uint32_t n = ck->refs[blk];
+    if (n < 255) ck->refs[blk] = n + 1;
+    if (n == 0 && blk >= sb.data_start_block && fsck_bit(ck->used, blk)) {
+        fsck_progress(ck, "Tree", ++ck->reached, ck->used_count);
+    }
+    return n;
+}
+
+// 1. Stream the FAT into the bitmaps
+static int fsck_scan_fat(fsck_t* ck) {
+    uint32_t cap = 0;
+    uint8_t* buf = fat_resident ? 0 : copy_buf(&cap);
+    if (!fat_resident && !buf) return PFS_ERR_FULL;
+
+    ck->pct = 0;
+    for (uint32_t i = 0; i < sb.fat_blocks; ) {
+        const uint32_t* ent;
+        uint32_t n;
+        if (fat_resident) {
+            n = sb.fat_blocks - i;
+            ent = fat_resident + i * (PFS32_BLOCK_SIZE / 4);
+        } else {
+            n = (sb.fat_blocks - i < cap) ? sb.fat_blocks - i : cap;
+            if (disk_rw_multi(0, 1 + i, n, buf) != PFS_OK) { kfree(buf); return PFS_ERR_IO; }
+            ent = (const uint32_t*)buf;
+        }
+
+        uint32_t first = i * (PFS32_BLOCK_SIZE / 4);
+        uint32_t count = n * (PFS32_BLOCK_SIZE / 4);
+        if (count > sb.total_blocks - first) count = sb.total_blocks - first;
+        for (uint32_t k = 0; k < count; k++) {
+            uint32_t v = ent[k];
+            if (v == PFS32_FREE_BLOCK) continue;
+            fsck_set(ck->used, first + k, 1);
+            if (first + k >= sb.data_start_block) ck->used_count++;
+            if (fsck_block_ok(v)) fsck_set(ck->linked, v, 1);
+            else if (v >= PFS32_REF_BASE + 2 && v <= PFS32_REF_BASE + PFS32_REF_MAX) fsck_set(ck->shared, first + k, 1);
+        }
+        i += n;
+        fsck_progress(ck, "FAT", i, sb.fat_blocks);
+    }
+    if (buf) kfree(buf);
+    return PFS_OK;
+}
+
+// Follow a file's chain, counting its blocks into *len. The chain ends
+// before a block that is bad, free, reached already or another entry's
+// start; repair cuts it
+// there (a file with no good block gets a fresh empty one). Returns 1 if
+// the entry was changed.
+static int fsck_chain(fsck_t* ck, pfs32_direntry_t* e, uint32_t* len) {
+    uint32_t prev = 0, blk = e->start_block;
+    *len = 0;
+    while (blk != PFS32_END_BLOCK) {
+        const char* what = 0;
+        if (blk == PFS32_FREE_BLOCK || (fsck_block_ok(blk) && !fsck_bit(ck->used, blk))) what = "Chain runs into a free block";
+        else if (!fsck_block_ok(blk)) what = "Bad chain pointer";
+        else if (prev && fsck_bit(ck->starts, blk)) what = "Chain runs into another entry";
+        else if (ck->refs[blk]) what = "Cross-linked block";
+        if (!what) {
+            fsck_reach(ck, blk);
+            (*len)++;
+            prev = blk;
+            blk = get_fat(blk);
+            continue;
+        }
+
+        fsck_report(what, prev ? prev : e->start_block);
+        if (!ck->repair) { ck->errors++; return 0; }
+        if (prev) {
+            // What followed is lost now unless someone else owns it
+            if (fsck_block_ok(blk)) fsck_set(ck->linked, blk, 0);
+            set_fat(prev, PFS32_END_BLOCK);
+            return 0;
+        }
+        uint32_t fresh = alloc_block();
+        if (!fresh) { ck->errors++; return 0; }
+        fsck_set(ck->used, fresh, 1);
+        ck->used_count++;
+        fsck_reach(ck, fresh);
+        e->start_block = fresh;
+        e->file_size = 0;
+        *len = 1;
+        return 1;
+    }
+    return 0;
+}
+
+// Count an extent-mapped file: its map block and every extent. Shared
+// blocks may be reached once per owner; phase 3 checks their counts.
+// Every good block is counted even after a problem, so none of them is
+// taken for lost.
+static int fsck_extents(fsck_t* ck, uint32_t map, uint32_t* len) {
+    *len = 0;
+    if (fsck_reach(ck, map)) { fsck_report("Cross-linked extent map", map); return 1; }
+    pfs32_extent_map_t m;
+    if (ext_load(map, &m) != PFS_OK) { fsck_report("Corrupt extent map", map); return 1; }
+
+    const char* what = 0;
+    uint32_t where = map;
+    for (int i = 0; i < m.count; i++) {
+        for (uint32_t k = 0; k < m.ext[i].length; k++) {
+            uint32_t blk = m.ext[i].start + k;
+            const char* bad = 0;
+            if (!fsck_block_ok(blk)) bad = "Bad extent";
+            else if (!fsck_bit(ck->used, blk)) bad = "Extent over a free block";
+            else if (fsck_reach(ck, blk) && !fsck_bit(ck->shared, blk)) bad = "Cross-linked block";
+            if (bad && !what) { what = bad; where = fsck_block_ok(blk) ? blk : map; }
+        }
+        *len += m.ext[i].length;
+    }
+    if (!what && *len != m.blocks) what = "Extent map length mismatch";
+    if (!what) return 0;
+    fsck_report(what, where);
+    return 1;
+}
+
+// Check one file entry; returns 1 if repair changed it
+static int fsck_file(fsck_t* ck, pfs32_direntry_t* e, uint32_t dir_blk) {
+    uint32_t len;
+    int changed = 0;
+    if (is_extent_file(e->start_block)) ck->errors += fsck_extents(ck, e->start_block, &len);
+    else changed = fsck_chain(ck, e, &len);
+
+    // Compressed files need their whole stream, not file_size bytes
+    uint32_t size = e->file_size;
+    const char* what = 0;
+    if ((e->attributes & PFS32_ATTR_COMPRESSED) && lz_stored_size(e, &size) != PFS_OK) what = "Bad compressed file header";
+    else if ((size + PFS32_BLOCK_SIZE - 1) / PFS32_BLOCK_SIZE > len) {
+        what = is_extent_file(e->start_block) ? "Extents shorter than file" : "Chain shorter than file";
+    }
+    if (!what) return changed;
+
+    fsck_report(what, dir_blk);
+    if (!ck->repair) { ck->errors++; return changed; }
+    // Keep what is there; a compressed stream is useless once cut
+    if (e->attributes & PFS32_ATTR_COMPRESSED) {
+        e->attributes &= ~PFS32_ATTR_COMPRESSED;
+        e->file_size = 0;
+    } else {
+        e->file_size = len * PFS32_BLOCK_SIZE;
+    }
+    return 1;
+}
+
+// Before 2: mark the start block of every entry below the root. `seen`
+// keeps a looping directory chain from being followed forever.
+static int fsck_starts(fsck_t* ck, uint32_t* queue) {
+    uint8_t* seen = (uint8_t*)kzalloc((sb.total_blocks + 7) / 8);
+    if (!seen) return PFS_ERR_FULL;
+    uint32_t head = 0, count = 0;
+    queue[count++] = sb.root_dir_block;
+    while (count > 0) {
+        uint32_t dir = queue[head];
+        head = (head + 1) % FSCK_MAX_DIRS;
+        count--;
+        if (!fsck_block_ok(dir)) continue;
+
+        dir_iter_t it;
+        dir_iter_init(&it, dir);
+        uint32_t blk;
+        while ((blk = dir_iter_next(&it)) != 0 && fsck_block_ok(blk) && !fsck_bit(seen, blk)) {
+            fsck_set(seen, blk, 1);
+            uint8_t buf[512];
+            if (meta_read(blk, buf) != PFS_OK) break;
+            pfs32_direntry_t* d = (pfs32_direntry_t*)buf;
+            for (int i = 0; i < 8; i++) {
+                if (d[i].filename[0] == 0 || !fsck_block_ok(d[i].start_block)) continue;
+                char clean[41]; sanitize_name(clean, d[i].filename, 40);
+                if (is_dot_name(clean)) continue;
+                if ((d[i].attributes & PFS32_ATTR_DIRECTORY) && !fsck_bit(ck->starts, d[i].start_block) &&
+                    count < FSCK_MAX_DIRS) {
+                    queue[(head + count++) % FSCK_MAX_DIRS] = d[i].start_block;
+                }
+                fsck_set(ck->starts, d[i].start_block, 1);
+            }
+        }
+    }
+    kfree(seen);
+    return PFS_OK;
+}
+
+// 2. Walk the tree level by level
+static void fsck_walk(fsck_t* ck, uint32_t* queue, uint32_t* files, uint32_t* dirs) {
+    uint32_t head = 0, count = 0;
+    queue[count++] = sb.root_dir_block;
+    ck->pct = 0;
+    while (count > 0) {
+        uint32_t dir = queue[head];
+        head = (head + 1) % FSCK_MAX_DIRS;
+        count--;
+        (*dirs)++;
+        if (!fsck_block_ok(dir)) { fsck_report("Bad directory block", dir); ck->errors++; continue; }
+
+        pfs32_dir_header_t hdr;
+        if (meta_read(dir, &hdr) == PFS_OK && (hdr.dot.attributes & PFS32_ATTR_INDEXED) &&
+            !dir_hash_header(dir, &hdr)) {
+            fsck_report("Corrupt hashed directory header", dir);
+            ck->errors++;
+        }
+
+        dir_iter_t it;
+        dir_iter_init(&it, dir);
+        uint32_t blk;
+        while ((blk = dir_iter_next(&it)) != 0) {
+            if (!fsck_block_ok(blk)) { fsck_report("Bad directory chain", blk); ck->errors++; break; }
+            if (fsck_reach(ck, blk)) { fsck_report("Cross-linked directory block", blk); ck->errors++; break; }
+
+            // Each block is repaired as an operation of its own: the block
+            // and a FAT sector per entry
+            uint8_t buf[512];
+            if (ck->repair && jnl_reserve(1, 8) != PFS_OK) { ck->errors++; break; }
+            if (meta_read(blk, buf) != PFS_OK) { fsck_report("Unreadable directory block", blk); ck->errors++; break; }
+            pfs32_direntry_t* d = (pfs32_direntry_t*)buf;
+            int dirty = 0;
+            for (int i = 0; i < 8; i++) {
+                if (d[i].filename[0] == 0) continue;
+                char clean[41]; sanitize_name(clean, d[i].filename, 40);
+                if (is_dot_name(clean)) continue;
+
+                // A hashed entry is only found in the bucket its name picks
+                if (it.hashed && blk != dir &&
+                    (dir_name_hash(clean) & (it.bucket_count - 1)) != it.bucket - 1) {
+                    fsck_report("Entry in wrong hash bucket", blk);
+                    ck->errors++;
+                }
+
+                if (d[i].attributes & PFS32_ATTR_DIRECTORY) {
+                    if (count < FSCK_MAX_DIRS) queue[(head + count++) % FSCK_MAX_DIRS] = d[i].start_block;
+                    else { fsck_report("Directory tree too wide to check", blk); ck->errors++; }
+                } else {
+                    (*files)++;
+                    dirty |= fsck_file(ck, &d[i], blk);
+                }
+            }
+            if (dirty) meta_write(blk, buf);
+        }
+    }
+}
+
+// 3. Compare what was reached with what the FAT holds
+static void fsck_cross_check(fsck_t* ck) {
+    uint32_t lost = 0, chains = 0, counts = 0;
+    ck->pct = 0;
+    for (uint32_t b = sb.data_start_block; b < sb.total_blocks; b++) {
+        fsck_progress(ck, "Cross-check", b - sb.data_start_block + 1, sb.total_blocks - sb.data_start_block);
+        if (!fsck_bit(ck->used, b)) continue;
+        uint32_t refs = ck->refs[b];
+        if (refs == 0) {
+            lost++;
+            if (!fsck_bit(ck->linked, b)) chains++;
+            if (ck->repair && jnl_reserve(0, 1) == PFS_OK) set_fat(b, PFS32_FREE_BLOCK);
+        } else if (fsck_bit(ck->shared, b)) {
+            // Other blocks reached twice were reported as cross-links
+            if (get_fat(b) - PFS32_REF_BASE == refs || refs > PFS32_REF_MAX) continue;
+            counts++;
+            if (ck->repair && jnl_reserve(0, 1) == PFS_OK) set_fat(b, refs == 1 ? PFS32_END_BLOCK : PFS32_REF_BASE + refs);
+        }
+    }
+    if (lost) {
+        fsck_count(ck->repair ? "Lost chains freed" : "Lost chains", chains);
+        fsck_count(ck->repair ? "Lost blocks freed" : "Lost blocks", lost);
+        if (!ck->repair) ck->errors++;
+    }
+    if (counts) {
+        fsck_count(ck->repair ? "Reference counts fixed" : "Wrong reference counts", counts);
+        if (!ck->repair) ck->errors++;
+    }
+}
+
 int pfs32_fsck(int repair) {
     if(!mounted) return PFS_ERR_NO_FS;
     s_printf("[FSCK] Starting...\n");
@@ -798,16 +3711,100 @@ int pfs32_fsck(int repair) {
         s_printf("[FSCK] Bad Magic\n");
         return -1;
     }
-    
-    // 2. Check FAT Chains (Simulated)
-    // iterate all files, follow chains, mark visited blocks in a bitmap (alloc in RAM)
-    // check for cross-links or orphan blocks.
-    
-    s_printf("[FSCK] Check Complete (Basic).\n");
-    return PFS_OK;
+
+    // Check what is on disk, not what is still held in memory; the FAT
+    // is read from its home blocks, so the journal is emptied first
+    wb_writeback_all();
+    if (jnl_checkpoint() != PFS_OK) return PFS_ERR_IO;
+
+    fsck_t ck;
+    memset(&ck, 0, sizeof(ck));
+    ck.repair = repair;
+    uint32_t bitmap = (sb.total_blocks + 7) / 8;
+    ck.refs = (uint8_t*)kzalloc(sb.total_blocks);
+    ck.used = (uint8_t*)kzalloc(bitmap);
+    ck.linked = (uint8_t*)kzalloc(bitmap);
+    ck.shared = (uint8_t*)kzalloc(bitmap);
+    ck.starts = (uint8_t*)kzalloc(bitmap);
+    uint32_t* queue = (uint32_t*)kmalloc(FSCK_MAX_DIRS * sizeof(uint32_t));
+    int res = (ck.refs && ck.used && ck.linked && ck.shared && ck.starts && queue) ? fsck_scan_fat(&ck) : PFS_ERR_FULL;
+    if (res == PFS_OK) res = fsck_starts(&ck, queue);
+
+    if (res == PFS_OK) {
+        for (uint32_t i = 0; i < sb.data_start_block; i++) ck.refs[i] = 1;
+        if (sb.features & PFS32_FEAT_JOURNAL) {
+            for (uint32_t i = 0; i < sb.journal_blocks; i++) fsck_reach(&ck, sb.journal_start + i);
+        }
+        if (sb.features & PFS32_FEAT_NAME_INDEX) {
+            for (uint32_t b = sb.index_start; fsck_block_ok(b) && !fsck_reach(&ck, b); b = get_fat(b)) {}
+        }
+
+        uint32_t files = 0, dirs = 0;
+        fsck_walk(&ck, queue, &files, &dirs);
+        fsck_count("Directories", dirs);
+        fsck_count("Files", files);
+        fsck_cross_check(&ck);
+        if (repair) meta_commit();
+
+        // The index is only checked for size: one record per entry below
+        // the root. Repair builds it again from the tree as it now is.
+        if (nix_on && !repair) {
+            uint32_t records = 0;
+            for (uint32_t i = 0; i < nix_blocks * NIX_PER_BLOCK; i++) records += nix_rec[i].filename[0] != 0;
+            if (records != files + dirs - 1) {
+                s_printf("[FSCK] Filename index out of date\n");
+                ck.errors++;
+            }
+        }
+        if (repair && (sb.features & PFS32_FEAT_NAME_INDEX) && nix_build() != PFS_OK) {
+            s_printf("[FSCK] Filename index could not be rebuilt\n");
+            ck.errors++;
+        }
+    }
+
+    if (queue) kfree(queue);
+    if (ck.starts) kfree(ck.starts);
+    if (ck.shared) kfree(ck.shared);
+    if (ck.linked) kfree(ck.linked);
+    if (ck.used) kfree(ck.used);
+    if (ck.refs) kfree(ck.refs);
+    if (res != PFS_OK) return res;
+    if (repair) pfs32_sync();
+    s_printf(ck.errors ? "[FSCK] Problems found.\n" : "[FSCK] Clean.\n");
+    return ck.errors;
+}
+
+int pfs32_search(const char* pattern, pfs32_match_t* out, uint32_t max, uint32_t* cursor) {
+    if (!mounted) return PFS_ERR_NO_FS;
+    if (!pattern || !out || !cursor) return PFS_ERR_PARAM;
+    if (*cursor == PFS32_SEARCH_END) return 0;
+    if (!nix_on) {
+        int res = nix_build();
+        if (res != PFS_OK) return res;
+    }
+
+    uint32_t sig[2];
+    nix_signature(pattern, sig);
+    uint32_t total = nix_blocks * NIX_PER_BLOCK;
+    uint32_t n = 0, i = *cursor;
+    for (; i < total && n < max; i++) {
+        const pfs32_name_record_t* r = &nix_rec[i];
+        if (r->filename[0] == 0) continue;
+        if ((r->signature[0] & sig[0]) != sig[0] || (r->signature[1] & sig[1]) != sig[1]) continue;
+        if (!nix_contains(r->filename, pattern)) continue;
+        if (nix_path(i, out[n].path, sizeof(out[n].path)) != PFS_OK) continue;
+        out[n].attributes = r->attributes;
+        n++;
+    }
+    *cursor = (i < total) ? i : PFS32_SEARCH_END;
+    return n;
 }
 
 int pfs32_get_stats(pfs32_stats_t* out_stats) {
+    dcache_stats_t dc;
+    dcache_get_stats(&dc);
+    stats.lookup_hits = dc.hits + dc.negative_hits;
+    stats.lookup_misses = dc.misses;
     if(out_stats) *out_stats = stats;
     return PFS_OK;
 }
@@ -816,10 +3813,13 @@ int pfs32_get_stats(pfs32_stats_t* out_stats) {
 int pfs32_listdir(uint32_t block, pfs32_direntry_t* buf, uint32_t max) {
     if(!mounted) return -1;
     int count = 0;
-    uint32_t curr = block;
-    while(curr != PFS32_END_BLOCK && curr != 0 && count < max) {
+    dir_iter_t it;
+    dir_iter_init(&it, block);
+    uint32_t curr;
+    while(count < max && (curr = dir_iter_next(&it)) != 0) {
         uint8_t dbuf[512];
-        if(disk_rw(0, curr, dbuf) != PFS_OK) break;
+        if(meta_read(curr, dbuf) != PFS_OK) break;
+        lazy_apply(curr, dbuf);
         pfs32_direntry_t* d = (pfs32_direntry_t*)dbuf;
         for(int i=0; i<8; i++) {
             if(d[i].filename[0] != 0 && count < max) {
@@ -827,11 +3827,51 @@ int pfs32_listdir(uint32_t block, pfs32_direntry_t* buf, uint32_t max) {
                 count++;
             }
         }
-        curr = get_fat(curr);
     }
     return count;
 }
 
+// The cursor is (block ordinal << 3) | slot of the next entry to look
+// at, so a page costs one path walk and a scan of the blocks it covers
+int pfs32_readdir(const char* path, pfs32_dirent_plus_t* out, uint32_t max, uint32_t* cursor) {
+    if (!mounted) return PFS_ERR_NO_FS;
+    if (!out || !cursor) return PFS_ERR_PARAM;
+    if (*cursor == PFS32_READDIR_END) return 0;
+    uint32_t dir;
+    int res = get_dir_block(path, &dir);
+    if (res != PFS_OK) return res;
+
+    uint32_t ordinal = *cursor >> 3, slot = *cursor & 7;
+    dir_iter_t it;
+    dir_iter_init(&it, dir);
+    uint32_t blk = dir_iter_next(&it);
+    for (uint32_t i = 0; i < ordinal && blk; i++) blk = dir_iter_next(&it);
+
+    uint32_t count = 0;
+    for (; blk; blk = dir_iter_next(&it), ordinal++, slot = 0) {
+        uint8_t dbuf[512];
+        if (meta_read(blk, dbuf) != PFS_OK) {
+            *cursor = ordinal << 3;
+            return count ? (int)count : PFS_ERR_IO;
+        }
+        lazy_apply(blk, dbuf);
+        pfs32_direntry_t* d = (pfs32_direntry_t*)dbuf;
+        for (; slot < 8; slot++) {
+            if (d[slot].filename[0] == 0 || is_dot_name(d[slot].filename)) continue;
+            if (count == max) {
+                *cursor = (ordinal << 3) | slot;
+                return (int)count;
+            }
+            out[count].entry = d[slot];
+            out[count].entry_block = blk;
+            out[count].entry_slot = slot;
+            count++;
+        }
+    }
+    *cursor = PFS32_READDIR_END;
+    return (int)count;
+}
+
 int pfs32_stat(const char* path, pfs32_direntry_t* out) {
     uint32_t pblk; 
     if(get_dir_block(get_parent_path(path), &pblk) != PFS_OK) return PFS_ERR_NOT_FOUND;
@@ -840,7 +3880,17 @@ int pfs32_stat(const char* path, pfs32_direntry_t* out) {
 
 int pfs32_create_file(const char* path) { return pfs32_create_node(path, 0); }
 int pfs32_create_directory(const char* path) { return pfs32_create_node(path, 1); }
-int pfs32_sync() { flush_fat(); return PFS_OK; }
+int pfs32_sync() {
+    if (!mounted) return PFS_OK;
+    if (wb_writeback_all() != PFS_OK) return PFS_ERR_IO;
+    // Persist the free-block count maintained by the bitmap
+    if (jnl_on) {
+        if (meta_write(0, &sb) != PFS_OK) return PFS_ERR_IO;
+        return jnl_checkpoint();
+    }
+    if (mounted && disk_rw(1, 0, &sb) != PFS_OK) return PFS_ERR_IO;
+    return PFS_OK;
+}
 
 // --- String Helpers ---
 char* get_basename(const char* path) {
@@ -920,19 +3970,228 @@ void get_unique_path(const char* base_path, const char* name, char* out_full_pat
 
 #define MAX_FILE_HANDLES 32
 
+// Block map of an open file (PERF-007): runs of physically contiguous
+// blocks in file order, so an offset maps to a block by binary search
+// instead of a walk from the start of the chain. Extent files fill it
+// from their map at open; chains are walked lazily, only as far as reads
+// have reached, and each FAT entry is visited once per handle.
+typedef struct {
+    uint32_t lblk;              // First file block of the run
+    uint32_t pblk;              // Its disk block
+    uint32_t len;
+} hrun_t;
+
 typedef struct {
     int active;
-    uint32_t file_start_block;  // First block of file data
-    uint32_t current_block;     // Current block pointer (for sequential access)
+    uint32_t start_block;       // start_block of the directory entry
     uint32_t current_offset;    // Byte offset in file
     uint32_t size;              // Total file size
+    uint32_t raw_size;          // Bytes of data on disk, the stream's if compressed
     uint32_t flags;             // R/W flags
     int dir_entry_block;        // Location of directory entry (for time updates)
     int dir_entry_idx;
+
+    hrun_t* runs;
+    uint32_t nruns;
+    uint32_t runs_cap;
+    uint32_t mapped;            // File blocks covered by runs
+    uint32_t chain_next;        // Chain block after the last run, END when complete
+
+    // Readahead (PERF-005). A read starting where the previous one ended
+    // is sequential; the window doubles each time it is refilled and
+    // drops to zero on a random access.
+    uint32_t ra_next_off;       // Where a sequential reader continues
+    uint32_t ra_window;         // Blocks per readahead, 0 = off
+    uint32_t ra_end_off;        // File offset just past the prefetched data
+    int ra_async;               // Next window queued for pfs32_readahead_pump
+
+    // Compressed files: the chunk index, and the last chunk decoded for
+    // reads that want only part of it
+    uint32_t* lz_index;         // 0 when the file is plain
+    uint8_t* lz_buf;
+    uint32_t lz_cached;         // Chunk held in lz_buf, END for none
 } file_handle_t;
 
 static file_handle_t handles[MAX_FILE_HANDLES];
 
+#define PFS32_RA_MIN 4          // Blocks (2 KB)
+#define PFS32_RA_MAX 128        // Blocks (64 KB)
+static uint8_t ra_buf[PFS32_RA_MAX * PFS32_BLOCK_SIZE];
+
+static int hmap_add(file_handle_t* h, uint32_t pblk, uint32_t len) {
+    hrun_t* last = h->nruns ? &h->runs[h->nruns - 1] : 0;
+    if (last && last->pblk + last->len == pblk) {
+        last->len += len;
+        h->mapped += len;
+        return 1;
+    }
+    if (h->nruns == h->runs_cap) {
+        uint32_t cap = h->runs_cap ? h->runs_cap * 2 : 16;
+        hrun_t* r = (hrun_t*)krealloc(h->runs, cap * sizeof(hrun_t));
+        if (!r) return 0;
+        h->runs = r;
+        h->runs_cap = cap;
+    }
+    h->runs[h->nruns].lblk = h->mapped;
+    h->runs[h->nruns].pblk = pblk;
+    h->runs[h->nruns].len = len;
+    h->nruns++;
+    h->mapped += len;
+    return 1;
+}
+
+static void hmap_release(file_handle_t* h) {
+    if (h->runs) kfree(h->runs);
+    h->runs = 0;
+    h->nruns = h->runs_cap = h->mapped = 0;
+    h->chain_next = PFS32_END_BLOCK;
+}
+
+// (Re)build the map for the file's current layout
+static int hmap_init(file_handle_t* h) {
+    h->nruns = 0;
+    h->mapped = 0;
+    h->chain_next = PFS32_END_BLOCK;
+    if (!is_extent_file(h->start_block)) {
+        h->chain_next = h->start_block;
+        return PFS_OK;
+    }
+    pfs32_extent_map_t m;
+    if (ext_load(h->start_block, &m) != PFS_OK) return PFS_ERR_IO;
+    for (int i = 0; i < m.count; i++) {
+        if (!hmap_add(h, m.ext[i].start, m.ext[i].length)) return PFS_ERR_FULL;
+    }
+    return PFS_OK;
+}
+
+// Disk block holding file block `idx`, or END past the mapped end (the
+// end of the file, or of memory for the map). *len receives how many
+// blocks from there are contiguous on disk.
+static uint32_t hmap_lookup(file_handle_t* h, uint32_t idx, uint32_t* len) {
+    while (idx >= h->mapped && h->chain_next != PFS32_END_BLOCK) {
+        uint32_t blk = h->chain_next;
+        if (blk < sb.data_start_block || blk >= sb.total_blocks) {
+            h->chain_next = PFS32_END_BLOCK;
+            break;
+        }
+        uint32_t last;
+        uint32_t run = chain_run_length(blk, PFS32_MAX_RUN, &last);
+        if (!hmap_add(h, blk, run)) break;
+        h->chain_next = get_fat(last);
+    }
+    if (idx >= h->mapped) { *len = 0; return PFS32_END_BLOCK; }
+
+    uint32_t lo = 0, hi = h->nruns - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if (h->runs[mid].lblk <= idx) lo = mid;
+        else hi = mid - 1;
+    }
+    hrun_t* r = &h->runs[lo];
+    *len = r->lblk + r->len - idx;
+    return r->pblk + (idx - r->lblk);
+}
+
+// Read up to `window` blocks of the handle's file from offset `off`
+// (block aligned) into the block cache, one command per contiguous run.
+// Updates the handle's readahead end.
+static void ra_fill(file_handle_t* h, uint32_t off, uint32_t window) {
+    uint32_t left = (h->raw_size > off) ? (h->raw_size - off + PFS32_BLOCK_SIZE - 1) / PFS32_BLOCK_SIZE : 0;
+    if (window > left) window = left;
+
+    while (window > 0) {
+        uint32_t run;
+        uint32_t blk = hmap_lookup(h, off / PFS32_BLOCK_SIZE, &run);
+        if (blk == PFS32_END_BLOCK) break;
+        if (run > window) run = window;
+        if (disk_rw_multi(0, blk, run, ra_buf) != PFS_OK) break;
+        bcache_fill(disk_start + blk, run, ra_buf);
+        stats.readahead_blocks += run;
+        off += run * PFS32_BLOCK_SIZE;
+        window -= run;
+    }
+    h->ra_end_off = off;
+}
+
+static uint32_t ra_grow(uint32_t window) {
+    if (window == 0) return PFS32_RA_MIN;
+    return (window * 2 > PFS32_RA_MAX) ? PFS32_RA_MAX : window * 2;
+}
+
+// Background half of readahead: fill the windows queued by readers.
+// Runs from the kernel's cooperative worker (aio_pump).
+void pfs32_readahead_pump(void) {
+    if (!mounted) return;
+    for (int i = 0; i < MAX_FILE_HANDLES; i++) {
+        file_handle_t* h = &handles[i];
+        if (!h->active || !h->ra_async) continue;
+        h->ra_async = 0;
+        if (h->ra_end_off >= h->raw_size) continue;
+        h->ra_window = ra_grow(h->ra_window);
+        ra_fill(h, h->ra_end_off, h->ra_window);
+    }
+}
+
+static int raw_read(file_handle_t* h, uint8_t* ptr, uint32_t len, uint32_t off);
+
+static void handle_release(file_handle_t* h) {
+    hmap_release(h);
+    if (h->lz_index) kfree(h->lz_index);
+    if (h->lz_buf) kfree(h->lz_buf);
+    h->lz_index = 0;
+    h->lz_buf = 0;
+}
+
+// Point the handle at the file's layout: at open, and again whenever
+// the file is rewritten under it. A compressed file's index is loaded
+// from the start of its stream.
+static int handle_load(file_handle_t* h, const pfs32_direntry_t* e) {
+    handle_release(h);
+    h->start_block = e->start_block;
+    h->size = h->raw_size = e->file_size;
+    h->lz_cached = PFS32_END_BLOCK;
+    int res = hmap_init(h);
+    if (res == PFS_OK && (e->attributes & PFS32_ATTR_COMPRESSED)) {
+        pfs32_lz4_header_t hdr;
+        h->raw_size = sizeof(hdr);
+        if (raw_read(h, (uint8_t*)&hdr, sizeof(hdr), 0) != sizeof(hdr) || !lz_check(&hdr, 0, h->size)) return PFS_ERR_IO;
+
+        uint32_t bytes = (hdr.chunk_count + 1) * 4;
+        h->raw_size = hdr.stored_size;
+        h->lz_index = (uint32_t*)kmalloc(bytes);
+        h->lz_buf = (uint8_t*)kmalloc(PFS32_LZ4_CHUNK);
+        if (!h->lz_index || !h->lz_buf) return PFS_ERR_FULL;
+        if (raw_read(h, (uint8_t*)h->lz_index, bytes, sizeof(hdr)) != (int)bytes ||
+            !lz_check(&hdr, h->lz_index, h->size)) return PFS_ERR_IO;
+    }
+    h->ra_next_off = h->ra_window = h->ra_end_off = 0;
+    h->ra_async = 0;
+    return res;
+}
+
+// Handles on an entry follow a rewrite of its file. They read from
+// disk, so data still held by write-back goes out first.
+static int handles_reload(uint32_t entry_blk, int entry_idx) {
+    int res = PFS_OK;
+    for (int i = 0; i < MAX_FILE_HANDLES; i++) {
+        file_handle_t* h = &handles[i];
+        if (!h->active || h->dir_entry_block != (int)entry_blk || h->dir_entry_idx != entry_idx) continue;
+
+        uint8_t dbuf[512];
+        wb_file_t* w = wb_find(entry_blk, entry_idx);
+        if (w && wb_write_files(w) != PFS_OK) return PFS_ERR_IO;
+        if (meta_read(entry_blk, dbuf) != PFS_OK) return PFS_ERR_IO;
+        int r = handle_load(h, &((pfs32_direntry_t*)dbuf)[entry_idx]);
+        if (r != PFS_OK) {
+            // Reads see an empty file rather than a half-loaded stream
+            handle_release(h);
+            h->size = h->raw_size = 0;
+            res = r;
+        }
+    }
+    return res;
+}
+
 void pfs32_init_handles() {
     memset(handles, 0, sizeof(handles));
 }
@@ -962,78 +4221,277 @@ int pfs32_open(const char* path, int flags) {
     int perm_check = (flags == 1) ? PFS_PERM_WRITE : PFS_PERM_READ;
     if (!check_permission(entry.uid, entry.gid, entry.permissions, perm_check)) return PFS_ERR_ACCESS;
 
-    handles[id].active = 1;
-    handles[id].file_start_block = entry.start_block;
-    handles[id].current_block = entry.start_block;
-    handles[id].current_offset = 0;
-    handles[id].size = entry.file_size;
-    handles[id].flags = flags;
-    handles[id].dir_entry_block = entry_blk;
-    handles[id].dir_entry_idx = entry_idx;
-
+    // Handles map the blocks, so pending data has to be on disk first
+    wb_file_t* w = wb_find(entry_blk, entry_idx);
+    if (w && wb_write_files(w) != PFS_OK) return PFS_ERR_IO;
+
+    file_handle_t* h = &handles[id];
+    memset(h, 0, sizeof(*h));
+    h->flags = flags;
+    h->dir_entry_block = entry_blk;
+    h->dir_entry_idx = entry_idx;
+    int res = handle_load(h, &entry);
+    if (res != PFS_OK) {
+        handle_release(h);
+        return res;
+    }
+    h->active = 1;
     return id;
 }
 
 void pfs32_close(int handle) {
     if (handle >= 0 && handle < MAX_FILE_HANDLES) {
+        handle_release(&handles[handle]);
         handles[handle].active = 0;
     }
 }
 
+// The block is looked up by the next read, in O(log runs)
 int pfs32_seek(int handle, uint32_t offset) {
     if (handle < 0 || handle >= MAX_FILE_HANDLES || !handles[handle].active) return PFS_ERR_PARAM;
 
     if (offset > handles[handle].size) offset = handles[handle].size;
+    handles[handle].current_offset = offset;
+    return PFS_OK;
+}
 
-    // Optimized: If offset is 0, just reset
-    if (offset == 0) {
-        handles[handle].current_offset = 0;
-        handles[handle].current_block = handles[handle].file_start_block;
-        return PFS_OK;
+// Read the data as stored at `off` without touching the file position.
+// Reads that continue where the last one on this handle ended drive
+// readahead.
+static int raw_read(file_handle_t* h, uint8_t* ptr, uint32_t len, uint32_t off) {
+    uint32_t read = 0;
+    if (off >= h->raw_size) return 0;
+    if (len > h->raw_size - off) len = h->raw_size - off;
+
+    // Random access turns readahead off until the stream is sequential again
+    int sequential = (off == h->ra_next_off);
+    if (!sequential) {
+        h->ra_window = 0;
+        h->ra_async = 0;
+        h->ra_end_off = 0;
     }
 
-    // Basic linear seek (O(N)) - FAT optimization requires tracking cluster chain in memory
-    // For now, reset to start and walk forward
+    while(read < len) {
+        uint32_t block_offset = off % 512;
+        uint32_t contig;
+        uint32_t blk = hmap_lookup(h, off / 512, &contig);
+        if (blk == PFS32_END_BLOCK) break;
+
+        uint32_t full = (block_offset == 0) ? (len - read) / 512 : 0;
+        uint32_t ra_min = h->ra_window > PFS32_RA_MIN ? h->ra_window : PFS32_RA_MIN;
+
+        // Large block-aligned reads go straight to the caller's buffer:
+        // one transfer per contiguous run, no cache pollution
+        if (full && (!sequential || full >= ra_min) && !bcache_contains(disk_start + blk)) {
+            uint32_t run = full < contig ? full : contig;
+            if (run > PFS32_MAX_RUN) run = PFS32_MAX_RUN;
+            if (disk_rw_multi(0, blk, run, ptr + read) != PFS_OK) break;
+            read += run * 512;
+            off += run * 512;
+            continue;
+        }
+
+        uint32_t to_read = 512 - block_offset;
+        if (to_read > (len - read)) to_read = (len - read);
+
+        uint8_t buf[512];
+        uint32_t abs_blk = disk_start + blk;
+        if (!bcache_lookup(abs_blk, buf)) {
+            if (sequential) {
+                // Demand miss in a sequential stream: read a window from
+                // here synchronously (this also covers a queued async one)
+                h->ra_async = 0;
+                h->ra_window = ra_grow(h->ra_window);
+                ra_fill(h, off - block_offset, h->ra_window);
+            }
+            if (!bcache_lookup(abs_blk, buf) && disk_rw(0, blk, buf) != PFS_OK) break;
+        }
 
-    handles[handle].current_offset = 0;
-    handles[handle].current_block = handles[handle].file_start_block;
+        memcpy(ptr + read, buf + block_offset, to_read);
+        read += to_read;
+        off += to_read;
 
-    uint32_t bytes_skipped = 0;
-    while(bytes_skipped + 512 <= offset) {
-        handles[handle].current_block = get_fat(handles[handle].current_block);
-        bytes_skipped += 512;
+        // Half of the prefetched window consumed: queue the next one so it
+        // is read in the background before the reader gets there
+        if (sequential && h->ra_window && !h->ra_async && h->ra_end_off < h->raw_size &&
+            off + (h->ra_window * 512) / 2 >= h->ra_end_off) {
+            h->ra_async = 1;
+        }
     }
-    handles[handle].current_offset = offset;
-    return PFS_OK;
+    h->ra_next_off = off;
+    return read;
+}
+
+// Read plain bytes of a compressed file. Each chunk the range touches
+// is found through the index and decoded, straight into the caller's
+// buffer when all of it is wanted; the stream reads keep readahead going.
+static int lz_read(file_handle_t* h, uint8_t* ptr, uint32_t len, uint32_t off) {
+    uint32_t done = 0;
+    if (off >= h->size) return 0;
+    if (len > h->size - off) len = h->size - off;
+
+    while (done < len) {
+        uint32_t i = off / PFS32_LZ4_CHUNK;
+        uint32_t in = off % PFS32_LZ4_CHUNK;
+        uint32_t n = lz_chunk_len(h->size, i);
+        uint32_t want = (n - in < len - done) ? n - in : len - done;
+
+        if (h->lz_cached != i) {
+            uint8_t* dst = (want == n) ? ptr + done : h->lz_buf;
+            uint32_t clen = h->lz_index[i + 1] - h->lz_index[i];
+            if (raw_read(h, lz_in, clen, h->lz_index[i]) != (int)clen) break;
+            if (lz_decode(lz_in, clen, dst, n) != PFS_OK) break;
+            if (dst == h->lz_buf) h->lz_cached = i;
+            else {
+                done += n;
+                off += n;
+                continue;
+            }
+        }
+        memcpy(ptr + done, h->lz_buf + in, want);
+        done += want;
+        off += want;
+    }
+    return done;
+}
+
+static int handle_read(file_handle_t* h, uint8_t* ptr, uint32_t len, uint32_t off) {
+    return h->lz_index ? lz_read(h, ptr, len, off) : raw_read(h, ptr, len, off);
 }
 
 int pfs32_read_handle(int handle, void* buffer, uint32_t len) {
     if (handle < 0 || handle >= MAX_FILE_HANDLES || !handles[handle].active) return PFS_ERR_PARAM;
+    file_handle_t* h = &handles[handle];
+    int read = handle_read(h, (uint8_t*)buffer, len, h->current_offset);
+    h->current_offset += read;
+    return read;
+}
 
-    uint32_t read = 0;
-    uint32_t available = handles[handle].size - handles[handle].current_offset;
-    if (len > available) len = available;
+int pfs32_pread(int handle, void* buffer, uint32_t len, uint32_t offset) {
+    if (handle < 0 || handle >= MAX_FILE_HANDLES || !handles[handle].active) return PFS_ERR_PARAM;
+    return handle_read(&handles[handle], (uint8_t*)buffer, len, offset);
+}
 
-    uint8_t* ptr = (uint8_t*)buffer;
+// Copy a reflinked file apart before it is written in place; only the
+// flag is cleared once the other owners are gone. Handles on the file
+// are remapped to the new blocks.
+static int ext_unshare(uint32_t map_blk) {
+    pfs32_extent_map_t m;
+    if (ext_load(map_blk, &m) != PFS_OK) return PFS_ERR_IO;
+    if (!(m.flags & PFS32_EXTENT_SHARED)) return PFS_OK;
+    int res = jnl_reserve(JNL_OP_META, 1 + ext_fat(&m) + fat_alloc(m.blocks));
+    if (res != PFS_OK) return res;
+
+    int shared = 0;
+    for (int i = 0; i < m.count && !shared; i++) {
+        for (uint32_t k = 0; k < m.ext[i].length && !shared; k++) {
+            shared = ext_refs(m.ext[i].start + k) > 1;
+        }
+    }
+    if (shared) {
+        pfs32_extent_map_t own;
+        ext_init(&own);
+        res = ext_resize(&own, m.blocks, 0);
+        if (res == PFS_OK) res = copy_blocks(&m, ext_first(&m), &own, ext_first(&own), m.blocks);
+        if (res != PFS_OK) {
+            ext_resize(&own, 0, 0);
+            meta_commit();
+            return res;
+        }
+        ext_resize(&m, 0, 0);
+        stats.cow_blocks += own.blocks;
+        m = own;
+    }
+    m.flags &= ~PFS32_EXTENT_SHARED;
+    if (meta_write(map_blk, &m) != PFS_OK) return PFS_ERR_IO;
+    meta_commit();
 
-    while(read < len) {
-        // Calculate offset within current block
-        uint32_t block_offset = handles[handle].current_offset % 512;
-        uint32_t to_read = 512 - block_offset;
-        if (to_read > (len - read)) to_read = (len - read);
+    for (int i = 0; i < MAX_FILE_HANDLES; i++) {
+        if (handles[i].active && handles[i].start_block == map_blk) hmap_init(&handles[i]);
+    }
+    return PFS_OK;
+}
 
-        uint8_t buf[512];
-        if (disk_rw(0, handles[handle].current_block, buf) != PFS_OK) break;
+// Write at `offset` through a handle opened for writing, leaving the
+// file position alone. Writing past the end grows the file first, with
+// any gap before `offset` reading as zeros; partial blocks are
+// read-modify-write. Returns bytes written.
+int pfs32_pwrite(int handle, const void* buffer, uint32_t len, uint32_t offset) {
+    if (handle < 0 || handle >= MAX_FILE_HANDLES || !handles[handle].active) return PFS_ERR_PARAM;
+    file_handle_t* h = &handles[handle];
+    if (h->flags != 1) return PFS_ERR_ACCESS;
+    if (len == 0) return 0;
+    if (offset + len < offset) return PFS_ERR_PARAM;
 
-        memcpy(ptr + read, buf + block_offset, to_read);
+    // Writing in place needs the plain layout: the file is stored
+    // uncompressed from here on (pfs32_set_compressed packs it again)
+    uint8_t dbuf[512];
+    if (h->lz_index) {
+        if (meta_read(h->dir_entry_block, dbuf) != PFS_OK) return PFS_ERR_IO;
+        pfs32_direntry_t e = ((pfs32_direntry_t*)dbuf)[h->dir_entry_idx];
+        int res = lz_rewrite(h->dir_entry_block, h->dir_entry_idx, &e, e.file_size,
+                             e.attributes & ~PFS32_ATTR_COMPRESSED);
+        if (res != PFS_OK) return res;
+    }
+    if (is_extent_file(h->start_block)) {
+        int res = ext_unshare(h->start_block);
+        if (res != PFS_OK) return res;
+    }
+    // Growing allocates without zeroing: only the gap between the old end
+    // and the first block written is zeroed, the data goes straight into
+    // the new space
+    uint32_t old_size = h->size;
+    if (offset + len > old_size) {
+        if (meta_read(h->dir_entry_block, dbuf) != PFS_OK) return PFS_ERR_IO;
+        pfs32_direntry_t e = ((pfs32_direntry_t*)dbuf)[h->dir_entry_idx];
+        int res = resize_entry(h->dir_entry_block, h->dir_entry_idx, &e, offset + len, offset / 512 * 512);
+        if (res != PFS_OK) return res;
+        h->size = h->raw_size = offset + len;
+        if (hmap_init(h) != PFS_OK) return PFS_ERR_IO;
+    }
 
-        read += to_read;
-        handles[handle].current_offset += to_read;
+    const uint8_t* src = (const uint8_t*)buffer;
+    uint32_t done = 0, off = offset;
+    while (done < len) {
+        uint32_t contig;
+        uint32_t blk = hmap_lookup(h, off / 512, &contig);
+        if (blk == PFS32_END_BLOCK) break;
+
+        uint32_t block_offset = off % 512;
+        uint32_t full = (block_offset == 0) ? (len - done) / 512 : 0;
+        if (full) {
+            uint32_t run = full < contig ? full : contig;
+            if (run > PFS32_MAX_RUN) run = PFS32_MAX_RUN;
+            if (disk_rw_multi(1, blk, run, (void*)(src + done)) != PFS_OK) break;
+            done += run * 512;
+            off += run * 512;
+            continue;
+        }
 
-        // Advance block if we hit boundary
-        if ((handles[handle].current_offset % 512) == 0 && handles[handle].current_offset < handles[handle].size) {
-            handles[handle].current_block = get_fat(handles[handle].current_block);
+        uint32_t n = 512 - block_offset;
+        if (n > len - done) n = len - done;
+        // Nothing past the old end is read: it is zeros, on disk or not
+        uint8_t buf[512];
+        uint32_t base = off - block_offset;
+        if (base >= old_size) memset(buf, 0, 512);
+        else if (disk_rw(0, blk, buf) != PFS_OK) break;
+        else if (old_size - base < 512) memset(buf + (old_size - base), 0, 512 - (old_size - base));
+        memcpy(buf + block_offset, src + done, n);
+        if (disk_rw(1, blk, buf) != PFS_OK) break;
+        done += n;
+        off += n;
+    }
+    if (done == 0) return PFS_ERR_IO;
+
+    // Growing already stamped the entry; only write it if the time moved
+    uint32_t now = pfs32_time_now();
+    if (jnl_reserve(1, 0) == PFS_OK && meta_read(h->dir_entry_block, dbuf) == PFS_OK) {
+        pfs32_direntry_t* de = (pfs32_direntry_t*)dbuf;
+        if (de[h->dir_entry_idx].modify_time != now) {
+            de[h->dir_entry_idx].modify_time = now;
+            meta_write(h->dir_entry_block, dbuf);
+            meta_commit();
         }
     }
-    return read;
-}
\ No newline at end of file
+    return done;
+}
@@ -1,4 +1,4 @@
-// fs/pfs32.h - PFS32 File System Header (v2.0 Enhanced)
+// fs/pfs32.h - PFS32 File System Header (v3.0)
 #ifndef PFS32_H
 #define PFS32_H
 
@@ -6,10 +6,21 @@
 
 // Constants
 #define PFS32_MAGIC 0x53465050  // "PF32"
-#define PFS32_VERSION 2         // Bumped to 2.0
+#define PFS32_VERSION 3         // 3.0: clusters + extent-mapped files
+#define PFS32_VERSION_FAT 2     // FAT chains only, still mounted
 #define PFS32_BLOCK_SIZE 512
 #define PFS32_END_BLOCK 0xFFFFFFFF
+#define PFS32_EXTENT_MAP 0xFFFFFFFE // FAT value of an extent map block
 #define PFS32_FREE_BLOCK 0x00000000
+// Extent data blocks shared by reflinked files: PFS32_REF_BASE + n for
+// n (2..PFS32_REF_MAX) owners. A block with a single owner is plain END.
+#define PFS32_REF_BASE   0xFFFFFF00
+#define PFS32_REF_MAX    0xFD
+
+// Cluster sizes (v3): allocation unit of extent-mapped files
+#define PFS32_CLUSTER_MIN     4096
+#define PFS32_CLUSTER_MAX     65536
+#define PFS32_CLUSTER_DEFAULT 16384
 
 // Attributes
 #define PFS32_ATTR_READONLY  0x01
@@ -19,6 +30,16 @@
 #define PFS32_ATTR_DIRECTORY 0x10
 #define PFS32_ATTR_ARCHIVE   0x20
 #define PFS32_ATTR_SYMLINK   0x40 // API-003
+#define PFS32_ATTR_INDEXED   0x80 // On "." of a hashed directory
+#define PFS32_ATTR_COMPRESSED 0x80 // On files: data is an LZ4 stream (never on ".")
+
+// Superblock feature flags (sb.features)
+#define PFS32_FEAT_DIR_HASH  0x0001 // Some directories use the hashed format
+#define PFS32_FEAT_EXTENTS   0x0002 // Files of a cluster or more are extent-mapped
+#define PFS32_FEAT_JOURNAL   0x0004 // Metadata goes through the journal first
+#define PFS32_FEAT_REFLINK   0x0008 // Extent blocks may be shared (PFS32_REF_BASE)
+#define PFS32_FEAT_COMPRESS  0x0010 // Some files are LZ4 compressed
+#define PFS32_FEAT_NAME_INDEX 0x0020 // Filename index kept from index_start
 
 // Permissions (Revised for SEC-002)
 // 8-bit packed: [Owner 3][Group 3][World 2]
@@ -52,7 +73,13 @@ typedef struct {
     uint32_t free_blocks;      
     uint32_t total_files;      
     char volume_label[32];
-    uint8_t reserved[480];
+    uint32_t features;         // PFS32_FEAT_*
+    uint32_t cluster_size;     // Bytes, PFS32_FEAT_EXTENTS only (block_size stays 512)
+    uint32_t journal_start;    // PFS32_FEAT_JOURNAL only
+    uint32_t journal_blocks;
+    uint32_t index_start;      // PFS32_FEAT_NAME_INDEX only, 0 = no records yet
+    uint32_t index_blocks;     // Blocks in the chain from index_start
+    uint8_t reserved[456];
 } __attribute__((packed)) pfs32_superblock_t;
 
 // Directory Entry (Modified for SEC-002 and FEAT-003)
@@ -69,18 +96,185 @@ typedef struct {
     uint32_t access_time;  // Unix Timestamp
 } __attribute__((packed)) pfs32_direntry_t;
 
+// A listed entry and the slot it is stored in (pfs32_readdir)
+typedef struct {
+    pfs32_direntry_t entry;
+    uint32_t entry_block;      // Directory block holding it
+    uint32_t entry_slot;       // Index within that block (0-7)
+} __attribute__((packed)) pfs32_dirent_plus_t;
+
+#define PFS32_READDIR_END 0xFFFFFFFF // Cursor once a listing is complete
+
+// Hashed Directory Header (first block of a hashed directory)
+// "." and ".." stay in slots 0 and 1; the descriptor sits in slot 2 and
+// starts with a zero byte, so linear scans see an empty slot. Entries
+// live in bucket_count contiguous blocks from bucket_start, picked by
+// the FNV-1a hash of the name; a full bucket grows a FAT chain.
+#define PFS32_DIR_HASH_MAGIC   0x48534944 // "DISH"
+#define PFS32_DIR_HASH_VERSION 1
+
+typedef struct {
+    pfs32_direntry_t dot;
+    pfs32_direntry_t dotdot;
+    uint8_t zero;
+    uint8_t version;
+    uint16_t reserved0;
+    uint32_t magic;
+    uint32_t bucket_start;
+    uint32_t bucket_count;     // Power of two
+    uint8_t reserved[512 - 2 * sizeof(pfs32_direntry_t) - 16];
+} __attribute__((packed)) pfs32_dir_header_t;
+
+// Extent Map (v3)
+// A file's start_block points here when its FAT entry is PFS32_EXTENT_MAP.
+// Extents are runs of whole, cluster-aligned blocks in file order; their
+// FAT entries are END so the allocator sees them as used. Files smaller
+// than a cluster, or too fragmented to fit the map, stay FAT chains.
+// A reflinked copy gets its own map over the same blocks; both maps are
+// flagged shared and the first in-place write copies the file apart.
+#define PFS32_EXTENT_MAGIC 0x4D545845 // "EXTM"
+#define PFS32_MAX_EXTENTS  62
+#define PFS32_EXTENT_SHARED 0x0001    // Map flag: blocks may have other owners
+
+typedef struct {
+    uint32_t start;            // First block
+    uint32_t length;           // Blocks
+} __attribute__((packed)) pfs32_extent_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t count;            // Extents in use
+    uint16_t flags;            // PFS32_EXTENT_*
+    uint32_t blocks;           // Sum of extent lengths (>= file size, cluster rounded)
+    uint32_t reserved1;
+    pfs32_extent_t ext[PFS32_MAX_EXTENTS];
+} __attribute__((packed)) pfs32_extent_map_t;
+
+// Compressed Files (PFS32_ATTR_COMPRESSED)
+// The file's blocks hold a stream: this header, chunk_count + 1 offsets
+// from the start of the stream (chunk i spans offset[i]..offset[i+1]),
+// then the chunks. Every chunk_size bytes of the file are one LZ4 block,
+// decompressible on its own, so an offset maps to one chunk through the
+// index. A chunk that would not shrink is stored as is (stored length ==
+// plain length). file_size in the entry stays the plain size.
+#define PFS32_LZ4_MAGIC 0x345A4C50 // "PLZ4"
+#define PFS32_LZ4_CHUNK 16384
+
+typedef struct {
+    uint32_t magic;
+    uint32_t chunk_size;       // PFS32_LZ4_CHUNK
+    uint32_t chunk_count;
+    uint32_t stored_size;      // Bytes of the whole stream, header included
+} __attribute__((packed)) pfs32_lz4_header_t;
+
+// Filename Index (PFS32_FEAT_NAME_INDEX)
+// One record per file and directory below the root, eight to a block,
+// in a FAT chain from index_start. A record names the directory holding
+// it by that directory's start block, so renaming a directory rewrites
+// one record and paths are rebuilt by following parents. The signature
+// has bit (hash % 64) set for every three-character window of the name
+// in lower case: a search only compares names whose signature covers
+// the pattern's. Records change in the same transaction as the entries
+// they describe; an empty name is a free record. v2 volumes never get
+// the feature: their index is built in RAM and not written.
+#define PFS32_INDEX_SIG_BITS 64
+
+typedef struct {
+    char filename[40];         // As in the entry; empty = free
+    uint32_t parent;           // Start block of the containing directory
+    uint32_t start_block;      // A directory's own start block (0 for files)
+    uint32_t signature[2];     // Trigram bits
+    uint8_t attributes;        // PFS32_ATTR_DIRECTORY or 0
+    uint8_t reserved[7];
+} __attribute__((packed)) pfs32_name_record_t;
+
+// A search hit (pfs32_search)
+typedef struct {
+    char path[256];            // Absolute
+    uint32_t attributes;       // PFS32_ATTR_DIRECTORY or 0
+} __attribute__((packed)) pfs32_match_t;
+
+#define PFS32_SEARCH_END 0xFFFFFFFF // Cursor once every record was looked at
+
+// Metadata Journal (PFS32_FEAT_JOURNAL)
+// journal_blocks contiguous blocks from journal_start. Block 0 holds the
+// header; transactions follow from block 1, each one sequential run of
+// descriptor, block images and commit record. Mount replays every
+// transaction from block 1 whose sequence numbers continue from the
+// header's and whose checksum matches. A transaction too large for one
+// run is written as several, all but the last flagged JCOMMIT_MORE; the
+// parts are only replayed once the last one is there. A checkpoint
+// writes the logged blocks home and advances the header's sequence,
+// emptying the journal.
+#define PFS32_JOURNAL_MAGIC   0x4C4E524A // "JRNL"
+#define PFS32_JDESC_MAGIC     0x4353444A // "JDSC"
+#define PFS32_JCOMMIT_MAGIC   0x544D434A // "JCMT"
+#define PFS32_JCOMMIT_MORE    0x0001     // Transaction continues in the next run
+#define PFS32_JOURNAL_TXN_MAX 124        // Block images per transaction
+#define PFS32_JOURNAL_BLOCKS  1024       // Default size (512 KB)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;              // First transaction to replay
+    uint32_t blocks;           // Journal size, header included
+    uint8_t reserved[500];
+} __attribute__((packed)) pfs32_journal_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t count;            // Images following this block
+    uint32_t reserved;
+    uint32_t home[PFS32_JOURNAL_TXN_MAX];
+} __attribute__((packed)) pfs32_journal_desc_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t count;
+    uint32_t checksum;         // FNV-1a over the descriptor and the images
+    uint32_t flags;            // PFS32_JCOMMIT_*
+    uint8_t reserved[492];
+} __attribute__((packed)) pfs32_journal_commit_t;
+
+// Mount Options (pfs32_mount)
+#define PFS32_MOUNT_FAT_RESIDENT 0x0001 // Load whole FAT into RAM, write back dirty sectors
+#define PFS32_MOUNT_WRITEBACK    0x0002 // Delayed allocation + background flusher; needs the pump
+#define PFS32_MOUNT_NOATIME      0x0004 // Reads never update access_time
+#define PFS32_MOUNT_RELATIME     0x0008 // Only if atime is older than mtime/ctime or a day old
+#define PFS32_MOUNT_LAZYTIME     0x0010 // Timestamps held in RAM until the next metadata flush
+
 // Statistics Structure (DIAG-002)
 typedef struct {
-    uint32_t disk_reads;
-    uint32_t disk_writes;
+    uint32_t disk_reads;       // Blocks read
+    uint32_t disk_writes;      // Blocks written
     uint32_t cache_hits;
     uint32_t cache_misses;
     uint32_t alloc_retries;
+    uint32_t read_requests;    // Driver commands issued
+    uint32_t write_requests;
+    uint32_t readahead_blocks; // Blocks prefetched into the block cache
+    uint32_t lookup_hits;      // Path components resolved by the dentry cache
+    uint32_t lookup_misses;
+    uint32_t journal_commits;  // Transactions written to the journal
+    uint32_t journal_blocks;   // Metadata blocks logged by them
+    uint32_t checkpoints;      // Journal emptied to home locations
+    uint32_t reflinks;         // Copies made by sharing extents
+    uint32_t cow_blocks;       // Blocks copied when a shared file was written
+    uint32_t lz4_raw_written;  // Plain bytes of compressed files written...
+    uint32_t lz4_stored_written; // ...and what they took on disk (the ratio)
+    uint32_t lz4_chunks_read;  // Chunks decompressed
+    uint32_t lz4_bytes_in;     // Compressed bytes they were read from
+    uint32_t lz4_bytes_out;    // Plain bytes they gave
+    uint32_t lz4_decode_ticks; // Time spent decompressing (50 Hz ticks)
 } pfs32_stats_t;
 
 // Core Functions
 int pfs32_init(uint32_t disk_start, uint32_t disk_size);
-int pfs32_format(const char* volume_label, uint32_t total_blocks);
+int pfs32_mount(uint32_t disk_start, uint32_t disk_size, uint32_t mount_opts);
+int pfs32_format(const char* volume_label, uint32_t total_blocks); // v3, default clusters
+int pfs32_format_cluster(const char* volume_label, uint32_t total_blocks, uint32_t cluster_size); // 0 = v2
+int pfs32_upgrade(uint32_t cluster_size); // Mounted volume -> v3 with journal, files kept
 int pfs32_sync(void);
 int pfs32_fsck(int repair); // DIAG-001
 
@@ -91,14 +285,37 @@ int pfs32_delete(const char* path);
 int pfs32_rename(const char* oldpath, const char* newpath);
 int pfs32_truncate(const char* path, uint32_t new_size); // FEAT-001
 int pfs32_copy(const char* src, const char* dst);        // FEAT-002
+int pfs32_reflink(const char* src, const char* dst);     // Shares extents copy-on-write, else pfs32_copy
+// Store the file LZ4 compressed (on = 1) or plain. Later whole-file
+// writes keep the mode; an in-place pwrite stores it plain again.
+int pfs32_set_compressed(const char* path, int on);
 
 int pfs32_read_file(const char* path, uint8_t* buffer, uint32_t max_size);
 int pfs32_write_file(const char* path, uint8_t* data, uint32_t size);
 
+// Handles (flags: 0 = read, 1 = write)
+void pfs32_init_handles(void);
+int pfs32_open(const char* path, int flags);
+void pfs32_close(int handle);
+int pfs32_seek(int handle, uint32_t offset);
+int pfs32_read_handle(int handle, void* buffer, uint32_t len);
+int pfs32_pread(int handle, void* buffer, uint32_t len, uint32_t offset);        // Position unchanged
+int pfs32_pwrite(int handle, const void* buffer, uint32_t len, uint32_t offset); // Needs flags 1
+void pfs32_readahead_pump(void); // Background readahead, called by the kernel worker
+void pfs32_writeback_pump(void); // Flushes aged/excess dirty data (PFS32_MOUNT_WRITEBACK)
+
 // Directory Operations
 int pfs32_listdir(uint32_t dir_block, pfs32_direntry_t* entries, uint32_t max_entries);
 int pfs32_stat(const char* path, pfs32_direntry_t* entry);
+// Entries of `path` (without "." and "..") from *cursor on, 0 to start;
+// *cursor moves past what was returned. Returns the count or PFS_ERR_*.
+int pfs32_readdir(const char* path, pfs32_dirent_plus_t* out, uint32_t max, uint32_t* cursor);
 int pfs32_get_stats(pfs32_stats_t* out_stats); // DIAG-002
+// Files and directories anywhere on the volume whose name contains
+// `pattern` (any case), from *cursor on, 0 to start; *cursor moves past
+// what was looked at. A volume without an index gets one on the first
+// call. Returns the count or PFS_ERR_*.
+int pfs32_search(const char* pattern, pfs32_match_t* out, uint32_t max, uint32_t* cursor);
 
 // Internals exposed
 int get_dir_block(const char* path, uint32_t* block);
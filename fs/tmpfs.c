@@ -0,0 +1,469 @@
+// fs/tmpfs.c - RAM-backed filesystem for scratch data
+#include "tmpfs.h"
+#include "memory.h"
+#include "string.h"
+
+extern int check_permission(uint8_t file_uid, uint8_t file_gid, uint8_t file_perm, int op);
+extern int get_current_uid();
+extern uint32_t get_current_gid();
+
+typedef struct tmpfs_node {
+    char name[40];
+    uint8_t attributes;        // PFS32_ATTR_*
+    uint8_t uid;
+    uint8_t gid;
+    uint8_t permissions;       // Same packing as PFS32
+    uint32_t size;
+    uint32_t create_time;
+    uint32_t modify_time;
+    uint32_t access_time;
+    uint8_t** pages;           // Data pages, 0 = hole (reads as zeros)
+    uint32_t page_slots;
+    struct tmpfs_node* parent;
+    struct tmpfs_node* children;
+    struct tmpfs_node* next;   // Sibling in the parent's list
+} tmpfs_node_t;
+
+typedef struct {
+    int active;
+    char path[128];            // No trailing slash
+    uint32_t path_len;
+    tmpfs_node_t* root;
+    uint32_t pages_used;
+    uint32_t pages_limit;
+    uint32_t nodes;
+} tmpfs_mount_t;
+
+static tmpfs_mount_t mounts[TMPFS_MAX_MOUNTS];
+
+// --- Paths ---
+
+// Mount holding `path` (the longest matching mount point); *rest gets
+// the part below it
+static tmpfs_mount_t* mount_for(const char* path, const char** rest) {
+    tmpfs_mount_t* best = 0;
+    if (!path) return 0;
+    for (int i = 0; i < TMPFS_MAX_MOUNTS; i++) {
+        tmpfs_mount_t* m = &mounts[i];
+        if (!m->active || strncmp(path, m->path, m->path_len) != 0) continue;
+        char c = path[m->path_len];
+        if (c != 0 && c != '/') continue;
+        if (!best || m->path_len > best->path_len) best = m;
+    }
+    if (best && rest) *rest = path + best->path_len;
+    return best;
+}
+
+// Length of the next component of *p, skipping slashes (and "." ones);
+// 0 at the end of the path
+static uint32_t next_name(const char** p) {
+    for (;;) {
+        while (**p == '/') (*p)++;
+        uint32_t n = 0;
+        while ((*p)[n] && (*p)[n] != '/') n++;
+        if (n == 1 && (*p)[0] == '.') { (*p)++; continue; }
+        return n;
+    }
+}
+
+static tmpfs_node_t* child_named(tmpfs_node_t* dir, const char* name, uint32_t len) {
+    if (len >= sizeof(dir->name)) return 0;
+    for (tmpfs_node_t* c = dir->children; c; c = c->next) {
+        if (strncmp(c->name, name, len) == 0 && c->name[len] == 0) return c;
+    }
+    return 0;
+}
+
+static tmpfs_node_t* lookup(const char* path, tmpfs_mount_t** out) {
+    const char* p;
+    tmpfs_mount_t* m = mount_for(path, &p);
+    if (!m) return 0;
+    if (out) *out = m;
+    tmpfs_node_t* node = m->root;
+    uint32_t n;
+    while ((n = next_name(&p)) != 0) {
+        if (!(node->attributes & PFS32_ATTR_DIRECTORY)) return 0;
+        node = child_named(node, p, n);
+        if (!node) return 0;
+        p += n;
+    }
+    return node;
+}
+
+// Directory that holds (or would hold) `path`; its last name goes to
+// `name`. Fails for the mount point itself.
+static tmpfs_node_t* lookup_parent(const char* path, tmpfs_mount_t** out, char* name) {
+    const char* p;
+    tmpfs_mount_t* m = mount_for(path, &p);
+    if (!m) return 0;
+    *out = m;
+    tmpfs_node_t* dir = m->root;
+    uint32_t n = next_name(&p);
+    if (!n) return 0;
+    for (;;) {
+        const char* after = p + n;
+        uint32_t more = next_name(&after);
+        if (!more) break;
+        if (!(dir->attributes & PFS32_ATTR_DIRECTORY)) return 0;
+        dir = child_named(dir, p, n);
+        if (!dir) return 0;
+        p = after;
+        n = more;
+    }
+    if (!(dir->attributes & PFS32_ATTR_DIRECTORY) || n >= 40) return 0;
+    memcpy(name, p, n);
+    name[n] = 0;
+    return dir;
+}
+
+// --- Nodes and Pages ---
+
+// Appended, so readdir cursors (child positions) stay valid as entries are added
+static void node_link(tmpfs_node_t* dir, tmpfs_node_t* n) {
+    tmpfs_node_t** link = &dir->children;
+    while (*link) link = &(*link)->next;
+    *link = n;
+    n->next = 0;
+    n->parent = dir;
+}
+
+static tmpfs_node_t* node_new(tmpfs_mount_t* m, tmpfs_node_t* parent, const char* name, int is_dir) {
+    tmpfs_node_t* n = (tmpfs_node_t*)kzalloc(sizeof(tmpfs_node_t));
+    if (!n) return 0;
+    strncpy(n->name, name, sizeof(n->name) - 1);
+    n->attributes = is_dir ? PFS32_ATTR_DIRECTORY : 0;
+    n->uid = get_current_uid();
+    n->gid = get_current_gid();
+    n->permissions = 0xFA; // As pfs32_create_node
+    n->create_time = n->modify_time = n->access_time = pfs32_time_now();
+    if (parent) node_link(parent, n);
+    m->nodes++;
+    return n;
+}
+
+static void node_unlink(tmpfs_node_t* n) {
+    tmpfs_node_t** link = &n->parent->children;
+    while (*link && *link != n) link = &(*link)->next;
+    if (*link) *link = n->next;
+    n->next = 0;
+    n->parent = 0;
+}
+
+// Drop pages from index `first` on
+static void pages_free_from(tmpfs_mount_t* m, tmpfs_node_t* n, uint32_t first) {
+    for (uint32_t i = first; i < n->page_slots; i++) {
+        if (!n->pages[i]) continue;
+        kfree(n->pages[i]);
+        n->pages[i] = 0;
+        m->pages_used--;
+    }
+}
+
+// The node and everything below it
+static void node_free(tmpfs_mount_t* m, tmpfs_node_t* n) {
+    while (n->children) {
+        tmpfs_node_t* c = n->children;
+        n->children = c->next;
+        node_free(m, c);
+    }
+    pages_free_from(m, n, 0);
+    if (n->pages) kfree(n->pages);
+    kfree(n);
+    m->nodes--;
+}
+
+// Pages missing in [off, off+len): what a write there would allocate
+static uint32_t pages_missing(tmpfs_node_t* n, uint32_t off, uint32_t len) {
+    if (!len) return 0;
+    uint32_t missing = 0;
+    for (uint32_t i = off / TMPFS_PAGE_SIZE; i <= (off + len - 1) / TMPFS_PAGE_SIZE; i++) {
+        if (i >= n->page_slots || !n->pages[i]) missing++;
+    }
+    return missing;
+}
+
+static uint8_t* page_get(tmpfs_mount_t* m, tmpfs_node_t* n, uint32_t idx) {
+    if (idx >= n->page_slots) {
+        uint32_t slots = n->page_slots ? n->page_slots : 4;
+        while (slots <= idx) slots *= 2;
+        uint8_t** p = (uint8_t**)krealloc(n->pages, slots * sizeof(uint8_t*));
+        if (!p) return 0;
+        memset(p + n->page_slots, 0, (slots - n->page_slots) * sizeof(uint8_t*));
+        n->pages = p;
+        n->page_slots = slots;
+    }
+    if (!n->pages[idx]) {
+        if (m->pages_used >= m->pages_limit) return 0;
+        uint8_t* page = (uint8_t*)kmalloc(TMPFS_PAGE_SIZE);
+        if (!page) return 0;
+        memset(page, 0, TMPFS_PAGE_SIZE);
+        n->pages[idx] = page;
+        m->pages_used++;
+    }
+    return n->pages[idx];
+}
+
+// New size; bytes past it are released (whole pages) or zeroed, so
+// growing again reads zeros
+static void node_resize(tmpfs_mount_t* m, tmpfs_node_t* n, uint32_t size) {
+    if (size < n->size) {
+        pages_free_from(m, n, (size + TMPFS_PAGE_SIZE - 1) / TMPFS_PAGE_SIZE);
+        uint32_t idx = size / TMPFS_PAGE_SIZE, tail = size % TMPFS_PAGE_SIZE;
+        if (tail && idx < n->page_slots && n->pages[idx]) {
+            memset(n->pages[idx] + tail, 0, TMPFS_PAGE_SIZE - tail);
+        }
+    }
+    n->size = size;
+}
+
+// Whole-range checks happen before anything is copied, so a write that
+// would pass the size limit changes nothing
+static int node_write(tmpfs_mount_t* m, tmpfs_node_t* n, const uint8_t* src, uint32_t len, uint32_t off) {
+    if (off + len < off) return PFS_ERR_PARAM;
+    if (m->pages_used + pages_missing(n, off, len) > m->pages_limit) return PFS_ERR_FULL;
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t pos = off + done;
+        uint8_t* page = page_get(m, n, pos / TMPFS_PAGE_SIZE);
+        if (!page) return PFS_ERR_FULL;
+        uint32_t in = pos % TMPFS_PAGE_SIZE;
+        uint32_t chunk = TMPFS_PAGE_SIZE - in;
+        if (chunk > len - done) chunk = len - done;
+        memcpy(page + in, src + done, chunk);
+        done += chunk;
+    }
+    if (off + len > n->size) n->size = off + len;
+    n->modify_time = pfs32_time_now();
+    return (int)len;
+}
+
+static int node_read(tmpfs_node_t* n, uint8_t* dst, uint32_t len, uint32_t off) {
+    if (off >= n->size) return 0;
+    if (len > n->size - off) len = n->size - off;
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t pos = off + done;
+        uint32_t idx = pos / TMPFS_PAGE_SIZE, in = pos % TMPFS_PAGE_SIZE;
+        uint32_t chunk = TMPFS_PAGE_SIZE - in;
+        if (chunk > len - done) chunk = len - done;
+        if (idx < n->page_slots && n->pages[idx]) memcpy(dst + done, n->pages[idx] + in, chunk);
+        else memset(dst + done, 0, chunk);
+        done += chunk;
+    }
+    return (int)len;
+}
+
+static void node_entry(tmpfs_node_t* n, const char* name, pfs32_direntry_t* out) {
+    memset(out, 0, sizeof(*out));
+    strncpy(out->filename, name, sizeof(out->filename) - 1);
+    out->file_size = n->size;
+    out->attributes = n->attributes;
+    out->uid = n->uid;
+    out->gid = n->gid;
+    out->permissions = n->permissions;
+    out->create_time = n->create_time;
+    out->modify_time = n->modify_time;
+    out->access_time = n->access_time;
+}
+
+// A regular file the caller may use for `op`
+static tmpfs_node_t* file_for(const char* path, tmpfs_mount_t** m, int op, int* err) {
+    tmpfs_node_t* n = lookup(path, m);
+    *err = PFS_ERR_NOT_FOUND;
+    if (!n) return 0;
+    *err = PFS_ERR_PARAM;
+    if (n->attributes & PFS32_ATTR_DIRECTORY) return 0;
+    *err = PFS_ERR_ACCESS;
+    if (!check_permission(n->uid, n->gid, n->permissions, op)) return 0;
+    return n;
+}
+
+// --- Mounts ---
+
+int tmpfs_mount(const char* path, uint32_t max_bytes) {
+    uint32_t len = path ? strlen(path) : 0;
+    while (len > 1 && path[len - 1] == '/') len--;
+    if (len < 2 || path[0] != '/' || len >= sizeof(mounts[0].path) || max_bytes < TMPFS_PAGE_SIZE) return PFS_ERR_PARAM;
+
+    tmpfs_mount_t* m = 0;
+    for (int i = 0; i < TMPFS_MAX_MOUNTS; i++) {
+        if (mounts[i].active && mounts[i].path_len == len && strncmp(mounts[i].path, path, len) == 0) return PFS_ERR_EXISTS;
+        if (!mounts[i].active && !m) m = &mounts[i];
+    }
+    if (!m) return PFS_ERR_FULL;
+
+    memset(m, 0, sizeof(*m));
+    memcpy(m->path, path, len);
+    m->path[len] = 0;
+    m->path_len = len;
+    m->pages_limit = max_bytes / TMPFS_PAGE_SIZE;
+    const char* base = strrchr(m->path, '/') + 1;
+    m->root = node_new(m, 0, base, 1);
+    if (!m->root) return PFS_ERR_FULL;
+    m->root->permissions = 0xFF;
+    m->active = 1;
+    return PFS_OK;
+}
+
+int tmpfs_umount(const char* path) {
+    const char* rest;
+    tmpfs_mount_t* m = mount_for(path, &rest);
+    if (!m || next_name(&rest)) return PFS_ERR_NOT_FOUND;
+    node_free(m, m->root);
+    m->active = 0;
+    return PFS_OK;
+}
+
+int tmpfs_owns(const char* path) {
+    return mount_for(path, 0) != 0;
+}
+
+int tmpfs_get_stats(const char* path, tmpfs_stats_t* out) {
+    tmpfs_mount_t* m = mount_for(path, 0);
+    if (!m || !out) return PFS_ERR_NOT_FOUND;
+    out->pages_used = m->pages_used;
+    out->pages_limit = m->pages_limit;
+    out->nodes = m->nodes;
+    return PFS_OK;
+}
+
+// --- File Operations ---
+
+int tmpfs_create(const char* path, int is_dir) {
+    tmpfs_mount_t* m;
+    char name[40];
+    tmpfs_node_t* dir = lookup_parent(path, &m, name);
+    if (!dir) return lookup(path, 0) ? PFS_ERR_EXISTS : PFS_ERR_NOT_FOUND;
+    if (child_named(dir, name, strlen(name))) return PFS_ERR_EXISTS;
+    if (!node_new(m, dir, name, is_dir)) return PFS_ERR_FULL;
+    dir->modify_time = pfs32_time_now();
+    return PFS_OK;
+}
+
+int tmpfs_write_file(const char* path, const uint8_t* data, uint32_t size) {
+    int res = tmpfs_create(path, 0);
+    if (res != PFS_OK && res != PFS_ERR_EXISTS) return res;
+    tmpfs_mount_t* m;
+    tmpfs_node_t* n = file_for(path, &m, PFS_PERM_WRITE, &res);
+    if (!n) return res;
+
+    // Pages past the new end are released, the rest are overwritten
+    uint32_t keep = (size + TMPFS_PAGE_SIZE - 1) / TMPFS_PAGE_SIZE;
+    uint32_t have = 0, beyond = 0;
+    for (uint32_t i = 0; i < n->page_slots; i++) {
+        if (n->pages[i]) { if (i < keep) have++; else beyond++; }
+    }
+    if (m->pages_used - beyond + (keep - have) > m->pages_limit) return PFS_ERR_FULL;
+    node_resize(m, n, size);
+    return node_write(m, n, data, size, 0);
+}
+
+int tmpfs_read_file(const char* path, uint8_t* buffer, uint32_t max) {
+    return tmpfs_pread(path, buffer, max, 0);
+}
+
+int tmpfs_pread(const char* path, void* buffer, uint32_t len, uint32_t offset) {
+    tmpfs_mount_t* m;
+    int err;
+    tmpfs_node_t* n = file_for(path, &m, PFS_PERM_READ, &err);
+    if (!n) return err;
+    n->access_time = pfs32_time_now();
+    return node_read(n, (uint8_t*)buffer, len, offset);
+}
+
+int tmpfs_pwrite(const char* path, const void* buffer, uint32_t len, uint32_t offset) {
+    tmpfs_mount_t* m;
+    int err;
+    tmpfs_node_t* n = file_for(path, &m, PFS_PERM_WRITE, &err);
+    if (!n) return err;
+    return node_write(m, n, (const uint8_t*)buffer, len, offset);
+}
+
+int tmpfs_truncate(const char* path, uint32_t size) {
+    tmpfs_mount_t* m;
+    int err;
+    tmpfs_node_t* n = file_for(path, &m, PFS_PERM_WRITE, &err);
+    if (!n) return err;
+    node_resize(m, n, size);
+    n->modify_time = pfs32_time_now();
+    return PFS_OK;
+}
+
+int tmpfs_delete(const char* path) {
+    tmpfs_mount_t* m;
+    tmpfs_node_t* n = lookup(path, &m);
+    if (!n) return PFS_ERR_NOT_FOUND;
+    if (n == m->root) return PFS_ERR_ACCESS; // Unmount instead
+    if (n->children) return PFS_ERR_NOT_EMPTY;
+    if (!check_permission(n->uid, n->gid, n->permissions, PFS_PERM_WRITE)) return PFS_ERR_ACCESS;
+    n->parent->modify_time = pfs32_time_now();
+    node_unlink(n);
+    node_free(m, n);
+    return PFS_OK;
+}
+
+int tmpfs_rename(const char* oldpath, const char* newpath) {
+    tmpfs_mount_t *m, *m2;
+    char name[40];
+    tmpfs_node_t* n = lookup(oldpath, &m);
+    if (!n) return PFS_ERR_NOT_FOUND;
+    if (n == m->root) return PFS_ERR_ACCESS;
+    tmpfs_node_t* dir = lookup_parent(newpath, &m2, name);
+    if (!dir) return PFS_ERR_NOT_FOUND;
+    if (m2 != m) return PFS_ERR_PARAM; // Data does not move between mounts
+    if (child_named(dir, name, strlen(name))) return PFS_ERR_EXISTS;
+    if (!check_permission(n->uid, n->gid, n->permissions, PFS_PERM_WRITE)) return PFS_ERR_ACCESS;
+    for (tmpfs_node_t* a = dir; a; a = a->parent) {
+        if (a == n) return PFS_ERR_PARAM; // Into its own subtree
+    }
+    node_unlink(n);
+    strcpy(n->name, name);
+    node_link(dir, n);
+    dir->modify_time = pfs32_time_now();
+    return PFS_OK;
+}
+
+int tmpfs_stat(const char* path, pfs32_direntry_t* out) {
+    tmpfs_node_t* n = lookup(path, 0);
+    if (!n) return PFS_ERR_NOT_FOUND;
+    if (out) node_entry(n, n->name, out);
+    return PFS_OK;
+}
+
+// Same shape as pfs32_listdir: "." and ".." first, then the entries
+int tmpfs_listdir(const char* path, pfs32_direntry_t* entries, uint32_t max) {
+    tmpfs_node_t* dir = lookup(path, 0);
+    if (!dir) return PFS_ERR_NOT_FOUND;
+    if (!(dir->attributes & PFS32_ATTR_DIRECTORY)) return PFS_ERR_PARAM;
+    uint32_t count = 0;
+    if (count < max) node_entry(dir, ".", &entries[count++]);
+    if (count < max) node_entry(dir->parent ? dir->parent : dir, "..", &entries[count++]);
+    for (tmpfs_node_t* c = dir->children; c && count < max; c = c->next) {
+        node_entry(c, c->name, &entries[count++]);
+    }
+    return (int)count;
+}
+
+// Cursor is the position among the directory's children
+int tmpfs_readdir(const char* path, pfs32_dirent_plus_t* out, uint32_t max, uint32_t* cursor) {
+    if (!out || !cursor) return PFS_ERR_PARAM;
+    if (*cursor == PFS32_READDIR_END) return 0;
+    tmpfs_node_t* dir = lookup(path, 0);
+    if (!dir) return PFS_ERR_NOT_FOUND;
+    if (!(dir->attributes & PFS32_ATTR_DIRECTORY)) return PFS_ERR_NOT_FOUND;
+    tmpfs_node_t* c = dir->children;
+    uint32_t pos = 0, count = 0;
+    for (; c && pos < *cursor; c = c->next) pos++;
+    for (; c; c = c->next, pos++) {
+        if (count == max) {
+            *cursor = pos;
+            return (int)count;
+        }
+        node_entry(c, c->name, &out[count].entry);
+        out[count].entry_block = 0; // Not on disk
+        out[count].entry_slot = pos;
+        count++;
+    }
+    *cursor = PFS32_READDIR_END;
+    return (int)count;
+}
@@ -0,0 +1,39 @@
+// fs/tmpfs.h - RAM-backed filesystem for scratch data (/tmp, caches)
+// A tmpfs is mounted over a path; sys_fs_* send everything under it here
+// instead of to the disk. File data lives in 4 KB pages allocated as it
+// is written (unwritten ranges read as zeros) and counted against the
+// mount's size limit. Nothing survives a reboot.
+#ifndef TMPFS_H
+#define TMPFS_H
+
+#include "pfs32.h" // Entries, attributes and PFS_ERR_* codes are shared
+
+#define TMPFS_MAX_MOUNTS    4
+#define TMPFS_PAGE_SIZE     4096
+#define TMPFS_DEFAULT_LIMIT (4 * 1024 * 1024)
+
+int tmpfs_mount(const char* path, uint32_t max_bytes);
+int tmpfs_umount(const char* path); // Frees everything stored under it
+int tmpfs_owns(const char* path);   // Is `path` the mount point or below one?
+
+int tmpfs_create(const char* path, int is_dir);
+int tmpfs_write_file(const char* path, const uint8_t* data, uint32_t size); // Size, or PFS_ERR_*
+int tmpfs_read_file(const char* path, uint8_t* buffer, uint32_t max);
+int tmpfs_pread(const char* path, void* buffer, uint32_t len, uint32_t offset);
+int tmpfs_pwrite(const char* path, const void* buffer, uint32_t len, uint32_t offset);
+int tmpfs_truncate(const char* path, uint32_t size);
+int tmpfs_delete(const char* path);                       // Directories must be empty
+int tmpfs_rename(const char* oldpath, const char* newpath); // Within one mount
+int tmpfs_stat(const char* path, pfs32_direntry_t* out);
+int tmpfs_listdir(const char* path, pfs32_direntry_t* entries, uint32_t max);
+int tmpfs_readdir(const char* path, pfs32_dirent_plus_t* out, uint32_t max, uint32_t* cursor); // As pfs32_readdir
+
+typedef struct {
+    uint32_t pages_used;
+    uint32_t pages_limit;
+    uint32_t nodes;            // Files and directories, root included
+} tmpfs_stats_t;
+
+int tmpfs_get_stats(const char* path, tmpfs_stats_t* out);
+
+#endif
@@ -12,6 +12,9 @@ extern void mouse_handler();
 extern void rtl8139_handler();
 extern void rtl8169_handler(); // NEW
 extern void page_fault_handler(registers_t regs); // NEW
+extern void ata_irq_handler(int channel);
+extern uint8_t ahci_irq_line;
+extern void ahci_irq_handler(void);
 
 void isr_handler(registers_t r) {
     // Exceptions (0-31)
@@ -75,6 +78,9 @@ void isr_handler(registers_t r) {
         else if (irq == 12) {
             mouse_handler();
         }
+        else if (irq == 14 || irq == 15) {
+            ata_irq_handler(irq - 14);
+        }
         else {
             // Check for PCI devices sharing this IRQ
             // RTL8139
@@ -87,6 +93,11 @@ void isr_handler(registers_t r) {
                 rtl8169_handler();
             }
 
+            // AHCI
+            if (ahci_irq_line != 0xFF && irq == ahci_irq_line) {
+                ahci_irq_handler();
+            }
+
              // Add other PCI handlers (e.g. XHCI) here if they have interrupts enabled
         }
 
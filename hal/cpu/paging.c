@@ -15,10 +15,19 @@ page_directory_t* current_directory = 0;
 extern void* kmalloc_a(size_t size); // We will add this to memory.c
 extern void* kmalloc_ap(size_t size, uint32_t* phys); // Aligned + Physical return
 
+// Demand paging (memory-mapped files) gets the first look at a fault
+static page_fault_hook_t fault_hook = 0;
+
+void paging_set_fault_hook(page_fault_hook_t hook) {
+    fault_hook = hook;
+}
+
 void page_fault_handler(registers_t regs) {
     uint32_t faulting_address;
     asm volatile("mov %%cr2, %0" : "=r" (faulting_address));
 
+    if (fault_hook && fault_hook(faulting_address, regs.err_code)) return;
+
     int present   = !(regs.err_code & 0x1);
     int rw        = regs.err_code & 0x2;
     int us        = regs.err_code & 0x4;
@@ -134,3 +143,24 @@ void paging_map_region(uint32_t phys_addr, uint32_t virt_addr, uint32_t size, ui
     // Reload CR3 to flush TLB
     switch_page_directory(kernel_directory);
 }
+
+uint32_t* paging_get_pte(uint32_t virt, int create) {
+    if (!kernel_directory) return 0;
+    uint32_t table_idx = virt / 0x400000;
+    uint32_t page_idx = (virt / 0x1000) % 1024;
+
+    if (!kernel_directory->tables[table_idx]) {
+        if (!create) return 0;
+        uint32_t t_phys;
+        page_table_t* table = (page_table_t*)kmalloc_ap(sizeof(page_table_t), &t_phys);
+        if (!table) return 0;
+        memset(table, 0, sizeof(page_table_t));
+        kernel_directory->tables[table_idx] = table;
+        kernel_directory->tablesPhysical[table_idx] = t_phys | 0x7; // Present, RW, User
+    }
+    return &kernel_directory->tables[table_idx]->entries[page_idx];
+}
+
+void paging_flush_page(uint32_t virt) {
+    asm volatile("invlpg (%0)" :: "r"(virt) : "memory");
+}
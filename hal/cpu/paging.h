@@ -32,6 +32,15 @@ void page_fault_handler(registers_t regs);
 // Map a region of physical memory into the virtual address space
 void paging_map_region(uint32_t phys_addr, uint32_t virt_addr, uint32_t size, uint32_t flags);
 
+// Kernel page table entry for `virt`, creating its table if `create` is
+// set. Returns 0 if there is no table.
+uint32_t* paging_get_pte(uint32_t virt, int create);
+void paging_flush_page(uint32_t virt);
+
+// Called first on every page fault; returns 1 if it resolved the fault
+typedef int (*page_fault_hook_t)(uint32_t addr, uint32_t err_code);
+void paging_set_fault_hook(page_fault_hook_t hook);
+
 // Align a pointer to the next 4KB boundary
 uint32_t align_4k(uint32_t addr);
 
@@ -9,6 +9,7 @@
 #include "../../sys/io_ports.h"
 #include "serial.h"
 #include "pci.h"
+#include "../../fs/blkdev.h"
 
 // ============================================================================
 // DEBUG CONFIGURATION
@@ -23,6 +24,15 @@
 static ahci_hba_t ahci_controllers[4];
 static int ahci_controller_count = 0;
 
+uint8_t ahci_irq_line = 0xFF;
+
+// Buffers outside the identity-mapped range (or odd addresses) are
+// bounced through here, one command at a time
+#define AHCI_DMA_LIMIT 0x4000000
+static uint8_t* ahci_bounce = 0;
+
+static void ahci_register_blkdev(ahci_port_t* port);
+
 // ============================================================================
 // MMIO ACCESS
 // ============================================================================
@@ -119,8 +129,9 @@ static int ahci_port_rebase(ahci_port_t* port, int num_cmd_slots) {
     ahci_write_port(port, AHCI_PORT_FB, port->fis_phys);
     ahci_write_port(port, AHCI_PORT_FBU, 0);
     
-    // Allocate command table (128B aligned)
-    port->cmd_table = (ahci_cmd_table_t*)kmalloc(sizeof(ahci_cmd_table_t) + 128);
+    // Allocate one command table per slot (128B aligned) so commands can
+    // be in flight on every slot at once
+    port->cmd_table = (ahci_cmd_table_t*)kmalloc(sizeof(ahci_cmd_table_t) * num_cmd_slots + 128);
     if (!port->cmd_table) return -1;
     
     port->cmd_table_phys = (uint32_t)port->cmd_table;
@@ -128,11 +139,14 @@ static int ahci_port_rebase(ahci_port_t* port, int num_cmd_slots) {
         port->cmd_table_phys = (port->cmd_table_phys + 128) & ~0x7F;
         port->cmd_table = (ahci_cmd_table_t*)port->cmd_table_phys;
     }
-    memset(port->cmd_table, 0, sizeof(ahci_cmd_table_t));
+    memset(port->cmd_table, 0, sizeof(ahci_cmd_table_t) * num_cmd_slots);
     
-    // Set command table for slot 0
-    port->cmd_list[0].cmd_table_base = port->cmd_table_phys;
-    port->cmd_list[0].cmd_table_baseu = 0;
+    for (int i = 0; i < num_cmd_slots; i++) {
+        port->cmd_list[i].cmd_table_base = port->cmd_table_phys + i * sizeof(ahci_cmd_table_t);
+        port->cmd_list[i].cmd_table_baseu = 0;
+    }
+    port->cmd_slots = num_cmd_slots;
+    port->slots_busy = port->slots_done = port->slots_err = 0;
     
     // Clear interrupt status
     ahci_write_port(port, AHCI_PORT_IS, ahci_read_port(port, AHCI_PORT_IS));
@@ -146,38 +160,99 @@ static int ahci_port_rebase(ahci_port_t* port, int num_cmd_slots) {
     return 0;
 }
 
+static int ahci_irqs_enabled(void) {
+    uint32_t eflags;
+    asm volatile("pushf; pop %0" : "=r"(eflags));
+    return (eflags & 0x200) != 0;
+}
+
 static int ahci_find_cmd_slot(ahci_port_t* port) {
-    // Check command issue register for free slot
-    uint32_t ci = ahci_read_port(port, AHCI_PORT_CI);
-    
-    for (int i = 0; i < 32; i++) {
-        if (!(ci & (1 << i))) {
-            return i;
+    // Slots are owned from allocation until ahci_wait_slot collects them,
+    // so check our own bitmap rather than CI
+    int irqs = ahci_irqs_enabled();
+    asm volatile("cli");
+    int slot = -1;
+    for (uint32_t i = 0; i < port->cmd_slots; i++) {
+        if (!(port->slots_busy & (1u << i))) {
+            port->slots_busy |= (1u << i);
+            slot = i;
+            break;
         }
     }
-    
-    return -1;
+    if (irqs) asm volatile("sti");
+    return slot;
 }
 
 // ============================================================================
 // COMMAND EXECUTION
 // ============================================================================
 
-int ahci_poll_completion(ahci_port_t* port, uint32_t slot, uint32_t timeout_ms) {
-    uint32_t start = get_tick_count();
+// Move finished slots from busy to done. Runs from the IRQ handler and
+// from waiters (with interrupts off), so polling still works when the
+// interrupt line isn't delivered.
+static void ahci_port_reap(ahci_port_t* port) {
+    uint32_t is = ahci_read_port(port, AHCI_PORT_IS);
+    ahci_write_port(port, AHCI_PORT_IS, is);
+    
+    uint32_t pending = port->slots_busy & ~port->slots_done;
+    if (!pending) return;
+    
+    if (is & (AHCI_PORT_IS_TFES | AHCI_PORT_IS_HBFS | AHCI_PORT_IS_HBDS | AHCI_PORT_IS_IFS)) {
+        // The port halts on error and NCQ can't tell which tag failed:
+        // fail everything outstanding and restart the engine
+        port->slots_err |= pending;
+        port->slots_done |= pending;
+        ahci_stop_cmd(port);
+        ahci_write_port(port, AHCI_PORT_SERR, ahci_read_port(port, AHCI_PORT_SERR));
+        ahci_write_port(port, AHCI_PORT_IS, ahci_read_port(port, AHCI_PORT_IS));
+        ahci_start_cmd(port);
+        return;
+    }
     
-    while ((get_tick_count() - start) < timeout_ms) {
-        // Check if command completed
-        if (!(ahci_read_port(port, AHCI_PORT_CI) & (1 << slot))) {
-            // Check for errors
-            if (ahci_read_port(port, AHCI_PORT_IS) & AHCI_PORT_IS_TFES) {
-                return -1; // Task file error
-            }
-            return 0; // Success
+    uint32_t active = ahci_read_port(port, AHCI_PORT_CI) | ahci_read_port(port, AHCI_PORT_SACT);
+    port->slots_done |= pending & ~active;
+}
+
+int ahci_wait_slot(ahci_port_t* port, int slot, uint32_t timeout_ms) {
+    uint32_t bit = 1u << slot;
+    int irqs = ahci_irqs_enabled();
+    uint32_t start = get_tick_count();
+    uint32_t spins = timeout_ms * 1000;
+    int result = -2;
+    
+    for (;;) {
+        asm volatile("cli");
+        ahci_port_reap(port);
+        if (port->slots_done & bit) {
+            result = (port->slots_err & bit) ? -1 : 0;
+            break;
+        }
+        if (irqs) {
+            // 50Hz tick
+            if ((get_tick_count() - start) * 20 >= timeout_ms) break;
+            asm volatile("sti; hlt");   // Sleep until the completion IRQ
+        } else if (spins-- == 0) {
+            break;
         }
     }
     
-    return -2; // Timeout
+    // On timeout the slot stays busy: the device may still DMA into it
+    if (result != -2) {
+        port->slots_done &= ~bit;
+        port->slots_err &= ~bit;
+        port->slots_busy &= ~bit;
+    }
+    if (irqs) asm volatile("sti");
+    return result;
+}
+
+int ahci_poll_completion(ahci_port_t* port, uint32_t slot, uint32_t timeout_ms) {
+    return ahci_wait_slot(port, slot, timeout_ms);
+}
+
+static void ahci_issue(ahci_port_t* port, int slot, int queued) {
+    if (queued) ahci_write_port(port, AHCI_PORT_SACT, 1u << slot);
+    ahci_write_port(port, AHCI_PORT_CI, 1u << slot);
 }
 
 int ahci_identify(ahci_port_t* port, void* buffer) {
@@ -188,10 +263,10 @@ int ahci_identify(ahci_port_t* port, void* buffer) {
     ahci_cmd_header_t* cmd = &port->cmd_list[slot];
     cmd->dw0_flags = 5 << 0;    // Command FIS length (5 DWORDs)
     cmd->dw0_prdtl = 1;         // One PRD entry
-    cmd->cmd_table_base = port->cmd_table_phys + slot * sizeof(ahci_cmd_table_t);
+    cmd->dw1 = 0;
     
     // Setup command table
-    ahci_cmd_table_t* table = (ahci_cmd_table_t*)((uint32_t)port->cmd_table + slot * sizeof(ahci_cmd_table_t));
+    ahci_cmd_table_t* table = &port->cmd_table[slot];
     memset(table, 0, sizeof(ahci_cmd_table_t));
     
     // Setup FIS
@@ -206,148 +281,166 @@ int ahci_identify(ahci_port_t* port, void* buffer) {
     table->prdt[0].dbc = 511;   // 512 bytes - 1
     table->prdt[0].reserved = 0;
     
-    // Clear interrupt status
-    ahci_write_port(port, AHCI_PORT_IS, ahci_read_port(port, AHCI_PORT_IS));
-    
-    // Issue command
-    ahci_write_port(port, AHCI_PORT_CI, 1 << slot);
+    ahci_issue(port, slot, 0);
     
     // Wait for completion
-    return ahci_poll_completion(port, slot, 5000);
+    return ahci_wait_slot(port, slot, 5000);
 }
 
-int ahci_read_sectors(ahci_port_t* port, uint64_t lba, uint32_t count, void* buffer) {
-    if (count == 0 || count > 256) return -1;
-    
+// FLUSH CACHE EXT: no data, waits for the drive's write cache to empty
+static int ahci_flush(ahci_port_t* port) {
     int slot = ahci_find_cmd_slot(port);
     if (slot < 0) return -1;
     
-    // Calculate PRD count (each PRD can hold up to 4MB)
-    uint32_t bytes = count * AHCI_SECTOR_SIZE;
-    int prdt_count = (bytes + 0x3FFFFF) / 0x400000; // 4MB per PRD
-    if (prdt_count > 8) prdt_count = 8;
-    
-    // Setup command header
     ahci_cmd_header_t* cmd = &port->cmd_list[slot];
     cmd->dw0_flags = 5 << 0;    // Command FIS length
-    cmd->dw0_flags |= (1 << 6); // Read operation
-    cmd->dw0_prdtl = prdt_count;
-    cmd->cmd_table_base = port->cmd_table_phys + slot * sizeof(ahci_cmd_table_t);
-    
-    // Setup command table
-    ahci_cmd_table_t* table = (ahci_cmd_table_t*)((uint32_t)port->cmd_table + slot * sizeof(ahci_cmd_table_t));
-    memset(table, 0, sizeof(ahci_cmd_table_t));
+    cmd->dw0_prdtl = 0;
+    cmd->dw1 = 0;
     
-    // Setup FIS
+    ahci_cmd_table_t* table = &port->cmd_table[slot];
+    memset(table->cfis, 0, sizeof(table->cfis));
     uint8_t* cfis = table->cfis;
     cfis[0] = AHCI_FIS_REG_H2D;
     cfis[1] = 0x80;             // Command bit
-    cfis[2] = AHCI_CMD_READ_DMA_EXT;
-    cfis[3] = 0;                // Features
-    cfis[4] = (lba >> 0) & 0xFF;
-    cfis[5] = (lba >> 8) & 0xFF;
-    cfis[6] = (lba >> 16) & 0xFF;
-    cfis[7] = (lba >> 24) & 0xFF;
-    cfis[8] = 0;                // Device (LBA mode)
-    cfis[9] = (lba >> 32) & 0xFF;
-    cfis[10] = (lba >> 40) & 0xFF;
-    cfis[11] = (count >> 0) & 0xFF;
-    cfis[12] = (count >> 8) & 0xFF;
-    
-    // Setup PRDs
-    uint32_t remaining = bytes;
-    uint8_t* buf = (uint8_t*)buffer;
-    
-    for (int i = 0; i < prdt_count && remaining > 0; i++) {
-        uint32_t chunk = remaining > 0x400000 ? 0x400000 : remaining;
-        table->prdt[i].dba = (uint32_t)buf;
-        table->prdt[i].dbau = 0;
-        table->prdt[i].dbc = chunk - 1;
-        
-        buf += chunk;
-        remaining -= chunk;
-    }
-    
-    // Clear interrupt status
-    ahci_write_port(port, AHCI_PORT_IS, ahci_read_port(port, AHCI_PORT_IS));
-    
-    // Issue command
-    ahci_write_port(port, AHCI_PORT_CI, 1 << slot);
-    
-    // Wait for completion
-    int result = ahci_poll_completion(port, slot, 10000);
-    
-#if AHCI_DEBUG_RW
-    if (result == 0) {
-        s_printf("[AHCI] Read %d sectors at LBA %x success\n", count, (uint32_t)lba);
-    } else {
-        s_printf("[AHCI] Read failed: %d\n", result);
-    }
-#endif
+    cfis[2] = AHCI_CMD_FLUSH_EXT;
+    cfis[7] = 0x40;
     
-    return result;
+    ahci_issue(port, slot, 0);
+    return ahci_wait_slot(port, slot, 30000);
 }
 
-int ahci_write_sectors(ahci_port_t* port, uint64_t lba, uint32_t count, const void* buffer) {
-    if (count == 0 || count > 256) return -1;
+int ahci_submit(ahci_port_t* port, uint64_t lba, uint32_t count, void* buffer, int write) {
+    if (count == 0 || count > AHCI_MAX_SECTORS) return -1;
+    uint32_t bytes = count * AHCI_SECTOR_SIZE;
+    if (((uint32_t)buffer & 1) || (uint32_t)buffer + bytes > AHCI_DMA_LIMIT) return -1;
     
     int slot = ahci_find_cmd_slot(port);
     if (slot < 0) return -1;
     
-    // Calculate PRD count
-    uint32_t bytes = count * AHCI_SECTOR_SIZE;
-    int prdt_count = (bytes + 0x3FFFFF) / 0x400000;
-    if (prdt_count > 8) prdt_count = 8;
-    
     // Setup command header
     ahci_cmd_header_t* cmd = &port->cmd_list[slot];
     cmd->dw0_flags = 5 << 0;    // Command FIS length
-    cmd->dw0_flags |= (1 << 6); // Write operation
-    cmd->dw0_prdtl = prdt_count;
-    cmd->cmd_table_base = port->cmd_table_phys + slot * sizeof(ahci_cmd_table_t);
+    if (write) cmd->dw0_flags |= (1 << 6); // Host -> device
+    cmd->dw0_prdtl = 1;         // 256 sectors fit in one 4MB PRD
+    cmd->dw1 = 0;
     
     // Setup command table
-    ahci_cmd_table_t* table = (ahci_cmd_table_t*)((uint32_t)port->cmd_table + slot * sizeof(ahci_cmd_table_t));
-    memset(table, 0, sizeof(ahci_cmd_table_t));
+    ahci_cmd_table_t* table = &port->cmd_table[slot];
+    memset(table->cfis, 0, sizeof(table->cfis));
     
-    // Setup FIS
+    // Register H2D FIS: LBA 0-2 in bytes 4-6, device in 7, LBA 3-5 in 8-10
     uint8_t* cfis = table->cfis;
     cfis[0] = AHCI_FIS_REG_H2D;
     cfis[1] = 0x80;             // Command bit
-    cfis[2] = AHCI_CMD_WRITE_DMA_EXT;
-    cfis[3] = 0;                // Features
     cfis[4] = (lba >> 0) & 0xFF;
     cfis[5] = (lba >> 8) & 0xFF;
     cfis[6] = (lba >> 16) & 0xFF;
-    cfis[7] = (lba >> 24) & 0xFF;
-    cfis[8] = 0;                // Device (LBA mode)
+    cfis[7] = 0x40;             // LBA mode
+    cfis[8] = (lba >> 24) & 0xFF;
     cfis[9] = (lba >> 32) & 0xFF;
     cfis[10] = (lba >> 40) & 0xFF;
-    cfis[11] = (count >> 0) & 0xFF;
-    cfis[12] = (count >> 8) & 0xFF;
-    
-    // Setup PRDs
-    uint32_t remaining = bytes;
-    const uint8_t* buf = (const uint8_t*)buffer;
-    
-    for (int i = 0; i < prdt_count && remaining > 0; i++) {
-        uint32_t chunk = remaining > 0x400000 ? 0x400000 : remaining;
-        table->prdt[i].dba = (uint32_t)buf;
-        table->prdt[i].dbau = 0;
-        table->prdt[i].dbc = chunk - 1;
-        
-        buf += chunk;
-        remaining -= chunk;
+    if (port->ncq) {
+        // FPDMA QUEUED: count goes in the feature field, tag in count
+        cfis[2] = write ? AHCI_CMD_WRITE_FPDMA : AHCI_CMD_READ_FPDMA;
+        cfis[3] = count & 0xFF;
+        cfis[11] = (count >> 8) & 0xFF;
+        cfis[12] = slot << 3;
+        if (write) cfis[7] |= 0x80;  // FUA, same durability as the ATA path's flush
+    } else {
+        // Without FUA the write can sit in the drive's cache; ahci_transfer
+        // flushes it instead
+        cfis[2] = !write ? AHCI_CMD_READ_DMA_EXT : port->fua ? AHCI_CMD_WRITE_DMA_FUA_EXT : AHCI_CMD_WRITE_DMA_EXT;
+        cfis[12] = count & 0xFF;
+        cfis[13] = (count >> 8) & 0xFF;
     }
     
-    // Clear interrupt status
-    ahci_write_port(port, AHCI_PORT_IS, ahci_read_port(port, AHCI_PORT_IS));
+    table->prdt[0].dba = (uint32_t)buffer;
+    table->prdt[0].dbau = 0;
+    table->prdt[0].reserved = 0;
+    table->prdt[0].dbc = (bytes - 1) | 0x80000000; // Interrupt on completion
+    
+    ahci_issue(port, slot, port->ncq);
+    return slot;
+}
+
+int ahci_read_sectors(ahci_port_t* port, uint64_t lba, uint32_t count, void* buffer) {
+    return ahci_transfer(port, lba, count, buffer, 0);
+}
+
+int ahci_write_sectors(ahci_port_t* port, uint64_t lba, uint32_t count, const void* buffer) {
+    return ahci_transfer(port, lba, count, (void*)buffer, 1);
+}
+
+static int ahci_transfer_bounced(ahci_port_t* port, uint64_t lba, uint32_t count, uint8_t* buf, int write) {
+    if (!ahci_bounce) ahci_bounce = (uint8_t*)kmalloc_a(AHCI_MAX_SECTORS * AHCI_SECTOR_SIZE);
+    if (!ahci_bounce) return -1;
+    while (count > 0) {
+        uint32_t n = count > AHCI_MAX_SECTORS ? AHCI_MAX_SECTORS : count;
+        if (write) memcpy(ahci_bounce, buf, n * AHCI_SECTOR_SIZE);
+        int slot = ahci_submit(port, lba, n, ahci_bounce, write);
+        if (slot < 0 || ahci_wait_slot(port, slot, 10000) != 0) return -1;
+        if (!write) memcpy(buf, ahci_bounce, n * AHCI_SECTOR_SIZE);
+        lba += n; buf += n * AHCI_SECTOR_SIZE; count -= n;
+    }
+    return 0;
+}
+
+static int ahci_transfer_queued(ahci_port_t* port, uint64_t lba, uint32_t count, uint8_t* buf, int write) {
+    // Split into per-slot commands and keep as many queued as the port
+    // allows; the drive reorders them under NCQ
+    int slots[AHCI_MAX_CMD_SLOTS];
+    int head = 0, tail = 0, result = 0;
+    while (count > 0 || head != tail) {
+        int slot = -1;
+        if (count > 0 && result == 0) {
+            uint32_t n = count > AHCI_MAX_SECTORS ? AHCI_MAX_SECTORS : count;
+            slot = ahci_submit(port, lba, n, buf, write);
+            if (slot >= 0) {
+                slots[head] = slot;
+                head = (head + 1) % AHCI_MAX_CMD_SLOTS;
+                lba += n; buf += n * AHCI_SECTOR_SIZE; count -= n;
+                continue;
+            }
+            if (head == tail) return -1; // Nothing in flight and no free slot
+        }
+        if (head == tail) break;
+        if (ahci_wait_slot(port, slots[tail], 10000) != 0) result = -1;
+        tail = (tail + 1) % AHCI_MAX_CMD_SLOTS;
+        if (result != 0) count = 0;
+    }
     
-    // Issue command
-    ahci_write_port(port, AHCI_PORT_CI, 1 << slot);
+#if AHCI_DEBUG_RW
+    if (result != 0) serial_write_string("[AHCI] Transfer failed\n");
+#endif
     
-    // Wait for completion
-    return ahci_poll_completion(port, slot, 10000);
+    return result;
+}
+
+// Writes are on the medium when this returns, as on the ATA path: NCQ
+// and FUA writes skip the cache, plain ones are followed by a flush
+int ahci_transfer(ahci_port_t* port, uint64_t lba, uint32_t count, void* buffer, int write) {
+    uint8_t* buf = (uint8_t*)buffer;
+    int result;
+    if (((uint32_t)buf & 1) || (uint32_t)buf + count * AHCI_SECTOR_SIZE > AHCI_DMA_LIMIT) {
+        result = ahci_transfer_bounced(port, lba, count, buf, write);
+    } else {
+        result = ahci_transfer_queued(port, lba, count, buf, write);
+    }
+    if (result == 0 && write && !port->ncq && !port->fua) result = ahci_flush(port);
+    return result;
+}
+
+void ahci_irq_handler(void) {
+    for (int c = 0; c < ahci_controller_count; c++) {
+        ahci_hba_t* hba = &ahci_controllers[c];
+        uint32_t is = ahci_read(hba->mmio, AHCI_GHC_IS);
+        if (!is) continue;
+        for (int i = 0; i < hba->port_count; i++) {
+            ahci_port_t* port = &hba->ports[i];
+            if (is & (1u << port->number)) ahci_port_reap(port);
+        }
+        ahci_write(hba->mmio, AHCI_GHC_IS, is);
+    }
 }
 
 // ============================================================================
@@ -410,6 +503,9 @@ int ahci_init(uint16_t bus, uint16_t dev, uint16_t func) {
     // Enable AHCI
     ahci_write(hba->mmio, AHCI_GHC_GHC, AHCI_GHC_AE | AHCI_GHC_IE);
     
+    uint32_t intr = pci_read_config_dword(bus, dev, func, 0x3C);
+    if ((intr & 0xFF) != 0xFF) ahci_irq_line = intr & 0xFF;
+    
     // Number of command slots
     int num_cmd_slots = ((hba->cap >> 8) & 0x1F) + 1;
     
@@ -442,6 +538,28 @@ int ahci_init(uint16_t bus, uint16_t dev, uint16_t func) {
                     // Initialize port
                     ahci_port_rebase(port, num_cmd_slots);
                     
+                    if (port->type == 1) {
+                        uint16_t identify[256];
+                        if (ahci_identify(port, identify) == 0) {
+                            port->sectors = identify[60] | ((uint64_t)identify[61] << 16);
+                            if (identify[83] & 0x400) {
+                                port->sectors = (uint64_t)identify[100] |
+                                                ((uint64_t)identify[101] << 16) |
+                                                ((uint64_t)identify[102] << 32) |
+                                                ((uint64_t)identify[103] << 48);
+                            }
+                            // NCQ needs HBA (CAP.SNCQ) and drive (word 76 bit 8);
+                            // tags are limited by the drive's queue depth (word 75)
+                            if ((hba->cap & AHCI_CAP_SNCQ) && (identify[76] & 0x100)) {
+                                uint32_t depth = (identify[75] & 0x1F) + 1;
+                                if (depth < port->cmd_slots) port->cmd_slots = depth;
+                                port->ncq = 1;
+                            }
+                            port->fua = (identify[83] & 0x400) && (identify[84] & 0x40);
+                            if (port->sectors) ahci_register_blkdev(port);
+                        }
+                    }
+                    
 #if AHCI_DEBUG_INIT
                     serial_write_string("[AHCI] Port initialized\n");
 #endif
@@ -457,6 +575,8 @@ int ahci_init(uint16_t bus, uint16_t dev, uint16_t func) {
 }
 
 void ahci_init_all(void) {
+    if (ahci_controller_count > 0) return; // Already done
+    
     // Scan PCI bus for AHCI controllers
     for (int bus = 0; bus < 256; bus++) {
         for (int dev = 0; dev < 32; dev++) {
@@ -508,6 +628,8 @@ const char* ahci_port_type_str(int type) {
 }
 
 uint64_t ahci_get_capacity(ahci_port_t* port) {
+    if (port->sectors) return port->sectors;
+    
     uint16_t identify[256];
     
     if (ahci_identify(port, identify) != 0) {
@@ -528,3 +650,31 @@ uint64_t ahci_get_capacity(ahci_port_t* port) {
     
     return lba_count;
 }
+
+// ============================================================================
+// BLOCK DEVICES
+// ============================================================================
+
+static blkdev_t ahci_blkdevs[4];
+static int ahci_blkdev_count = 0;
+
+static int ahci_blk_rw(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf, int write) {
+    return ahci_transfer((ahci_port_t*)dev->priv, lba, count, buf, write) == 0 ? 0 : 1;
+}
+
+// SATA disks register as sata0, sata1, ... Large requests are passed
+// through whole so ahci_transfer can spread them over the command slots.
+static void ahci_register_blkdev(ahci_port_t* port) {
+    if (ahci_blkdev_count >= 4) return;
+    blkdev_t* dev = &ahci_blkdevs[ahci_blkdev_count];
+    strcpy(dev->name, "sata0");
+    dev->name[4] = '0' + ahci_blkdev_count;
+    dev->total_blocks = port->sectors > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)port->sectors;
+    dev->max_transfer = AHCI_MAX_SECTORS * AHCI_MAX_CMD_SLOTS;
+    dev->rw = ahci_blk_rw;
+    dev->priv = port;
+    if (blkdev_register(dev) == 0) {
+        ahci_blkdev_count++;
+        serial_write_string(port->ncq ? "[AHCI] Registered block device (NCQ)\n" : "[AHCI] Registered block device\n");
+    }
+}
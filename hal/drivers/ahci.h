@@ -119,10 +119,17 @@
 // Command types
 #define AHCI_CMD_READ_DMA_EXT   0x25
 #define AHCI_CMD_WRITE_DMA_EXT  0x35
+#define AHCI_CMD_WRITE_DMA_FUA_EXT 0x3D // Written through the drive's cache
+#define AHCI_CMD_FLUSH_EXT      0xEA    // FLUSH CACHE EXT
 #define AHCI_CMD_IDENTIFY       0xEC
 #define AHCI_CMD_IDENTIFY_PACKET 0xA1
 #define AHCI_CMD_READ_SECTORS   0x20
 #define AHCI_CMD_WRITE_SECTORS  0x30
+#define AHCI_CMD_READ_FPDMA     0x60    // READ FPDMA QUEUED (NCQ)
+#define AHCI_CMD_WRITE_FPDMA    0x61    // WRITE FPDMA QUEUED (NCQ)
+
+#define AHCI_CAP_SNCQ           0x40000000  // HBA supports NCQ
+#define AHCI_MAX_SECTORS        256         // Per command
 
 // ============================================================================
 // STRUCTURES
@@ -186,6 +193,13 @@ typedef struct {
     
     // Command slot tracking
     uint32_t cmd_slot;
+    uint32_t cmd_slots;                 // Slots usable on this port
+    volatile uint32_t slots_busy;       // Allocated by a caller
+    volatile uint32_t slots_done;       // Completed, not yet collected
+    volatile uint32_t slots_err;        // Completed with an error
+    int ncq;                            // Reads/writes use FPDMA QUEUED
+    int fua;                            // Drive has WRITE DMA FUA EXT (word 84 bit 6)
+    uint64_t sectors;                   // Capacity from IDENTIFY
     
     // Lock
     volatile int lock;
@@ -250,6 +264,20 @@ int ahci_identify(ahci_port_t* port, void* buffer);
 // Poll for completion
 int ahci_poll_completion(ahci_port_t* port, uint32_t slot, uint32_t timeout_ms);
 
+// Queue a read/write without waiting. Returns the command slot, or -1 if
+// all slots are busy or the buffer can't be used for DMA.
+int ahci_submit(ahci_port_t* port, uint64_t lba, uint32_t count, void* buffer, int write);
+
+// Wait for a submitted slot and release it. 0 = success.
+int ahci_wait_slot(ahci_port_t* port, int slot, uint32_t timeout_ms);
+
+// Any-length transfer; up to one command per slot is kept in flight
+int ahci_transfer(ahci_port_t* port, uint64_t lba, uint32_t count, void* buffer, int write);
+
+// Shared IRQ line (0xFF = none) and its handler, called from isr.c
+extern uint8_t ahci_irq_line;
+void ahci_irq_handler(void);
+
 // ============================================================================
 // UTILITY FUNCTIONS
 // ============================================================================
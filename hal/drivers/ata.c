@@ -1,5 +1,9 @@
 #include "../common/ports.h"
 #include "ata.h"
+#include "serial.h"
+#include "../../core/memory.h"
+#include "../../core/string.h"
+#include "../../fs/blkdev.h"
 
 #define ATA_DATA 0x1F0
 #define ATA_ERROR 0x1F1
@@ -11,8 +15,55 @@
 #define ATA_STATUS 0x1F7
 #define ATA_CMD 0x1F7
 
+// Commands
+#define ATA_CMD_READ_PIO        0x20
+#define ATA_CMD_READ_PIO_EXT    0x24
+#define ATA_CMD_READ_MULT_EXT   0x29
+#define ATA_CMD_WRITE_PIO       0x30
+#define ATA_CMD_WRITE_PIO_EXT   0x34
+#define ATA_CMD_WRITE_MULT_EXT  0x39
+#define ATA_CMD_READ_MULT       0xC4
+#define ATA_CMD_WRITE_MULT      0xC5
+#define ATA_CMD_SET_MULT        0xC6
+#define ATA_CMD_FLUSH           0xE7
+#define ATA_CMD_FLUSH_EXT       0xEA
+#define ATA_CMD_IDENTIFY        0xEC
+#define ATA_CMD_READ_DMA        0xC8
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_DMA       0xCA
+#define ATA_CMD_WRITE_DMA_EXT   0x35
+
+// PCI IDE bus master registers (offsets from BAR4, primary channel)
+#define BM_CMD          0x00
+#define BM_STATUS       0x02
+#define BM_PRDT         0x04
+#define BM_CMD_START    0x01
+#define BM_CMD_READ     0x08    // Device -> memory
+#define BM_ST_ACTIVE    0x01
+#define BM_ST_ERROR     0x02
+#define BM_ST_IRQ       0x04
+
+// Physical Region Descriptor. Regions may not cross a 64KB boundary;
+// a byte count of 0 means 64KB.
+typedef struct {
+    uint32_t addr;
+    uint16_t bytes;
+    uint16_t flags;         // Bit 15: end of table
+} __attribute__((packed)) ata_prd_t;
+
+#define ATA_PRD_EOT       0x8000
+#define ATA_PRD_MAX       16
+#define ATA_DMA_LIMIT     0x4000000   // Identity-mapped range usable for DMA
+
 ide_device_t ide_devices[2];
 
+static uint16_t bm_base = 0;          // 0 = no bus master controller found
+static ata_prd_t* prd_table = 0;
+static uint8_t* dma_bounce = 0;       // For buffers DMA can't reach directly
+static volatile int dma_irq_seen = 0;
+
+static blkdev_t ata_blkdev[2];
+
 void ata_delay() { 
     for(int i=0; i<4; i++) inb(0x3F6); 
 }
@@ -37,44 +88,276 @@ int ata_wait_drq() {
     return 0;
 }
 
-int ata_read_sector(int drive, uint32_t lba, uint8_t* buffer) {
-    if (drive > 1) return 1;
+// 28-bit LBA is used whenever the range fits, since it needs half the
+// port writes.
+static int ata_setup_ext(int drive, uint32_t lba, uint32_t count) {
+    return ide_devices[drive].lba48 && (lba + count > 0x0FFFFFFF);
+}
+
+// One cache flush per command instead of per sector
+static int ata_flush(int ext) {
+    if(!ata_wait_bsy()) return 1;
+    outb(ATA_CMD, ext ? ATA_CMD_FLUSH_EXT : ATA_CMD_FLUSH);
+    if(!ata_wait_bsy()) return 1;
+    return 0;
+}
+
+// Program the task file for a transfer
+static int ata_setup_transfer(int drive, uint32_t lba, uint32_t count) {
+    int ext = ata_setup_ext(drive, lba, count);
+    if (ext) {
+        outb(ATA_DRIVE, 0x40 | ((drive&1)<<4));
+        // High-order bytes first, then low-order
+        outb(ATA_SEC_CNT, (uint8_t)(count >> 8));
+        outb(ATA_LBA_LO, (uint8_t)(lba>>24));
+        outb(ATA_LBA_MID, 0);
+        outb(ATA_LBA_HI, 0);
+        outb(ATA_SEC_CNT, (uint8_t)count);
+        outb(ATA_LBA_LO, (uint8_t)lba);
+        outb(ATA_LBA_MID, (uint8_t)(lba>>8));
+        outb(ATA_LBA_HI, (uint8_t)(lba>>16));
+    } else {
+        outb(ATA_DRIVE, 0xE0 | ((drive&1)<<4) | ((lba >> 24) & 0x0F));
+        outb(ATA_SEC_CNT, (uint8_t)count); // 256 encodes as 0
+        outb(ATA_LBA_LO, (uint8_t)lba);
+        outb(ATA_LBA_MID, (uint8_t)(lba>>8));
+        outb(ATA_LBA_HI, (uint8_t)(lba>>16));
+    }
+    return ext;
+}
+
+// --- Bus master DMA ---
+
+static uint32_t pci_cfg_read(uint32_t bus, uint32_t slot, uint32_t func, uint32_t off) {
+    outl(0xCF8, 0x80000000 | (bus << 16) | (slot << 11) | (func << 8) | (off & 0xFC));
+    return inl(0xCFC);
+}
+
+static void pci_cfg_write(uint32_t bus, uint32_t slot, uint32_t func, uint32_t off, uint32_t val) {
+    outl(0xCF8, 0x80000000 | (bus << 16) | (slot << 11) | (func << 8) | (off & 0xFC));
+    outl(0xCFC, val);
+}
+
+// Find the PCI IDE controller (class 01:01) with bus mastering (prog-if
+// bit 7) and enable it. Scanned here rather than in pci.c so the
+// installer, which does not link the PCI layer, gets DMA too.
+static void ata_dma_probe(void) {
+    static int probed = 0;
+    if (probed) return;
+    probed = 1;
+
+    for (uint32_t bus = 0; bus < 256 && !bm_base; bus++) {
+        for (uint32_t slot = 0; slot < 32 && !bm_base; slot++) {
+            for (uint32_t func = 0; func < 8; func++) {
+                uint32_t id = pci_cfg_read(bus, slot, func, 0x00);
+                if ((id & 0xFFFF) == 0xFFFF) {
+                    if (func == 0) break;
+                    continue;
+                }
+                uint32_t cls = pci_cfg_read(bus, slot, func, 0x08);
+                if ((cls >> 16) == 0x0101 && (cls & 0x8000)) {
+                    uint32_t bar4 = pci_cfg_read(bus, slot, func, 0x20);
+                    if (!(bar4 & 1)) continue; // Must be I/O space
+                    uint32_t cmd = pci_cfg_read(bus, slot, func, 0x04);
+                    pci_cfg_write(bus, slot, func, 0x04, cmd | 0x05); // I/O + bus master
+                    bm_base = (uint16_t)(bar4 & 0xFFFC);
+                    break;
+                }
+                if (func == 0 && !(pci_cfg_read(bus, slot, 0, 0x0C) & 0x800000)) break;
+            }
+        }
+    }
+    if (!bm_base) return;
+
+    // Page-aligned, so the table never crosses a 64KB boundary
+    prd_table = (ata_prd_t*)kmalloc_a(sizeof(ata_prd_t) * ATA_PRD_MAX);
+    dma_bounce = (uint8_t*)kmalloc_a(ATA_MAX_SECTORS * 512);
+    if (!prd_table) bm_base = 0;
+}
+
+// Called from the IRQ 14/15 dispatch. Acknowledges the device so the line
+// drops and wakes the waiter in ata_dma_wait.
+void ata_irq_handler(int channel) {
+    if (!bm_base) return;
+    uint16_t bm = bm_base + (channel ? 8 : 0);
+    if (inb(bm + BM_STATUS) & BM_ST_IRQ) {
+        inb(channel ? 0x177 : ATA_STATUS);
+        if (channel == 0) dma_irq_seen = 1;
+    }
+}
+
+// Error/IRQ bits are write-1-to-clear; keep the drive-capable bits (5, 6)
+static void ata_bm_clear(void) {
+    uint8_t st = inb(bm_base + BM_STATUS);
+    outb(bm_base + BM_STATUS, (st & 0x60) | BM_ST_ERROR | BM_ST_IRQ);
+}
+
+// Fill the PRD table for a physically contiguous buffer
+static int ata_build_prdt(uint32_t addr, uint32_t bytes) {
+    int n = 0;
+    while (bytes > 0) {
+        if (n == ATA_PRD_MAX) return 0;
+        uint32_t chunk = 0x10000 - (addr & 0xFFFF);
+        if (chunk > bytes) chunk = bytes;
+        prd_table[n].addr = addr;
+        prd_table[n].bytes = (uint16_t)chunk; // 64KB encodes as 0
+        prd_table[n].flags = 0;
+        addr += chunk;
+        bytes -= chunk;
+        n++;
+    }
+    prd_table[n - 1].flags = ATA_PRD_EOT;
+    return n;
+}
+
+// Sleep until the controller raises its interrupt. With interrupts on we
+// halt between checks so the CPU idles for the whole transfer; the
+// installer runs with interrupts off, so there we poll the BM status.
+static int ata_dma_wait(void) {
+    uint32_t eflags;
+    asm volatile("pushf; pop %0" : "=r"(eflags));
+    int irqs_on = (eflags & 0x200) != 0;
+    uint32_t limit = irqs_on ? 500 : 1000000; // ~10s at 50Hz either way
+
+    while (limit--) {
+        if (irqs_on) {
+            asm volatile("cli");
+            if (dma_irq_seen || (inb(bm_base + BM_STATUS) & BM_ST_IRQ)) {
+                asm volatile("sti");
+                return 1;
+            }
+            asm volatile("sti; hlt"); // sti's shadow makes this race-free
+        } else {
+            if (inb(bm_base + BM_STATUS) & BM_ST_IRQ) return 1;
+            ata_delay();
+        }
+    }
+    return 0;
+}
+
+// One DMA command. Returns 0 on success; on any failure the caller falls
+// back to PIO for this request.
+static int ata_dma_transfer(int drive, uint32_t lba, uint32_t count, uint8_t* buffer, int write) {
+    uint32_t bytes = count * 512;
+    uint32_t addr = (uint32_t)buffer;
+    int bounce = (addr & 1) || addr + bytes > ATA_DMA_LIMIT;
+    if (bounce) {
+        if (!dma_bounce) return 1;
+        if (write) memcpy(dma_bounce, buffer, bytes);
+        addr = (uint32_t)dma_bounce;
+    }
+    if (!ata_build_prdt(addr, bytes)) return 1;
+    if (!ata_wait_bsy()) return 1;
+
+    outb(bm_base + BM_CMD, 0);
+    outl(bm_base + BM_PRDT, (uint32_t)prd_table);
+    ata_bm_clear();
+    outb(bm_base + BM_CMD, write ? 0 : BM_CMD_READ);
+    dma_irq_seen = 0;
+
+    int ext = ata_setup_transfer(drive, lba, count);
+    if (write) outb(ATA_CMD, ext ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA);
+    else outb(ATA_CMD, ext ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA);
+    outb(bm_base + BM_CMD, (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+
+    int ok = ata_dma_wait();
+    outb(bm_base + BM_CMD, 0);
+    uint8_t bm_st = inb(bm_base + BM_STATUS);
+    ata_bm_clear();
+    if (!ok || (bm_st & BM_ST_ERROR)) return 1;
+    if (!ata_wait_bsy() || (inb(ATA_STATUS) & 0x21)) return 1; // ERR / DF
+
+    if (bounce && !write) memcpy(buffer, dma_bounce, bytes);
+    return 0;
+}
+
+static int ata_use_dma(int drive) {
+    return bm_base && ide_devices[drive].dma;
+}
+
+static void ata_dma_failed(int drive) {
+    // Stay on PIO for this drive rather than failing every request twice
+    s_printf("[ATA] DMA error, falling back to PIO\n");
+    ide_devices[drive].dma = 0;
+}
+
+int ata_read_sectors(int drive, uint32_t lba, uint32_t count, uint8_t* buffer) {
+    if (drive > 1 || count == 0 || count > ATA_MAX_SECTORS) return 1;
+    if (ide_devices[drive].lba48 == 0 && lba + count > 0x10000000) return 1;
+    if (ata_use_dma(drive)) {
+        if (ata_dma_transfer(drive, lba, count, buffer, 0) == 0) return 0;
+        ata_dma_failed(drive);
+    }
     if(!ata_wait_bsy()) return 1; // Timeout
-    
-    outb(ATA_DRIVE, 0xE0 | ((drive&1)<<4) | ((lba >> 24) & 0x0F));
-    outb(ATA_SEC_CNT, 1);
-    outb(ATA_LBA_LO, (uint8_t)lba);
-    outb(ATA_LBA_MID, (uint8_t)(lba>>8));
-    outb(ATA_LBA_HI, (uint8_t)(lba>>16));
-    outb(ATA_CMD, 0x20); 
-    
-    if(!ata_wait_drq()) return 1;
-    
+
+    uint32_t per_drq = ide_devices[drive].multiple ? ide_devices[drive].multiple : 1;
+    int ext = ata_setup_transfer(drive, lba, count);
+    if (per_drq > 1) outb(ATA_CMD, ext ? ATA_CMD_READ_MULT_EXT : ATA_CMD_READ_MULT);
+    else outb(ATA_CMD, ext ? ATA_CMD_READ_PIO_EXT : ATA_CMD_READ_PIO);
+
+    // One DRQ block per `per_drq` sectors
     uint16_t* b = (uint16_t*)buffer;
-    for(int i=0; i<256; i++) b[i] = inw(ATA_DATA);
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t n = (count - done < per_drq) ? count - done : per_drq;
+        ata_delay();
+        if(!ata_wait_bsy() || !ata_wait_drq()) return 1;
+        for(uint32_t i=0; i<n*256; i++) *b++ = inw(ATA_DATA);
+        done += n;
+    }
     return 0;
 }
 
-int ata_write_sector(int drive, uint32_t lba, const uint8_t* buffer) {
-    if (drive > 1) return 1;
-    if(!ata_wait_bsy()) return 1;
-    
-    outb(ATA_DRIVE, 0xE0 | ((drive&1)<<4) | ((lba >> 24) & 0x0F));
-    outb(ATA_SEC_CNT, 1);
-    outb(ATA_LBA_LO, (uint8_t)lba);
-    outb(ATA_LBA_MID, (uint8_t)(lba>>8));
-    outb(ATA_LBA_HI, (uint8_t)(lba>>16));
-    outb(ATA_CMD, 0x30); 
-    
-    if(!ata_wait_drq()) return 1;
-    
-    uint16_t* b = (uint16_t*)buffer;
-    for(int i=0; i<256; i++) outw(ATA_DATA, b[i]);
-    
-    outb(ATA_CMD, 0xE7); // Cache Flush
+int ata_write_sectors(int drive, uint32_t lba, uint32_t count, const uint8_t* buffer) {
+    if (drive > 1 || count == 0 || count > ATA_MAX_SECTORS) return 1;
+    if (ide_devices[drive].lba48 == 0 && lba + count > 0x10000000) return 1;
+    int ext = ata_setup_ext(drive, lba, count);
+    if (ata_use_dma(drive)) {
+        if (ata_dma_transfer(drive, lba, count, (uint8_t*)buffer, 1) == 0) return ata_flush(ext);
+        ata_dma_failed(drive);
+    }
     if(!ata_wait_bsy()) return 1;
-    
-    return 0;
+
+    uint32_t per_drq = ide_devices[drive].multiple ? ide_devices[drive].multiple : 1;
+    ata_setup_transfer(drive, lba, count);
+    if (per_drq > 1) outb(ATA_CMD, ext ? ATA_CMD_WRITE_MULT_EXT : ATA_CMD_WRITE_MULT);
+    else outb(ATA_CMD, ext ? ATA_CMD_WRITE_PIO_EXT : ATA_CMD_WRITE_PIO);
+
+    const uint16_t* b = (const uint16_t*)buffer;
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t n = (count - done < per_drq) ? count - done : per_drq;
+        ata_delay();
+        if(!ata_wait_bsy() || !ata_wait_drq()) return 1;
+        for(uint32_t i=0; i<n*256; i++) outw(ATA_DATA, *b++);
+        done += n;
+    }
+
+    return ata_flush(ext);
+}
+
+int ata_read_sector(int drive, uint32_t lba, uint8_t* buffer) {
+    return ata_read_sectors(drive, lba, 1, buffer);
+}
+
+int ata_write_sector(int drive, uint32_t lba, const uint8_t* buffer) {
+    return ata_write_sectors(drive, lba, 1, buffer);
+}
+
+static int ata_blk_rw(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf, int write) {
+    int drive = (int)(uint32_t)dev->priv;
+    if (write) return ata_write_sectors(drive, lba, count, (const uint8_t*)buf);
+    return ata_read_sectors(drive, lba, count, (uint8_t*)buf);
+}
+
+static void ata_register_blkdev(int drive) {
+    blkdev_t* dev = &ata_blkdev[drive];
+    strcpy(dev->name, drive ? "ata1" : "ata0");
+    dev->total_blocks = ide_devices[drive].sectors;
+    dev->max_transfer = ATA_MAX_SECTORS;
+    dev->rw = ata_blk_rw;
+    dev->priv = (void*)(uint32_t)drive;
+    blkdev_register(dev);
 }
 
 void ata_swap_string(char* str, int len) {
@@ -87,12 +370,16 @@ void ata_swap_string(char* str, int len) {
 
 void ata_identify_device(int drive) {
     ide_devices[drive].present = 0;
+    ide_devices[drive].lba48 = 0;
+    ide_devices[drive].multiple = 0;
+    ide_devices[drive].dma = 0;
+    ata_dma_probe();
     outb(ATA_DRIVE, drive == 0 ? 0xA0 : 0xB0);
     outb(ATA_SEC_CNT, 0);
     outb(ATA_LBA_LO, 0);
     outb(ATA_LBA_MID, 0);
     outb(ATA_LBA_HI, 0);
-    outb(ATA_CMD, 0xEC);
+    outb(ATA_CMD, ATA_CMD_IDENTIFY);
     
     if (inb(ATA_STATUS) == 0) return;
     
@@ -113,6 +400,30 @@ void ata_identify_device(int drive) {
     
     ide_devices[drive].present = 1;
     ide_devices[drive].sectors = (uint32_t)data[60] | ((uint32_t)data[61] << 16);
+
+    // LBA48 (word 83 bit 10): capacity in words 100-103, clamped to 32 bits
+    ide_devices[drive].lba48 = (data[83] & 0x400) ? 1 : 0;
+    if (ide_devices[drive].lba48) {
+        uint32_t lba48_lo = (uint32_t)data[100] | ((uint32_t)data[101] << 16);
+        uint32_t lba48_hi = (uint32_t)data[102] | ((uint32_t)data[103] << 16);
+        ide_devices[drive].sectors = lba48_hi ? 0xFFFFFFFF : lba48_lo;
+    }
+
+    // Word 49 bit 8: DMA supported
+    ide_devices[drive].dma = (bm_base && (data[49] & 0x100)) ? 1 : 0;
+
+    // READ/WRITE MULTIPLE: word 47 low byte is the max sectors per DRQ block
+    ide_devices[drive].multiple = 0;
+    uint32_t max_mult = data[47] & 0xFF;
+    if (max_mult > 1) {
+        outb(ATA_DRIVE, 0xE0 | ((drive&1)<<4));
+        outb(ATA_SEC_CNT, (uint8_t)max_mult);
+        outb(ATA_CMD, ATA_CMD_SET_MULT);
+        ata_delay();
+        if (ata_wait_bsy() && !(inb(ATA_STATUS) & 0x01)) {
+            ide_devices[drive].multiple = max_mult;
+        }
+    }
     
     char* model = ide_devices[drive].model;
     for(int i=0; i<20; i++) {
@@ -122,4 +433,6 @@ void ata_identify_device(int drive) {
     }
     ata_swap_string(model, 40);
     model[40] = 0;
+
+    ata_register_blkdev(drive);
 }
\ No newline at end of file
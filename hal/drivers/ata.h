@@ -8,14 +8,27 @@ int ata_wait_busy(void);
 int ata_wait_drq(void);
 int ata_read_sector(int drive, uint32_t lba, uint8_t* buffer);
 int ata_write_sector(int drive, uint32_t lba, const uint8_t* data);
+
+// Multi-sector transfers (1..ATA_MAX_SECTORS per command).
+// Use READ/WRITE MULTIPLE when the drive accepted SET MULTIPLE MODE,
+// and the LBA48 command set when the drive supports it.
+#define ATA_MAX_SECTORS 256
+int ata_read_sectors(int drive, uint32_t lba, uint32_t count, uint8_t* buffer);
+int ata_write_sectors(int drive, uint32_t lba, uint32_t count, const uint8_t* data);
 void ata_io_wait(void);
 void ata_identify_device(int drive);
 
+// Bus master DMA completion (IRQ 14 = channel 0, IRQ 15 = channel 1)
+void ata_irq_handler(int channel);
+
 // Device information structure
 typedef struct {
     uint32_t sectors;
     char model[41];
     int present;
+    int lba48;             // Supports 48-bit LBA commands
+    uint32_t multiple;     // Sectors per DRQ block (0 = READ/WRITE MULTIPLE unavailable)
+    int dma;               // Transfers go through the PCI bus master
 } ide_device_t;
 
 // Device array (declared extern, defined in ata.c)
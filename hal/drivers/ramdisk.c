@@ -0,0 +1,33 @@
+// hal/drivers/ramdisk.c - Memory-backed block devices
+#include "ramdisk.h"
+#include "../../core/memory.h"
+#include "../../core/string.h"
+
+static blkdev_t ramdisks[RAMDISK_MAX];
+static int ramdisk_count = 0;
+
+static int ramdisk_rw(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf, int write) {
+    uint8_t* mem = (uint8_t*)dev->priv + lba * BLKDEV_BLOCK_SIZE;
+    if (write) memcpy(mem, buf, count * BLKDEV_BLOCK_SIZE);
+    else memcpy(buf, mem, count * BLKDEV_BLOCK_SIZE);
+    return 0;
+}
+
+blkdev_t* ramdisk_create(const char* name, uint32_t blocks) {
+    if (ramdisk_count >= RAMDISK_MAX || blocks == 0) return 0;
+    void* mem = kzalloc(blocks * BLKDEV_BLOCK_SIZE);
+    if (!mem) return 0;
+
+    blkdev_t* dev = &ramdisks[ramdisk_count];
+    strncpy(dev->name, name, sizeof(dev->name) - 1);
+    dev->total_blocks = blocks;
+    dev->max_transfer = blocks; // No command overhead to amortize
+    dev->rw = ramdisk_rw;
+    dev->priv = mem;
+    if (blkdev_register(dev) != 0) {
+        kfree(mem);
+        return 0;
+    }
+    ramdisk_count++;
+    return dev;
+}
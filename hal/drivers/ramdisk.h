@@ -0,0 +1,13 @@
+// hal/drivers/ramdisk.h - Memory-backed block devices
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+#include "../../fs/blkdev.h"
+
+#define RAMDISK_MAX 4
+
+// Allocate `blocks` 512-byte blocks from the kernel heap and register them
+// as block device `name` (e.g. "ram0"). Returns 0 if out of memory.
+blkdev_t* ramdisk_create(const char* name, uint32_t blocks);
+
+#endif
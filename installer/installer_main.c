@@ -15,6 +15,7 @@
 extern uint8_t system_bin_start[], system_bin_end[];
 extern uint8_t mbr_bin_start[];
 extern uint32_t _bss_end;
+extern void rtc_read_time(int* h, int* m, int* s);
 
 // Apps & Libs (Standard payload externs)
 extern uint8_t app_terminal_start[], app_terminal_end[];
@@ -112,6 +113,8 @@ int install_error = 0;
 char install_error_msg[128] = "";
 int install_animation_frame = 0;
 uint32_t last_animation_tick = 0;
+uint32_t install_raw_sectors = 0; // MBR and kernel, written around PFS32
+int install_start_sec = -1;       // RTC time the install began
 
 // Mouse State
 extern int mouse_x, mouse_y, mouse_btn_left;
@@ -420,6 +423,26 @@ void action_format_partition(uint8_t fs_type) {
     modal_active = 0;
 }
 
+// Migrate an existing PFS32 partition to v3 without touching its files
+void action_upgrade_partition() {
+    int drv = util_drive_idx;
+    modal_active = 0;
+    if (util_part_idx < 0) return;
+
+    mbr_entry_t* part = &disk_mbr[drv].partitions[util_part_idx];
+    if (part->type != 0x7F) return;
+
+    disk_set_drive(drv);
+    if (pfs32_mount(part->lba_start, part->lba_length, 0) != PFS_OK) {
+        add_log("ERROR: No PFS32 volume to upgrade");
+        return;
+    }
+    int res = pfs32_upgrade(PFS32_CLUSTER_DEFAULT);
+    if (res == PFS_OK) add_log("PFS32 upgraded to v3 (16 KB clusters)");
+    else if (res == PFS_ERR_EXISTS) add_log("PFS32 is already v3");
+    else add_log("ERROR: PFS32 upgrade failed");
+}
+
 void action_create_schema() {
     int drv = util_drive_idx;
     disk_set_drive(drv);
@@ -1050,6 +1073,11 @@ void render_disk_utility() {
                     modal_active = 1;
                     modal_callback = 0; // We'll handle formatting directly in modal
                 }
+
+                if (disk_mbr[util_drive_idx].partitions[util_part_idx].type == 0x7F &&
+                    ui_button(mx_off + 370, ctrl_y + 40, 100, 45, "Upgrade", C_ACCENT)) {
+                    show_modal("Upgrade to PFS32 v3", "Files are kept; large ones move to extents when rewritten.", "Upgrade", action_upgrade_partition);
+                }
             }
             if (ui_button(mx_off + 480, ctrl_y + 40, 170, 45, "Wipe Disk", C_DANGER)) {
                 show_modal("Erase Entire Disk", "All data and partitions will be lost.", "Erase", action_erase_disk);
@@ -1182,19 +1210,14 @@ void render_select_disk() {
 
 // --- Installation Logic ---
 
+// pfs32_write_file creates the file and lays it out in one pass: extents
+// sized to the whole payload, streamed with multi-sector writes
 int install_file(const char* path, uint8_t* start, uint8_t* end) {
     uint32_t size = (uint32_t)(end - start);
     char log_buf[128];
-    snprintf(log_buf, sizeof(log_buf), "Installing %s (%u bytes)", path, size);
+    snprintf(log_buf, sizeof(log_buf), "Installing %s (%d bytes)", path, (int)size);
     add_log(log_buf);
     
-    int create_res = pfs32_create_file(path);
-    if (create_res != 0 && create_res != -5) { // -5 is PFS_ERR_EXISTS
-        snprintf(log_buf, sizeof(log_buf), "ERROR: Failed to create %s: %d", path, create_res);
-        add_log(log_buf);
-        return -1;
-    }
-    
     int write_res = pfs32_write_file(path, start, size);
     if (write_res < 0) {
         snprintf(log_buf, sizeof(log_buf), "ERROR: Failed to write %s: %d", path, write_res);
@@ -1205,6 +1228,38 @@ int install_file(const char* path, uint8_t* start, uint8_t* end) {
     return 0;
 }
 
+// --- Throughput ---
+
+// Seconds since midnight; the RTC is the only clock the installer has
+static int install_clock() {
+    int h, m, sec;
+    rtc_read_time(&h, &m, &sec);
+    return h * 3600 + m * 60 + sec;
+}
+
+static int install_elapsed() {
+    if (install_start_sec < 0) return 0;
+    int t = install_clock() - install_start_sec;
+    return (t < 0) ? t + 86400 : t;
+}
+
+// Everything written to the target so far, in sectors
+static uint32_t install_sectors_written() {
+    uint32_t n = install_raw_sectors;
+    pfs32_stats_t st;
+    if (install_step >= 2 && pfs32_get_stats(&st) == PFS_OK) n += st.disk_writes;
+    return n;
+}
+
+// "12.5 MB/s" averaged since the install began; empty for the first second
+static void install_rate_str(char* out, int len) {
+    int secs = install_elapsed();
+    out[0] = 0;
+    if (secs < 1) return;
+    uint32_t rate10 = (install_sectors_written() / 2) * 10 / 1024 / secs;
+    snprintf(out, len, "%d.%d MB/s", (int)(rate10 / 10), (int)(rate10 % 10));
+}
+
 // File installation list
 typedef struct {
     const char* path;
@@ -1256,6 +1311,8 @@ void install_tick() {
     }
 
     if (install_step == 0) {
+        install_start_sec = install_clock();
+        install_raw_sectors = 0;
         strcpy(install_status, "Writing Bootloader & Tables...");
         add_log("Writing bootloader and partition tables");
         
@@ -1288,6 +1345,7 @@ void install_tick() {
             add_log("ERROR: Failed to write MBR");
             return;
         }
+        install_raw_sectors += 2;
         
         install_pct = 5;
         install_step++;
@@ -1302,22 +1360,32 @@ void install_tick() {
         uint32_t k_size = system_bin_end - system_bin_start;
         uint32_t k_sectors = (k_size + 511) / 512;
         
-        // Write only 16 sectors per tick to prevent freezing
-        int sectors_this_tick = 0;
-        while (kernel_write_offset < k_sectors && sectors_this_tick < 16) {
+        // One full-size ATA command per tick keeps the screen responsive;
+        // whole sectors go straight from the payload, the tail is padded
+        uint32_t full = k_size / 512;
+        if (kernel_write_offset < full) {
+            uint32_t n = full - kernel_write_offset;
+            if (n > ATA_MAX_SECTORS) n = ATA_MAX_SECTORS;
+            if (ata_write_sectors(selected_drive_idx, 1 + kernel_write_offset, n,
+                                  system_bin_start + kernel_write_offset * 512) < 0) {
+                strcpy(install_error_msg, "Failed to write kernel sector");
+                install_error = 1;
+                add_log("ERROR: Failed to write kernel sector");
+                return;
+            }
+            kernel_write_offset += n;
+            install_raw_sectors += n;
+        } else if (kernel_write_offset < k_sectors) {
             uint8_t buf[512]; memset(buf, 0, 512);
-            uint32_t rem = k_size - (kernel_write_offset * 512);
-            memcpy(buf, system_bin_start + (kernel_write_offset * 512), (rem > 512) ? 512 : rem);
-            
+            memcpy(buf, system_bin_start + full * 512, k_size - full * 512);
             if (ata_write_sector(selected_drive_idx, 1 + kernel_write_offset, buf) < 0) {
                 strcpy(install_error_msg, "Failed to write kernel sector");
                 install_error = 1;
                 add_log("ERROR: Failed to write kernel sector");
                 return;
             }
-            
             kernel_write_offset++;
-            sectors_this_tick++;
+            install_raw_sectors++;
         }
         
         // Update progress
@@ -1352,7 +1420,7 @@ void install_tick() {
         
         install_pct = 45;
         install_step++;
-        add_log("PFS32 formatting complete");
+        add_log("PFS32 v3 formatting complete (16 KB clusters)");
         return;
     }
     
@@ -1411,6 +1479,12 @@ void install_tick() {
         pfs32_sync();
         install_pct = 100;
         current_state = STATE_SUCCESS;
+
+        char rate[24], log_buf[96];
+        install_rate_str(rate, sizeof(rate));
+        snprintf(log_buf, sizeof(log_buf), "Wrote %d KB in %d s %s",
+                 (int)(install_sectors_written() / 2), install_elapsed(), rate);
+        add_log(log_buf);
         add_log("Installation complete!");
     }
 }
@@ -1473,6 +1547,14 @@ void render_installing() {
     strcat(step_str, num);
     strcat(step_str, " of 5");
     gfx_draw_string(CX + 100, status_y, step_str, C_TEXT_MUTED);
+
+    // Measured write speed
+    char rate[24];
+    install_rate_str(rate, sizeof(rate));
+    if (rate[0]) {
+        gfx_draw_string(CX - 200, status_y + 24, "Speed:", C_TEXT_MUTED);
+        gfx_draw_string(CX - 140, status_y + 24, rate, C_TEXT_DARK);
+    }
     
     // Animated dots at bottom
     int dots_y = WIN_H - 60;
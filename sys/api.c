@@ -2,6 +2,10 @@
 #include "../hal/video/gfx_hal.h"
 #include "../hal/drivers/vga.h"
 #include "../hal/drivers/ata.h"
+#include "../hal/drivers/ahci.h"
+#include "../fs/disk.h"
+#include "../fs/tmpfs.h"
+#include "../core/fswatch.h"
 #include "../core/string.h"
 #include "../hal/drivers/keyboard.h"
 #include "../common/font.h"
@@ -40,7 +44,23 @@ static volatile uint32_t g_fs_generation = 0;
 void sys_notify_fs_change() { g_fs_generation++; }
 uint32_t sys_get_fs_generation() { return g_fs_generation; }
 
+static int fs_stat(const char* path, pfs32_direntry_t* entry);
+
+// After a change to `path`: bump the generation and tell watchers of its
+// directory. The entry is only looked up if someone will see it.
+static void fs_event(uint32_t mask, const char* path, uint32_t cookie) {
+    sys_notify_fs_change();
+#ifdef KERNEL_MODE
+    if (!fswatch_watched(path)) return;
+    pfs32_direntry_t entry;
+    int gone = mask & (FS_EVENT_DELETE | FS_EVENT_RENAME_FROM);
+    fswatch_post(mask, path, (!gone && fs_stat(path, &entry) == 0) ? &entry : 0, cookie);
+#endif
+}
+void sys_notify_fs_event(uint32_t mask, const char* path) { fs_event(mask, path, 0); }
+
 void sys_shutdown() {
+    pfs32_sync();
     sys_print("\nShutting down in 3s...");
     sys_delay(3000);
     outw(0x604, 0x2000);
@@ -49,6 +69,7 @@ void sys_shutdown() {
 }
 
 void sys_reboot() {
+    pfs32_sync();
     uint8_t good = 0x02;
     while (good & 0x02) good = inb(0x64);
     outb(0x64, 0xFE);
@@ -104,42 +125,107 @@ int sys_clipboard_get(char* buf, int max_len) {
 // ... Filesystem and Graphics functions remain mostly the same ...
 // Including stubs to keep file complete for compilation context
 
+// RAM-backed mounts made at boot
+static const struct { const char* path; uint32_t max_bytes; } tmpfs_mounts[] = {
+    { "/tmp", TMPFS_DEFAULT_LIMIT },
+};
+
 int sys_fs_mount() {
-    ata_identify_device(0);
-    if (!ide_devices[0].present) return -1;
-    return pfs32_init(16384, ide_devices[0].sectors - 16384);
+    // Prefer a SATA disk on AHCI; fall back to the primary IDE master
+    ahci_init_all();
+    blkdev_t* dev = blkdev_get("sata0");
+    if (!dev) {
+        ata_identify_device(0);
+        if (!ide_devices[0].present) return -1;
+        dev = blkdev_get("ata0");
+    }
+    disk_set_device(dev);
+    if (disk_total_blocks <= 16384) return -1;
+    uint32_t opts = PFS32_MOUNT_FAT_RESIDENT | PFS32_MOUNT_WRITEBACK |
+                    PFS32_MOUNT_RELATIME | PFS32_MOUNT_LAZYTIME;
+    int res = pfs32_mount(16384, disk_total_blocks - 16384, opts);
+    if (res != 0) return res;
+
+    // Scratch space never touches the disk
+    for (int i = 0; i < (int)(sizeof(tmpfs_mounts) / sizeof(tmpfs_mounts[0])); i++) {
+        sys_fs_mount_tmpfs(tmpfs_mounts[i].path, tmpfs_mounts[i].max_bytes);
+    }
+    return 0;
+}
+
+// The directory stays on PFS32 so it shows up in listings; while mounted,
+// everything below it lives in RAM
+int sys_fs_mount_tmpfs(const char* path, uint32_t max_bytes) {
+    if (!tmpfs_owns(path)) {
+        int res = pfs32_create_directory(path);
+        if (res != 0 && res != PFS_ERR_EXISTS) return res;
+    }
+    return tmpfs_mount(path, max_bytes);
 }
 
 int sys_fs_write(const char* filename, char* data, int size) {
-    int res = pfs32_write_file(filename, (uint8_t*)data, size);
-    if(res >= 0) sys_notify_fs_change();
+    int existed = fs_stat(filename, 0) == 0;
+    int res = tmpfs_owns(filename) ? tmpfs_write_file(filename, (uint8_t*)data, size)
+                                   : pfs32_write_file(filename, (uint8_t*)data, size);
+    if(res >= 0) fs_event(existed ? FS_EVENT_MODIFY : FS_EVENT_CREATE, filename, 0);
     return res;
 }
 int sys_fs_read(const char* filename, char* buffer, int max_len) {
+    if (tmpfs_owns(filename)) return tmpfs_read_file(filename, (uint8_t*)buffer, max_len);
     return pfs32_read_file(filename, (uint8_t*)buffer, max_len);
 }
 int sys_fs_create(const char* full_path, int is_dir) {
-    int res = (is_dir) ? pfs32_create_directory(full_path) : pfs32_create_file(full_path);
-    if (res == 0) sys_notify_fs_change();
+    int res;
+    if (tmpfs_owns(full_path)) res = tmpfs_create(full_path, is_dir);
+    else res = (is_dir) ? pfs32_create_directory(full_path) : pfs32_create_file(full_path);
+    if (res == 0) fs_event(FS_EVENT_CREATE, full_path, 0);
     return res;
 }
 int sys_fs_delete(const char* full_path) {
-    int res = pfs32_delete(full_path);
-    if (res == 0) sys_notify_fs_change();
+    int res = tmpfs_owns(full_path) ? tmpfs_delete(full_path) : pfs32_delete(full_path);
+    if (res == 0) fs_event(FS_EVENT_DELETE, full_path, 0);
     return res;
 }
-int sys_fs_exists(const char* full_path) { return pfs32_stat(full_path, 0) == 0; }
+static int fs_stat(const char* path, pfs32_direntry_t* entry) {
+    return tmpfs_owns(path) ? tmpfs_stat(path, entry) : pfs32_stat(path, entry);
+}
+int sys_fs_exists(const char* full_path) { return fs_stat(full_path, 0) == 0; }
 int sys_fs_is_dir(const char* full_path) {
     pfs32_direntry_t entry;
-    if(pfs32_stat(full_path, &entry) != 0) return -1;
+    if(fs_stat(full_path, &entry) != 0) return -1;
     return (entry.attributes & PFS32_ATTR_DIRECTORY) ? 1 : 0;
 }
 int sys_fs_rename(const char* o, const char* n) {
-    int res = pfs32_rename(o, n);
-    if(res == 0) sys_notify_fs_change();
+    int in_tmp = tmpfs_owns(o);
+    if (in_tmp != tmpfs_owns(n)) return PFS_ERR_PARAM; // Copy and delete instead
+    int res = in_tmp ? tmpfs_rename(o, n) : pfs32_rename(o, n);
+    if(res == 0) {
+#ifdef KERNEL_MODE
+        uint32_t cookie = fswatch_cookie();
+#else
+        uint32_t cookie = 0;
+#endif
+        fs_event(FS_EVENT_RENAME_FROM, o, cookie);
+        fs_event(FS_EVENT_RENAME_TO, n, cookie);
+    }
     return res;
 }
-void sys_fs_copy(const char* s, const char* d) { pfs32_copy(s, d); }
+// Extent-mapped files are shared until one side is written; anything
+// involving a tmpfs goes through a buffer
+void sys_fs_copy(const char* s, const char* d) {
+    if (!tmpfs_owns(s) && !tmpfs_owns(d)) {
+        int existed = fs_stat(d, 0) == 0;
+        if (pfs32_reflink(s, d) == PFS_OK) fs_event(existed ? FS_EVENT_MODIFY : FS_EVENT_CREATE, d, 0);
+        return;
+    }
+    pfs32_direntry_t entry;
+    if (fs_stat(s, &entry) != 0 || (entry.attributes & PFS32_ATTR_DIRECTORY)) return;
+    char* buf = (char*)kmalloc(entry.file_size ? entry.file_size : 1);
+    if (!buf) return;
+    int len = sys_fs_read(s, buf, entry.file_size);
+    if (len >= 0) sys_fs_write(d, buf, len);
+    kfree(buf);
+}
 
 // GFX Wrappers
 void sys_gfx_init() { gfx_init_hal(0); }
@@ -197,38 +283,57 @@ int sys_net_ping(const char* ip, char* buf, int len) { return -1; }
 
 int sys_fs_ls(const char* path) { return -1; }
 int sys_fs_list_dir(const char* path, void* buf, int max) {
+    if (tmpfs_owns(path)) return tmpfs_listdir(path, (pfs32_direntry_t*)buf, max);
     uint32_t blk=0; if(get_dir_block(path, &blk)!=0) return -1;
     return pfs32_listdir(blk, (pfs32_direntry_t*)buf, max);
 }
+int sys_fs_readdir(const char* path, void* buf, int max, uint32_t* cursor) {
+    if (max < 0) return PFS_ERR_PARAM;
+    if (tmpfs_owns(path)) return tmpfs_readdir(path, (pfs32_dirent_plus_t*)buf, max, cursor);
+    return pfs32_readdir(path, (pfs32_dirent_plus_t*)buf, max, cursor);
+}
+int sys_fs_set_compressed(const char* path, int on) {
+    if (tmpfs_owns(path)) return PFS_ERR_PARAM;
+    int res = pfs32_set_compressed(path, on);
+    if (res == PFS_OK) fs_event(FS_EVENT_MODIFY, path, 0);
+    return res;
+}
+int sys_fs_search(const char* pattern, void* buf, int max, uint32_t* cursor) {
+    if (max < 0) return PFS_ERR_PARAM;
+    return pfs32_search(pattern, (pfs32_match_t*)buf, max, cursor);
+}
 void sys_fs_copy_recursive(const char* s, const char* d) { sys_fs_copy(s, d); }
 void sys_fs_generate_unique_name(const char* p, const char* b, int d, char* o) {}
 
 // Implement recursive deletion
+// Each pass pages through the whole directory, stepping past entries
+// that could not be removed. Deletions can reorganise the directory
+// under the cursor, so passes repeat until one removes nothing.
 int sys_fs_delete_recursive(const char* path) {
-    // Check if the path is a directory
-    if (sys_fs_is_dir(path) == 1) {
-        // List directory contents
-        pfs32_direntry_t entries[32];
-        int count = sys_fs_list_dir(path, entries, 32);
-        if (count < 0) return -1;
-        
-        // Recursively delete each entry
-        for (int i = 0; i < count; i++) {
-            if (entries[i].filename[0] == 0) continue;
-            
-            char full_path[256];
-            strcpy(full_path, path);
-            strcat(full_path, "/");
-            strcat(full_path, entries[i].filename);
-            
-            if (entries[i].attributes & PFS32_ATTR_DIRECTORY) {
-                sys_fs_delete_recursive(full_path);
-            } else {
-                sys_fs_delete(full_path);
+    pfs32_direntry_t self;
+    if (fs_stat(path, &self) == 0 && (self.attributes & PFS32_ATTR_DIRECTORY)) {
+        pfs32_dirent_plus_t entries[16];
+        int removed = 1;
+        while (removed) {
+            uint32_t cursor = 0;
+            removed = 0;
+            while (cursor != PFS32_READDIR_END) {
+                int count = sys_fs_readdir(path, entries, 16, &cursor);
+                if (count < 0) return -1;
+                for (int i = 0; i < count; i++) {
+                    char full_path[256];
+                    strcpy(full_path, path);
+                    strcat(full_path, "/");
+                    strcat(full_path, entries[i].entry.filename);
+
+                    int res = (entries[i].entry.attributes & PFS32_ATTR_DIRECTORY) ? sys_fs_delete_recursive(full_path)
+                                                                                   : sys_fs_delete(full_path);
+                    if (res == 0) removed++;
+                }
             }
         }
     }
-    
+
     // Delete the directory or file itself
     return sys_fs_delete(path);
 }
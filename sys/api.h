@@ -16,6 +16,7 @@ void sys_get_time(int* h, int* m, int* s);
 // --- Notification ---
 uint32_t sys_get_fs_generation();
 void sys_notify_fs_change();
+void sys_notify_fs_event(uint32_t mask, const char* path); // FS_EVENT_* for a change made outside sys_fs_*
 
 // --- Helpers ---
 int sys_fs_delete_recursive(const char* path);
@@ -33,8 +34,10 @@ void sys_kbd_state(int* ctrl, int* shift, int* alt); // Updated to include Alt
 
 // --- Storage API ---
 int sys_fs_mount();
+int sys_fs_mount_tmpfs(const char* path, uint32_t max_bytes); // RAM-backed, below `path`
 int sys_fs_ls(const char* path);
 int sys_fs_list_dir(const char* path, void* buffer, int max_len);
+int sys_fs_readdir(const char* path, void* buffer, int max, uint32_t* cursor); // pfs32_dirent_plus_t pages
 int sys_fs_write(const char* full_path, char* data, int size);
 int sys_fs_read(const char* full_path, char* buffer, int max_len);
 int sys_fs_create(const char* full_path, int is_dir);
@@ -43,6 +46,8 @@ int sys_fs_exists(const char* full_path);
 int sys_fs_is_dir(const char* full_path);
 int sys_fs_rename(const char* old_path, const char* new_path);
 void sys_fs_copy(const char* src, const char* dest);
+int sys_fs_set_compressed(const char* full_path, int on); // PFS32 only; data stored LZ4 compressed
+int sys_fs_search(const char* pattern, void* buffer, int max, uint32_t* cursor); // pfs32_match_t pages, PFS32 only
 
 // --- User/Clipboard ---
 int sys_get_uid();
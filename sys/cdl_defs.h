@@ -10,6 +10,7 @@ typedef void (*paint_cb_t)(int x, int y, int w, int h);
 typedef void (*input_cb_t)(int key);
 typedef void (*mouse_cb_t)(int x, int y, int btn);
 typedef void (*menu_cb_t)(int menu_idx, int item_idx);
+typedef void (*close_cb_t)(void);
 
 #define MAX_MENU_ITEMS 5
 #define MAX_MENUS 4
@@ -20,6 +21,91 @@ typedef struct {
     int item_count;
 } menu_def_t;
 
+// --- ASYNC FILE I/O RINGS ---
+// The app fills SQEs at sq_tail and bumps it, then calls aio_submit.
+// The kernel works through requests in the background (a slice per GUI
+// frame) and posts results at cq_tail; the app consumes from cq_head.
+#define AIO_OP_READ   1   // Read len bytes at offset into buf; result = bytes read
+#define AIO_OP_WRITE  2   // Write len bytes from buf at offset; offset 0 replaces the file
+#define AIO_OP_STAT   3   // Fill buf with the 64-byte directory entry
+#define AIO_OP_LIST   4   // List directory into buf, len = max entries
+
+typedef struct {
+    uint32_t op;
+    uint32_t user_data;   // Returned untouched in the CQE
+    const char* path;     // Copied at submit time
+    void* buf;            // Must stay valid until the CQE arrives
+    uint32_t len;
+    uint32_t offset;
+} aio_sqe_t;
+
+typedef struct {
+    uint32_t user_data;
+    int result;           // >= 0 on success, PFS error code otherwise
+} aio_cqe_t;
+
+typedef struct {
+    uint32_t entries;             // Power of two
+    volatile uint32_t sq_head;    // Kernel consumes
+    volatile uint32_t sq_tail;    // App produces
+    volatile uint32_t cq_head;    // App consumes
+    volatile uint32_t cq_tail;    // Kernel produces
+    aio_sqe_t* sqes;
+    aio_cqe_t* cqes;
+} aio_ring_t;
+
+// --- MEMORY-MAPPED FILES ---
+// fs_mmap reserves address space for a file; pages are read in from the
+// block cache the first time they are touched. With MMAP_WRITE, modified
+// pages go back to the file on fs_msync and fs_munmap.
+#define MMAP_READ     1
+#define MMAP_WRITE    2   // Shared: stores reach the file
+
+// --- FILE-CHANGE WATCHES ---
+// fs_watch_add records changes to the entries directly inside one
+// directory; fs_watch_read drains them. Each event carries the entry as
+// it now is, so a view patches that one row instead of listing the
+// directory again. If the queue fills up, what is in it is dropped and
+// the next read returns a single FS_EVENT_OVERFLOW: list again.
+#define FS_EVENT_CREATE      0x01
+#define FS_EVENT_DELETE      0x02
+#define FS_EVENT_MODIFY      0x04
+#define FS_EVENT_RENAME_FROM 0x08   // Old name; the entry has gone
+#define FS_EVENT_RENAME_TO   0x10   // New name, same cookie as its RENAME_FROM
+#define FS_EVENT_OVERFLOW    0x80
+
+typedef struct {
+    uint32_t mask;                  // One FS_EVENT_* bit
+    uint32_t cookie;                // Pairs the two halves of a rename
+    unsigned char entry[64];        // 64-byte directory entry; only the name is set for DELETE and RENAME_FROM
+} fs_event_t;
+
+// --- DIRECTORY LISTING WITH ATTRIBUTES ---
+// fs_readdir returns a page of a directory's entries ("." and ".." left
+// out) with everything a view shows, from one path walk. Start with
+// *cursor = 0 and call again until it reads FS_READDIR_END.
+#define FS_READDIR_END 0xFFFFFFFF
+
+typedef struct {
+    unsigned char entry[64];        // 64-byte directory entry: name, size, attributes, owner, times, first block
+    uint32_t entry_block;           // Directory block the entry is stored in (0 on tmpfs)
+    uint32_t entry_slot;
+} fs_dirent_t;
+
+// --- FILENAME SEARCH ---
+// fs_search pages through every file and directory on the disk whose
+// name contains `pattern`, ignoring case. It reads the volume's filename
+// index, which is kept in memory, rather than the directories; only the
+// first search on a volume without an index walks the tree to build
+// one. Start with *cursor = 0 and call again until it reads
+// FS_SEARCH_END. A page can come back empty before the end.
+#define FS_SEARCH_END 0xFFFFFFFF
+
+typedef struct {
+    char path[256];                 // Absolute
+    uint32_t attributes;            // 0x10 for a directory
+} fs_match_t;
+
 // --- STABLE KERNEL API TABLE ---
 // Do not change the order of fields without recompiling ALL apps!
 typedef struct {
@@ -90,6 +176,39 @@ typedef struct {
     // 7. Event Processing (for async operations)
     void (*process_events)(void);  // Process window events during long operations
 
+    // 8. Async File I/O
+    aio_ring_t* (*aio_create)(uint32_t entries);
+    void (*aio_destroy)(aio_ring_t* ring);
+    int (*aio_submit)(aio_ring_t* ring);   // Returns number of SQEs accepted
+
+    // 9. Memory-Mapped Files
+    // offset must be page aligned; *len in = bytes wanted (0 = to end of
+    // file), out = bytes mapped. Returns 0 on failure.
+    void* (*fs_mmap)(const char* path, uint32_t offset, uint32_t* len, int flags);
+    int (*fs_msync)(void* addr, uint32_t len);  // len 0 = whole mapping
+    int (*fs_munmap)(void* addr);
+
+    // 10. File-Change Watches
+    int (*fs_watch_add)(const char* dir);                 // Watch descriptor, or < 0
+    int (*fs_watch_read)(int wd, fs_event_t* out, int max); // Events returned, 0 if none
+    void (*fs_watch_remove)(int wd);
+
+    // 11. Directory Listing
+    int (*fs_readdir)(const char* dir, fs_dirent_t* out, int max, uint32_t* cursor); // Count, or < 0
+
+    // 12. Compressed Files
+    // Stores the file LZ4 compressed (on = 1) or plain; reads are
+    // unchanged. Writing into it in place stores it plain again.
+    int (*fs_set_compressed)(const char* path, int on);
+
+    // 13. Filename Search
+    int (*fs_search)(const char* pattern, fs_match_t* out, int max, uint32_t* cursor); // Count, or < 0
+
+    // 14. Window Close
+    // cb runs once as the window goes away, before its slot is reused;
+    // release watches, rings and mappings there.
+    void (*set_window_close)(win_handle_t win, close_cb_t cb);
+
 } kernel_api_t;
 
 typedef struct { char name[32]; void* func_ptr; } cdl_symbol_t;
@@ -0,0 +1,134 @@
+// tools/mkpfs32.c - Build a bootable disk image with a populated PFS32 partition
+//
+// Does on the host what the installer does on first boot: MBR with the
+// Camel partition, raw kernel in sectors 1..16383, PFS32 formatted at
+// LBA 16384 and the standard directories, then any files or directory
+// trees given as dest=source.
+#include "pfs32_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Same layout as the installer's mbr_sector_t
+typedef struct {
+    uint8_t status;
+    uint8_t chs_start[3];
+    uint8_t type;
+    uint8_t chs_end[3];
+    uint32_t lba_start;
+    uint32_t lba_length;
+} __attribute__((packed)) mbr_entry_t;
+
+typedef struct {
+    uint8_t bootstrap[446];
+    mbr_entry_t partitions[4];
+    uint16_t signature;
+} __attribute__((packed)) mbr_sector_t;
+
+static const char* std_dirs[] = { "/home", "/home/desktop", "/usr", "/usr/lib", "/usr/apps", 0 };
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [-s size_mb] [-c cluster_bytes] [-L label] [-b mbr.bin] [-k system.bin] [-v]\n"
+        "          disk.img [/dest/path=host_path ...]\n"
+        "  -s  Image size in MB (default 256)\n"
+        "  -c  Cluster size in bytes; 0 formats a v2 (FAT chain only) volume\n"
+        "  -b  Boot sector to install with the partition table\n"
+        "  -k  Kernel image written raw from sector 1\n", prog);
+}
+
+static long file_size(FILE* f) {
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    return size;
+}
+
+static int write_boot(const char* mbr_path, const char* kernel_path) {
+    uint8_t* disk = host_disk_data();
+    uint32_t total = host_disk_blocks();
+
+    mbr_sector_t mbr;
+    memset(&mbr, 0, sizeof(mbr));
+    if (mbr_path) {
+        FILE* f = fopen(mbr_path, "rb");
+        if (!f) { perror(mbr_path); return -1; }
+        size_t n = fread(&mbr, 1, sizeof(mbr), f);
+        fclose(f);
+        if (n != sizeof(mbr)) { fprintf(stderr, "%s: must be 512 bytes\n", mbr_path); return -1; }
+    }
+    memset(mbr.partitions, 0, sizeof(mbr.partitions));
+    mbr.partitions[0].status = 0x80;
+    mbr.partitions[0].type = 0x7F; // Camel
+    mbr.partitions[0].lba_start = HOST_PART_START;
+    mbr.partitions[0].lba_length = total - HOST_PART_START;
+    mbr.signature = 0xAA55;
+    memcpy(disk, &mbr, sizeof(mbr));
+
+    if (!kernel_path) return 0;
+    FILE* f = fopen(kernel_path, "rb");
+    if (!f) { perror(kernel_path); return -1; }
+    long size = file_size(f);
+    if (size < 0 || size > (long)(HOST_PART_START - 1) * 512) {
+        fprintf(stderr, "%s: does not fit before the partition\n", kernel_path);
+        fclose(f);
+        return -1;
+    }
+    size_t n = fread(disk + 512, 1, size, f);
+    fclose(f);
+    return n == (size_t)size ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    uint32_t size_mb = 256;
+    uint32_t cluster = PFS32_CLUSTER_DEFAULT;
+    const char* label = "Camel Sys";
+    const char* mbr_path = 0;
+    const char* kernel_path = 0;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        const char* opt = argv[i];
+        if (!strcmp(opt, "-v")) { host_verbose = 1; continue; }
+        if (i + 1 >= argc) { usage(argv[0]); return 2; }
+        const char* val = argv[++i];
+        if (!strcmp(opt, "-s")) size_mb = (uint32_t)strtoul(val, 0, 0);
+        else if (!strcmp(opt, "-c")) cluster = (uint32_t)strtoul(val, 0, 0);
+        else if (!strcmp(opt, "-L")) label = val;
+        else if (!strcmp(opt, "-b")) mbr_path = val;
+        else if (!strcmp(opt, "-k")) kernel_path = val;
+        else { usage(argv[0]); return 2; }
+    }
+    if (i >= argc) { usage(argv[0]); return 2; }
+    const char* out = argv[i++];
+
+    uint32_t total = size_mb * 2048;
+    if (size_mb == 0 || size_mb > 2047 || total <= HOST_PART_START + 4096) {
+        fprintf(stderr, "mkpfs32: image size must be 16..2047 MB\n");
+        return 1;
+    }
+    if (host_disk_create(total) != 0) { fprintf(stderr, "mkpfs32: out of memory\n"); return 1; }
+    if (write_boot(mbr_path, kernel_path) != 0) return 1;
+
+    uint32_t part_size = total - HOST_PART_START;
+    pfs32_init(HOST_PART_START, part_size); // Sets the partition; nothing to mount yet
+    if (pfs32_format_cluster(label, part_size, cluster) != PFS_OK) {
+        fprintf(stderr, "mkpfs32: format failed (cluster size %u)\n", cluster);
+        return 1;
+    }
+    if (host_mount(HOST_MOUNT_OPTS) != PFS_OK) { fprintf(stderr, "mkpfs32: mount failed\n"); return 1; }
+    for (int d = 0; std_dirs[d]; d++) host_mkdirs(std_dirs[d]);
+
+    int failed = 0;
+    for (; i < argc; i++) {
+        char* eq = strchr(argv[i], '=');
+        if (!eq || argv[i][0] != '/') { fprintf(stderr, "mkpfs32: expected /dest=source, got %s\n", argv[i]); failed = 1; continue; }
+        *eq = 0;
+        if (host_put(argv[i], eq + 1) != PFS_OK) failed = 1;
+    }
+
+    if (pfs32_sync() != PFS_OK || pfs32_fsck(0) != 0) { fprintf(stderr, "mkpfs32: filesystem check failed\n"); failed = 1; }
+    if (host_disk_save(out) != 0) { perror(out); return 1; }
+    printf("mkpfs32: %s, %u MB, %s\n", out, size_mb, failed ? "with errors" : "ok");
+    return failed;
+}
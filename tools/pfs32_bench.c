@@ -0,0 +1,211 @@
+// tools/pfs32_bench.c - PFS32 workloads on a RAM disk, without QEMU
+//
+// Formats a fresh image and runs create/write/stat/read/seek/delete
+// phases over many small files and one large file. Each phase reports
+// ops/s and the transfers that reached the disk per operation (blocks
+// and driver commands), which is what changes when the filesystem does.
+// The background pumps run after every operation, as the GUI loop runs
+// them between app callbacks.
+#include "pfs32_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_DIR    "/bench"
+#define SMALL_SIZE   1024        // Bytes per small file
+#define CHUNK_SIZE   (64 * 1024) // Large-file transfer size
+#define SEEK_SIZE    4096        // Random read size
+#define SEEK_OPS     2000
+
+static uint32_t opts = HOST_MOUNT_OPTS;
+static int cold = 1;
+static uint32_t files = 2000;
+static uint32_t big_mb = 16;
+
+static uint8_t small[SMALL_SIZE];
+static uint8_t* chunk;
+
+typedef struct {
+    const char* name;
+    uint32_t ops;
+    uint64_t bytes;
+    double seconds;
+    host_io_t io;
+} phase_t;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void pump(void) {
+    pfs32_readahead_pump();
+    pfs32_writeback_pump();
+}
+
+static void path_of(char* out, uint32_t i) {
+    sprintf(out, BENCH_DIR "/file_%05u.dat", i);
+}
+
+static void fail(const char* what, uint32_t i, int res) {
+    fprintf(stderr, "pfs32-bench: %s failed at %u (%d)\n", what, i, res);
+    exit(1);
+}
+
+static void phase_begin(phase_t* p, const char* name) {
+    memset(p, 0, sizeof(*p));
+    p->name = name;
+    if (cold && host_drop_caches(opts) != PFS_OK) fail("remount", 0, PFS_ERR_IO);
+    host_io_reset();
+    p->seconds = now();
+}
+
+// Phases that write end with a sync, so the write-back they caused is
+// counted (and timed) with them
+static void phase_end(phase_t* p, int sync) {
+    if (sync) pfs32_sync();
+    p->seconds = now() - p->seconds;
+    host_io_get(&p->io);
+
+    double ops = p->ops ? p->ops : 1;
+    printf("%-10s %7u %10.0f %9.2f %9.2f %9.3f %9.3f",
+           p->name, p->ops, p->seconds > 0 ? p->ops / p->seconds : 0.0,
+           p->io.read_blocks / ops, p->io.write_blocks / ops,
+           p->io.read_cmds / ops, p->io.write_cmds / ops);
+    if (p->bytes && p->seconds > 0) printf(" %8.1f", p->bytes / p->seconds / (1024.0 * 1024.0));
+    printf("\n");
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [-n files] [-f big_file_mb] [-s image_mb] [-c cluster_bytes] [-o mount_opts] [-w] [-v]\n"
+        "  -o  PFS32_MOUNT_* bits (default 0x%x, as the kernel mounts)\n"
+        "  -w  Keep caches warm between phases (default: each phase starts cold)\n", prog, HOST_MOUNT_OPTS);
+}
+
+int main(int argc, char** argv) {
+    uint32_t image_mb = 256;
+    uint32_t cluster = PFS32_CLUSTER_DEFAULT;
+    for (int i = 1; i < argc; i++) {
+        const char* opt = argv[i];
+        if (!strcmp(opt, "-w")) { cold = 0; continue; }
+        if (!strcmp(opt, "-v")) { host_verbose = 1; continue; }
+        if (i + 1 >= argc) { usage(argv[0]); return 2; }
+        uint32_t val = (uint32_t)strtoul(argv[++i], 0, 0);
+        if (!strcmp(opt, "-n")) files = val;
+        else if (!strcmp(opt, "-f")) big_mb = val;
+        else if (!strcmp(opt, "-s")) image_mb = val;
+        else if (!strcmp(opt, "-c")) cluster = val;
+        else if (!strcmp(opt, "-o")) opts = val;
+        else { usage(argv[0]); return 2; }
+    }
+    if (!files || !big_mb || big_mb >= image_mb / 2 || image_mb > 2047) { usage(argv[0]); return 2; }
+
+    uint32_t total = image_mb * 2048;
+    chunk = (uint8_t*)malloc(CHUNK_SIZE);
+    if (!chunk || host_disk_create(total) != 0) { fprintf(stderr, "pfs32-bench: out of memory\n"); return 1; }
+    pfs32_init(HOST_PART_START, total - HOST_PART_START);
+    if (pfs32_format_cluster("Bench", total - HOST_PART_START, cluster) != PFS_OK) fail("format", 0, PFS_ERR_PARAM);
+    if (host_mount(opts) != PFS_OK || pfs32_create_directory(BENCH_DIR) != PFS_OK) fail("mount", 0, PFS_ERR_IO);
+
+    for (uint32_t i = 0; i < SMALL_SIZE; i++) small[i] = (uint8_t)(i * 31 + 7);
+    for (uint32_t i = 0; i < CHUNK_SIZE; i++) chunk[i] = (uint8_t)(i * 13 + 1);
+
+    printf("PFS32 bench: %u files, %u MB file, %u MB image, cluster %u, opts 0x%x, %s caches\n",
+           files, big_mb, image_mb, cluster, opts, cold ? "cold" : "warm");
+    printf("%-10s %7s %10s %9s %9s %9s %9s %8s\n",
+           "phase", "ops", "ops/s", "rd blk", "wr blk", "rd cmd", "wr cmd", "MB/s");
+
+    phase_t p;
+    char path[64];
+    int res;
+
+    phase_begin(&p, "create");
+    for (uint32_t i = 0; i < files; i++, p.ops++) {
+        path_of(path, i);
+        if ((res = pfs32_create_file(path)) != PFS_OK) fail("create", i, res);
+        pump();
+    }
+    phase_end(&p, 1);
+
+    phase_begin(&p, "write");
+    for (uint32_t i = 0; i < files; i++, p.ops++) {
+        path_of(path, i);
+        small[0] = (uint8_t)i;
+        if ((res = pfs32_write_file(path, small, SMALL_SIZE)) != SMALL_SIZE) fail("write", i, res);
+        p.bytes += SMALL_SIZE;
+        pump();
+    }
+    phase_end(&p, 1);
+
+    phase_begin(&p, "stat");
+    for (uint32_t i = 0; i < files; i++, p.ops++) {
+        pfs32_direntry_t e;
+        path_of(path, (i * 7919) % files);
+        if ((res = pfs32_stat(path, &e)) != PFS_OK || e.file_size != SMALL_SIZE) fail("stat", i, res);
+        pump();
+    }
+    phase_end(&p, 0);
+
+    phase_begin(&p, "read");
+    for (uint32_t i = 0; i < files; i++, p.ops++) {
+        uint8_t buf[SMALL_SIZE];
+        path_of(path, i);
+        if ((res = pfs32_read_file(path, buf, SMALL_SIZE)) != SMALL_SIZE || buf[0] != (uint8_t)i) fail("read", i, res);
+        p.bytes += SMALL_SIZE;
+        pump();
+    }
+    phase_end(&p, 0);
+
+    uint32_t big_size = big_mb * 1024 * 1024;
+    phase_begin(&p, "bigwrite");
+    if ((res = pfs32_create_file(BENCH_DIR "/big.dat")) != PFS_OK) fail("bigwrite", 0, res);
+    int h = pfs32_open(BENCH_DIR "/big.dat", 1);
+    if (h < 0) fail("bigwrite", 0, h);
+    for (uint32_t off = 0; off < big_size; off += CHUNK_SIZE, p.ops++) {
+        if ((res = pfs32_pwrite(h, chunk, CHUNK_SIZE, off)) != CHUNK_SIZE) fail("bigwrite", off, res);
+        p.bytes += CHUNK_SIZE;
+        pump();
+    }
+    pfs32_close(h);
+    phase_end(&p, 1);
+
+    phase_begin(&p, "bigread");
+    h = pfs32_open(BENCH_DIR "/big.dat", 0);
+    if (h < 0) fail("bigread", 0, h);
+    for (uint32_t off = 0; off < big_size; off += CHUNK_SIZE, p.ops++) {
+        if ((res = pfs32_read_handle(h, chunk, CHUNK_SIZE)) != CHUNK_SIZE) fail("bigread", off, res);
+        p.bytes += CHUNK_SIZE;
+        pump();
+    }
+    pfs32_close(h);
+    phase_end(&p, 0);
+
+    phase_begin(&p, "seek");
+    h = pfs32_open(BENCH_DIR "/big.dat", 0);
+    if (h < 0) fail("seek", 0, h);
+    uint32_t lcg = 12345;
+    for (uint32_t i = 0; i < SEEK_OPS; i++, p.ops++) {
+        lcg = lcg * 1103515245u + 12345u;
+        uint32_t off = (lcg >> 4) % (big_size - SEEK_SIZE);
+        if ((res = pfs32_pread(h, chunk, SEEK_SIZE, off)) != SEEK_SIZE) fail("seek", i, res);
+        p.bytes += SEEK_SIZE;
+        pump();
+    }
+    pfs32_close(h);
+    phase_end(&p, 0);
+
+    phase_begin(&p, "delete");
+    for (uint32_t i = 0; i < files; i++, p.ops++) {
+        path_of(path, i);
+        if ((res = pfs32_delete(path)) != PFS_OK) fail("delete", i, res);
+        pump();
+    }
+    if ((res = pfs32_delete(BENCH_DIR "/big.dat")) != PFS_OK) fail("delete", files, res);
+    phase_end(&p, 1);
+
+    printf("(rd/wr blk and cmd are per operation; MB/s counts file data only)\n");
+    return pfs32_fsck(0) != 0;
+}
@@ -0,0 +1,227 @@
+// tools/pfs32_crash.c - Crash-replay check for PFS32 on a RAM disk
+//
+// Runs a fixed workload (create and write files of mixed sizes, delete
+// every third, rename some of the rest, cut others to a third and grow
+// them back) with the background pumps after
+// every operation, as the GUI loop runs them, and one batch of
+// directories made with no pump between them: more blocks than the
+// block cache may hold dirty, so the transaction outgrows it. It is then run again from
+// a fresh format for each write command it issued, and the disk is
+// copied right after that command, as a power loss would leave it. The
+// copy is mounted (replaying the journal) and must pass pfs32_fsck, with
+// every file under exactly one name and either still empty or complete;
+// past the cut, truncated files may read as zeros. The directories that
+// made it must be the first ones of the batch.
+#include "pfs32_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CRASH_DIR  "/crash"
+#define MAX_SIZE   (192 * 1024) // Largest file; most span several clusters
+#define BATCH_DIRS 400          // A block each, past BCACHE_DIRTY_MAX
+
+static uint32_t opts = HOST_MOUNT_OPTS;
+static uint32_t files = 60;
+static uint32_t image_mb = 32;
+static uint32_t every = 0;      // Crash after every Nth write command, 0 = sized to the run
+
+static uint8_t* buf;
+static uint8_t* back;
+static uint8_t* snap;
+
+static uint32_t size_of(uint32_t i) {
+    return 300 + (i * 15331u) % (i % 4 ? 12000 : MAX_SIZE);
+}
+
+// Where the truncate phase cuts file `i`
+static uint32_t cut_of(uint32_t i) {
+    return size_of(i) / 3;
+}
+
+static void fill(uint8_t* out, uint32_t i) {
+    uint32_t n = size_of(i);
+    for (uint32_t k = 0; k < n; k++) out[k] = (uint8_t)(k * 7 + i * 13 + 1);
+}
+
+static void name_of(char* out, uint32_t i, int moved) {
+    sprintf(out, CRASH_DIR "/%s_%03u.dat", moved ? "moved" : "file", i);
+}
+
+static void dir_name_of(char* out, uint32_t i) {
+    sprintf(out, CRASH_DIR "/dir_%03u", i);
+}
+
+static void fail(const char* what, uint32_t i, int res) {
+    fprintf(stderr, "pfs32-crash: %s failed at %u (%d)\n", what, i, res);
+    exit(1);
+}
+
+// One operation of the workload; 0 once it is over
+static int step(uint32_t n) {
+    char path[64], to[64];
+    int res;
+    if (n < files) {
+        name_of(path, n, 0);
+        fill(buf, n);
+        if ((res = pfs32_create_file(path)) != PFS_OK) fail("create", n, res);
+        if ((res = pfs32_write_file(path, buf, size_of(n))) != (int)size_of(n)) fail("write", n, res);
+        return 1;
+    }
+    n -= files;
+    if (n < files / 3) {
+        name_of(path, n * 3, 0);
+        if ((res = pfs32_delete(path)) != PFS_OK) fail("delete", n * 3, res);
+        return 1;
+    }
+    n -= files / 3;
+    if (n < files / 3) {
+        name_of(path, n * 3 + 1, 0);
+        name_of(to, n * 3 + 1, 1);
+        if ((res = pfs32_rename(path, to)) != PFS_OK) fail("rename", n * 3 + 1, res);
+        return 1;
+    }
+    n -= files / 3;
+    if (n < 2 * (files / 3)) {
+        uint32_t i = (n / 2) * 3 + 2;
+        name_of(path, i, 0);
+        if ((res = pfs32_truncate(path, n % 2 ? size_of(i) : cut_of(i))) != PFS_OK) fail("truncate", i, res);
+        return 1;
+    }
+    n -= 2 * (files / 3);
+    if (n == 0) {
+        for (uint32_t i = 0; i < BATCH_DIRS; i++) {
+            dir_name_of(path, i);
+            if ((res = pfs32_create_directory(path)) != PFS_OK) fail("mkdir", i, res);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+static void pump(void) {
+    pfs32_readahead_pump();
+    pfs32_writeback_pump();
+}
+
+static void format(void) {
+    uint32_t total = image_mb * 2048;
+    if (host_disk_create(total) != 0) fail("image", 0, PFS_ERR_FULL);
+    pfs32_init(HOST_PART_START, total - HOST_PART_START);
+    if (pfs32_format_cluster("Crash", total - HOST_PART_START, PFS32_CLUSTER_DEFAULT) != PFS_OK) fail("format", 0, PFS_ERR_PARAM);
+    if (host_mount(opts) != PFS_OK || pfs32_create_directory(CRASH_DIR) != PFS_OK) fail("mount", 0, PFS_ERR_IO);
+}
+
+// Problems found in the copy taken after write command `cmd`
+static int check(uint32_t cmd) {
+    int problems = 0;
+    if (host_disk_restore(snap) != 0 || host_mount(opts) != PFS_OK) {
+        printf("after write %u: copy does not mount\n", cmd);
+        return 1;
+    }
+    int res = pfs32_fsck(0);
+    if (res != 0) {
+        printf("after write %u: fsck found %d problem%s\n", cmd, res, res == 1 ? "" : "s");
+        problems++;
+    }
+    for (uint32_t i = 0; i < files; i++) {
+        char path[64];
+        int found = 0;
+        for (int moved = 0; moved < 2; moved++) {
+            pfs32_direntry_t e;
+            name_of(path, i, moved);
+            if (pfs32_stat(path, &e) != PFS_OK) continue;
+            found++;
+            if (e.file_size == 0) continue; // Created, data not written yet
+            fill(buf, i);
+            res = pfs32_read_file(path, back, MAX_SIZE);
+            int ok = res == (int)e.file_size && (e.file_size == size_of(i) || (i % 3 == 2 && e.file_size == cut_of(i)));
+            // Past the cut a truncated file holds its old data or zeros
+            // (grown back, or cut when the power went)
+            uint32_t keep = (i % 3 == 2) ? cut_of(i) : e.file_size;
+            for (uint32_t k = 0; ok && k < e.file_size; k++) ok = back[k] == buf[k] || (k >= keep && back[k] == 0);
+            if (!ok) {
+                printf("after write %u: %s has wrong contents\n", cmd, path);
+                problems++;
+            }
+        }
+        if (found > 1) {
+            printf("after write %u: file %u is there under both names\n", cmd, i);
+            problems++;
+        }
+    }
+    // Operations commit in order, so the directories form a prefix
+    uint32_t made = 0;
+    for (uint32_t i = 0; i < BATCH_DIRS; i++) {
+        char path[64];
+        pfs32_direntry_t e;
+        dir_name_of(path, i);
+        if (pfs32_stat(path, &e) != PFS_OK) continue;
+        if (!(e.attributes & PFS32_ATTR_DIRECTORY)) {
+            printf("after write %u: %s is not a directory\n", cmd, path);
+            problems++;
+        } else if (made++ != i) {
+            printf("after write %u: %s made out of order\n", cmd, path);
+            problems++;
+        }
+    }
+    return problems;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [-n files] [-s image_mb] [-e every] [-o mount_opts] [-v]\n"
+        "  -e  Crash after every Nth write command (default: about 500 crash points)\n"
+        "  -o  PFS32_MOUNT_* bits (default 0x%x, as the kernel mounts)\n", prog, HOST_MOUNT_OPTS);
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* opt = argv[i];
+        if (!strcmp(opt, "-v")) { host_verbose = 1; continue; }
+        if (i + 1 >= argc) { usage(argv[0]); return 2; }
+        uint32_t val = (uint32_t)strtoul(argv[++i], 0, 0);
+        if (!strcmp(opt, "-n")) files = val;
+        else if (!strcmp(opt, "-s")) image_mb = val;
+        else if (!strcmp(opt, "-e")) every = val;
+        else if (!strcmp(opt, "-o")) opts = val;
+        else { usage(argv[0]); return 2; }
+    }
+    if (files < 3 || image_mb < 16 || image_mb > 2047) { usage(argv[0]); return 2; }
+
+    buf = (uint8_t*)malloc(MAX_SIZE);
+    back = (uint8_t*)malloc(MAX_SIZE);
+    snap = (uint8_t*)malloc((size_t)image_mb * 1024 * 1024);
+    if (!buf || !back || !snap) { fprintf(stderr, "pfs32-crash: out of memory\n"); return 1; }
+
+    // One full run to count the write commands
+    host_io_t io;
+    format();
+    host_io_reset();
+    for (uint32_t n = 0; step(n); n++) pump();
+    pfs32_sync();
+    host_io_get(&io);
+    uint32_t cmds = (uint32_t)io.write_cmds;
+    if (!every) every = cmds / 500 + 1;
+
+    printf("PFS32 crash replay: %u files, %u MB image, opts 0x%x, %u write commands, every %u\n",
+           files, image_mb, opts, cmds, every);
+    uint32_t points = 0, bad = 0;
+    for (uint32_t crash = 1; crash <= cmds; crash += every, points++) {
+        format();
+        host_io_reset();
+        host_disk_copy_at(crash, snap);
+        for (uint32_t n = 0; step(n); n++) {
+            pump();
+            host_io_get(&io);
+            if (io.write_cmds >= crash) break;
+        }
+        pfs32_sync();
+        host_io_get(&io);
+        host_disk_copy_at(0, 0);
+        if (io.write_cmds < crash) break; // The run came out shorter
+        if (check(crash)) bad++;
+    }
+    printf("%u crash points, %u failed\n", points, bad);
+    return bad != 0;
+}
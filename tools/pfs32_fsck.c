@@ -0,0 +1,53 @@
+// tools/pfs32_fsck.c - Check (and optionally repair) the PFS32 partition of an image
+//
+// Mounting replays the journal, as after an unclean shutdown in the
+// kernel. The check's own report goes to stderr; the image is only
+// written back when repairs were asked for.
+#include "pfs32_host.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    int repair = 0, quiet = 0;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-r")) repair = 1;
+        else if (!strcmp(argv[i], "-q")) quiet = 1;
+        else break;
+    }
+    if (argc - i != 1) {
+        fprintf(stderr, "Usage: %s [-r] [-q] disk.img\n"
+                        "  -r  Repair what can be repaired and save the image\n"
+                        "  -q  Only the summary, not the check's report\n", argv[0]);
+        return 2;
+    }
+    const char* img = argv[i];
+    host_verbose = !quiet;
+
+    if (host_disk_load(img) != 0) { perror(img); return 1; }
+    if (host_mount(HOST_MOUNT_OPTS) != PFS_OK) {
+        fprintf(stderr, "pfs32-fsck: %s has no PFS32 partition at LBA %u\n", img, HOST_PART_START);
+        return 1;
+    }
+
+    double t0 = now();
+    int res = pfs32_fsck(repair);
+    double secs = now() - t0;
+    if (res < 0) {
+        fprintf(stderr, "pfs32-fsck: check failed (%d)\n", res);
+        return 1;
+    }
+
+    uint32_t blocks = host_disk_blocks() - HOST_PART_START;
+    printf("%s: %u MB checked in %.2f s, %d problem%s%s\n", img, blocks / 2048, secs,
+           res, res == 1 ? "" : "s", repair ? " left" : "");
+    if (repair && host_disk_save(img) != 0) { perror(img); return 1; }
+    return res ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+// tools/pfs32_host.c - Kernel services and a RAM disk for host builds of PFS32
+#include "pfs32_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+int host_verbose = 0;
+
+static uint8_t* image = 0;
+static uint32_t image_blocks = 0;
+static host_io_t io;
+static uint64_t copy_at = 0;     // Write command that triggers the copy, 0 = none
+static uint8_t* copy_out = 0;
+
+// --- Kernel services used by fs/ ---
+
+void* kmalloc(size_t size) { return malloc(size ? size : 1); }
+void* kzalloc(size_t size) { return calloc(1, size ? size : 1); }
+void* krealloc(void* ptr, size_t size) { return realloc(ptr, size ? size : 1); }
+void kfree(void* ptr) { free(ptr); }
+
+void s_printf(const char* str) {
+    if (host_verbose) fputs(str, stderr);
+}
+
+void int_to_str(int num, char* str) {
+    sprintf(str, "%d", num);
+}
+
+int get_current_uid(void) {
+    return 0; // Tools run as root
+}
+
+// The timer runs at 50 Hz; write-back deadlines are measured in its ticks
+uint32_t get_tick_count(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 50 + ts.tv_nsec / 20000000);
+}
+
+// Mirrors hal/drivers/ata.h; disk.c only probes it on real hardware
+typedef struct {
+    uint32_t sectors;
+    char model[41];
+    int present;
+    int lba48;
+    uint32_t multiple;
+    int dma;
+} ide_device_t;
+
+ide_device_t ide_devices[2];
+void ata_identify_device(int drive) { (void)drive; }
+
+// --- RAM Disk ---
+
+extern void disk_set_device(blkdev_t* dev);
+
+static int host_rw(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf, int write) {
+    (void)dev;
+    if (lba >= image_blocks || count > image_blocks - lba) return 1;
+    uint8_t* mem = image + (size_t)lba * BLKDEV_BLOCK_SIZE;
+    if (write) {
+        memcpy(mem, buf, (size_t)count * BLKDEV_BLOCK_SIZE);
+        io.write_blocks += count;
+        io.write_cmds++;
+        if (copy_at && --copy_at == 0) memcpy(copy_out, image, (size_t)image_blocks * BLKDEV_BLOCK_SIZE);
+    } else {
+        memcpy(buf, mem, (size_t)count * BLKDEV_BLOCK_SIZE);
+        io.read_blocks += count;
+        io.read_cmds++;
+    }
+    return 0;
+}
+
+static blkdev_t host_dev = { "host0", 0, HOST_MAX_TRANSFER, host_rw };
+
+static int host_attach(void) {
+    host_dev.total_blocks = image_blocks;
+    if (blkdev_register(&host_dev) != 0) return -1;
+    disk_set_device(0); // Drops anything cached from a previous image
+    disk_set_device(&host_dev);
+    return 0;
+}
+
+int host_disk_create(uint32_t blocks) {
+    free(image);
+    image = (uint8_t*)calloc(blocks, BLKDEV_BLOCK_SIZE);
+    image_blocks = image ? blocks : 0;
+    if (!image) return -1;
+    return host_attach();
+}
+
+int host_disk_load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0 || size / BLKDEV_BLOCK_SIZE > 0xFFFFFFFFL) { fclose(f); return -1; }
+
+    uint32_t blocks = (uint32_t)(size / BLKDEV_BLOCK_SIZE);
+    free(image);
+    image = (uint8_t*)calloc(blocks ? blocks : 1, BLKDEV_BLOCK_SIZE);
+    image_blocks = 0;
+    if (!image || fread(image, BLKDEV_BLOCK_SIZE, blocks, f) != blocks) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    image_blocks = blocks;
+    return host_attach();
+}
+
+int host_disk_save(const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return -1;
+    size_t n = fwrite(image, BLKDEV_BLOCK_SIZE, image_blocks, f);
+    if (fclose(f) != 0 || n != image_blocks) return -1;
+    return 0;
+}
+
+uint8_t* host_disk_data(void) { return image; }
+uint32_t host_disk_blocks(void) { return image_blocks; }
+blkdev_t* host_disk_device(void) { return &host_dev; }
+
+void host_disk_copy_at(uint64_t cmd, uint8_t* out) {
+    copy_at = cmd;
+    copy_out = out;
+}
+
+int host_disk_restore(const uint8_t* data) {
+    if (!image) return -1;
+    memcpy(image, data, (size_t)image_blocks * BLKDEV_BLOCK_SIZE);
+    return host_attach();
+}
+
+void host_io_get(host_io_t* out) { *out = io; }
+void host_io_reset(void) { memset(&io, 0, sizeof(io)); }
+
+int host_mount(uint32_t opts) {
+    if (image_blocks <= HOST_PART_START) return PFS_ERR_PARAM;
+    return pfs32_mount(HOST_PART_START, image_blocks - HOST_PART_START, opts);
+}
+
+int host_drop_caches(uint32_t opts) {
+    if (pfs32_sync() != PFS_OK) return PFS_ERR_IO;
+    if (host_attach() != 0) return PFS_ERR_IO;
+    return host_mount(opts);
+}
+
+// --- Copying Files In ---
+
+int host_mkdirs(const char* path) {
+    char buf[256];
+    if (strlen(path) >= sizeof(buf)) return PFS_ERR_PARAM;
+    strcpy(buf, path);
+    for (char* p = buf + 1; ; p++) {
+        if (*p != '/' && *p != 0) continue;
+        char c = *p;
+        *p = 0;
+        int res = pfs32_create_directory(buf);
+        if (res != PFS_OK && res != PFS_ERR_EXISTS) return res;
+        if (!c) return PFS_OK;
+        *p = c;
+    }
+}
+
+static int put_file(const char* dst, const char* src) {
+    FILE* f = fopen(src, "rb");
+    if (!f) { perror(src); return PFS_ERR_NOT_FOUND; }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = (uint8_t*)malloc(size > 0 ? size : 1);
+    if (!data || fread(data, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "%s: read failed\n", src);
+        fclose(f);
+        free(data);
+        return PFS_ERR_IO;
+    }
+    fclose(f);
+
+    int res = pfs32_write_file(dst, data, (uint32_t)size);
+    free(data);
+    if (res < 0) {
+        fprintf(stderr, "%s: write failed (%d)\n", dst, res);
+        return res;
+    }
+    return PFS_OK;
+}
+
+int host_put(const char* dst, const char* src) {
+    struct stat st;
+    if (stat(src, &st) != 0) { perror(src); return PFS_ERR_NOT_FOUND; }
+
+    char parent[256];
+    const char* slash = strrchr(dst, '/');
+    if (!slash || (size_t)(slash - dst) >= sizeof(parent)) return PFS_ERR_PARAM;
+    if (slash != dst) {
+        memcpy(parent, dst, slash - dst);
+        parent[slash - dst] = 0;
+        int res = host_mkdirs(parent);
+        if (res != PFS_OK) { fprintf(stderr, "%s: cannot create directory (%d)\n", parent, res); return res; }
+    }
+    if (!S_ISDIR(st.st_mode)) return put_file(dst, src);
+
+    int res = pfs32_create_directory(dst);
+    if (res != PFS_OK && res != PFS_ERR_EXISTS) return res;
+    DIR* d = opendir(src);
+    if (!d) { perror(src); return PFS_ERR_IO; }
+    struct dirent* de;
+    res = PFS_OK;
+    while (res == PFS_OK && (de = readdir(d)) != 0) {
+        if (de->d_name[0] == '.') continue;
+        char s[1024], t[256];
+        snprintf(s, sizeof(s), "%s/%s", src, de->d_name);
+        if (snprintf(t, sizeof(t), "%s/%s", dst, de->d_name) >= (int)sizeof(t)) { res = PFS_ERR_PARAM; break; }
+        res = host_put(t, s);
+    }
+    closedir(d);
+    return res;
+}
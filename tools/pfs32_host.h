@@ -0,0 +1,63 @@
+// tools/pfs32_host.h - PFS32 built for Linux
+// fs/*.c is compiled unchanged for the host and runs over an image held
+// in RAM, presented to it as a block device with ATA-sized transfers.
+// mkpfs32, pfs32-put, pfs32-fsck and pfs32-bench link against this.
+#ifndef PFS32_HOST_H
+#define PFS32_HOST_H
+
+// libc's fixed-width types stand in for include/types.h
+#include <stdint.h>
+#include <stddef.h>
+#define TYPES_H
+#include "../fs/pfs32.h"
+#include "../fs/blkdev.h"
+
+#define HOST_PART_START   16384  // LBA of the PFS32 partition (installer and kernel)
+#define HOST_MAX_TRANSFER 256    // Blocks per command, as the ATA driver issues
+#define HOST_MOUNT_OPTS   (PFS32_MOUNT_FAT_RESIDENT | PFS32_MOUNT_WRITEBACK | \
+                           PFS32_MOUNT_RELATIME | PFS32_MOUNT_LAZYTIME) // Same as the kernel
+
+extern int host_verbose;         // Pass the filesystem's console messages to stderr
+
+// The disk: a zeroed image of `blocks`, or a file read into RAM. Either
+// becomes the device the filesystem runs on. 0 on success.
+int host_disk_create(uint32_t blocks);
+int host_disk_load(const char* path);
+int host_disk_save(const char* path);
+uint8_t* host_disk_data(void);
+uint32_t host_disk_blocks(void);
+blkdev_t* host_disk_device(void);
+
+// Copy the image to `out` right after the `cmd`-th write command from
+// now (1 = the next one), as power lost at that point would leave it
+void host_disk_copy_at(uint64_t cmd, uint8_t* out);
+// Put such a copy back: whatever the filesystem still holds in RAM is
+// dropped, not written. Mount again to replay the journal.
+int host_disk_restore(const uint8_t* data);
+
+// Transfers the filesystem issued to the disk since the last reset
+typedef struct {
+    uint64_t read_blocks;
+    uint64_t write_blocks;
+    uint64_t read_cmds;
+    uint64_t write_cmds;
+} host_io_t;
+
+void host_io_get(host_io_t* out);
+void host_io_reset(void);
+
+// Write everything back and forget all cached blocks and lookups, so the
+// next operations run cold. Remounts with `opts`.
+int host_drop_caches(uint32_t opts);
+
+// Mount the partition at HOST_PART_START with `opts`
+int host_mount(uint32_t opts);
+
+// Copy a host file, or a directory tree, to `dst`, creating missing
+// parent directories. Returns 0 or a PFS_ERR_* code; prints what failed.
+int host_put(const char* dst, const char* src);
+
+// Create every directory along `path` (like mkdir -p)
+int host_mkdirs(const char* path);
+
+#endif
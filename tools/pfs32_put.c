@@ -0,0 +1,36 @@
+// tools/pfs32_put.c - Copy files into the PFS32 partition of an existing image
+#include "pfs32_host.h"
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char** argv) {
+    int i = 1;
+    if (i < argc && !strcmp(argv[i], "-v")) { host_verbose = 1; i++; }
+    if (argc - i < 2) {
+        fprintf(stderr, "Usage: %s [-v] disk.img /dest/path=host_path ...\n", argv[0]);
+        return 2;
+    }
+    const char* img = argv[i++];
+
+    if (host_disk_load(img) != 0) { perror(img); return 1; }
+    if (host_mount(HOST_MOUNT_OPTS) != PFS_OK) {
+        fprintf(stderr, "pfs32-put: %s has no PFS32 partition at LBA %u\n", img, HOST_PART_START);
+        return 1;
+    }
+
+    int failed = 0;
+    for (; i < argc; i++) {
+        char* eq = strchr(argv[i], '=');
+        if (!eq || argv[i][0] != '/') { fprintf(stderr, "pfs32-put: expected /dest=source, got %s\n", argv[i]); failed = 1; continue; }
+        *eq = 0;
+        if (host_put(argv[i], eq + 1) != PFS_OK) failed = 1;
+    }
+
+    // Nothing is written unless the volume is consistent afterwards
+    if (pfs32_sync() != PFS_OK || pfs32_fsck(0) != 0) {
+        fprintf(stderr, "pfs32-put: filesystem check failed, %s left unchanged\n", img);
+        return 1;
+    }
+    if (host_disk_save(img) != 0) { perror(img); return 1; }
+    return failed;
+}
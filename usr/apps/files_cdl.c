@@ -29,7 +29,9 @@ int ctx_target_idx = -1;
 int open_with_active = 0;
 int open_with_target_idx = -1;
 
-static uint32_t last_fs_gen = 0;
+static int watch_wd = -1;          // Watch on current_path
+static char watch_path[256] = {0};
+static uint32_t last_fs_gen = 0;   // Polled while no watch could be had
 
 // Window Dimensions (Dynamic)
 static int win_w = 0;
@@ -62,7 +64,7 @@ int has_ext(const char* fname, const char* ext) {
 
 void scan_apps() {
     app_count = 0;
-    direntry_t temp[32]; 
+    fs_dirent_t temp[8];
     
     // Default Apps
     sys->strcpy(app_names[0], "Terminal"); sys->strcpy(app_paths[0], "/usr/apps/Terminal.app");
@@ -70,22 +72,27 @@ void scan_apps() {
     sys->strcpy(app_names[2], "TextEdit"); sys->strcpy(app_paths[2], "/usr/apps/TextEdit.app");
     app_count = 3;
 
-    int raw = sys->fs_list("/usr/apps", (void*)temp, 32);
-    for(int i=0; i<raw; i++) {
-        if(temp[i].filename[0] == 0 || temp[i].filename[0] == '.') continue;
-        int len = sys->strlen(temp[i].filename);
-        if (len > 4 && sys->strcmp(temp[i].filename + len - 4, ".app") == 0) {
-            // Skip already registered defaults to avoid duplicates
-            if (sys->strcmp(temp[i].filename, "Terminal.app") == 0) continue;
-            if (sys->strcmp(temp[i].filename, "Files.app") == 0) continue;
-            if (sys->strcmp(temp[i].filename, "TextEdit.app") == 0) continue;
-
-            if (app_count < MAX_APPS) {
-                sys->memset(app_names[app_count], 0, 32);
-                sys->memcpy(app_names[app_count], temp[i].filename, len-4);
-                sys->strcpy(app_paths[app_count], "/usr/apps/");
-                sys->strcpy(app_paths[app_count] + 10, temp[i].filename);
-                app_count++;
+    uint32_t cursor = 0;
+    while(app_count < MAX_APPS && cursor != FS_READDIR_END) {
+        int raw = sys->fs_readdir("/usr/apps", temp, 8, &cursor);
+        if (raw <= 0) break;
+        for(int i=0; i<raw; i++) {
+            const char* name = ((direntry_t*)temp[i].entry)->filename;
+            if(name[0] == '.') continue;
+            int len = sys->strlen(name);
+            if (len > 4 && sys->strcmp(name + len - 4, ".app") == 0) {
+                // Skip already registered defaults to avoid duplicates
+                if (sys->strcmp(name, "Terminal.app") == 0) continue;
+                if (sys->strcmp(name, "Files.app") == 0) continue;
+                if (sys->strcmp(name, "TextEdit.app") == 0) continue;
+
+                if (app_count < MAX_APPS) {
+                    sys->memset(app_names[app_count], 0, 32);
+                    sys->memcpy(app_names[app_count], name, len-4);
+                    sys->strcpy(app_paths[app_count], "/usr/apps/");
+                    sys->strcpy(app_paths[app_count] + 10, name);
+                    app_count++;
+                }
             }
         }
     }
@@ -93,17 +100,69 @@ void scan_apps() {
 
 void refresh_view() {
     sys->memset(entries, 0, sizeof(entries));
-    direntry_t temp[64];
-    int raw = sys->fs_list(current_path, (void*)temp, 64);
+    fs_dirent_t temp[16];
+    uint32_t cursor = 0;
 
+    // Names and attributes come in pages from one scan of the directory
     entry_count = 0;
-    for(int i=0; i<raw; i++) {
-        if(temp[i].filename[0] == 0 || temp[i].filename[0] == '.') continue;
-        entries[entry_count++] = temp[i];
+    while(entry_count < 64 && cursor != FS_READDIR_END) {
+        int raw = sys->fs_readdir(current_path, temp, 16, &cursor);
+        if (raw <= 0) break;
+        for(int i=0; i<raw && entry_count<64; i++) {
+            direntry_t* e = (direntry_t*)temp[i].entry;
+            if(e->filename[0] == '.') continue;
+            entries[entry_count++] = *e;
+        }
     }
     if (renaming_idx == -1) selected_idx = -1;
     ctx_active = 0;
     last_fs_gen = sys->get_fs_generation();
+
+    if (watch_wd < 0 || sys->strcmp(watch_path, current_path) != 0) {
+        if (watch_wd >= 0) sys->fs_watch_remove(watch_wd);
+        watch_wd = sys->fs_watch_add(current_path);
+        sys->strcpy(watch_path, current_path);
+    }
+}
+
+int find_entry(const char* name) {
+    for(int i=0; i<entry_count; i++) if (sys->strcmp(entries[i].filename, name) == 0) return i;
+    return -1;
+}
+
+void remove_entry(int idx) {
+    for(int i=idx; i<entry_count-1; i++) entries[i] = entries[i+1];
+    entry_count--;
+    sys->memset(&entries[entry_count], 0, sizeof(direntry_t));
+    if (selected_idx == idx) selected_idx = -1; else if (selected_idx > idx) selected_idx--;
+    if (renaming_idx == idx) renaming_idx = -1; else if (renaming_idx > idx) renaming_idx--;
+    if (ctx_target_idx == idx) ctx_active = 0;
+}
+
+// Patch the rows named by queued change events; re-list only on overflow.
+// Without a watch (all slots taken), fall back to the fs generation.
+void apply_fs_events() {
+    if (watch_wd < 0) {
+        if (sys->get_fs_generation() != last_fs_gen) refresh_view();
+        return;
+    }
+    fs_event_t ev[8];
+    int n;
+    while ((n = sys->fs_watch_read(watch_wd, ev, 8)) > 0) {
+        for(int i=0; i<n; i++) {
+            direntry_t* e = (direntry_t*)ev[i].entry;
+            if (ev[i].mask & FS_EVENT_OVERFLOW) { refresh_view(); continue; }
+            if (e->filename[0] == 0 || e->filename[0] == '.') continue;
+            int idx = find_entry(e->filename);
+            if (ev[i].mask & (FS_EVENT_DELETE | FS_EVENT_RENAME_FROM)) {
+                if (idx >= 0) remove_entry(idx);
+            } else if (idx >= 0) {
+                entries[idx] = *e;
+            } else if (entry_count < 64) {
+                entries[entry_count++] = *e;
+            }
+        }
+    }
 }
 
 void commit_rename() {
@@ -170,7 +229,6 @@ void create_item(int is_dir) {
     }
 
     sys->fs_create(path, is_dir);
-    refresh_view();
 }
 
 void open_item(int idx, int force_dialog) {
@@ -337,7 +395,6 @@ void on_mouse(int x, int y, int btn) {
                          if(dpath[sys->strlen(dpath)-1]!='/') sys->strcpy(dpath + sys->strlen(dpath), "/");
                          sys->strcpy(dpath + sys->strlen(dpath), entries[ctx_target_idx].filename);
                          sys->fs_delete(dpath);
-                         refresh_view();
                     }
                 }
             }
@@ -423,7 +480,7 @@ void on_paint(int x, int y, int w, int h) {
     win_w = w;
     win_h = h;
 
-    if (sys->get_fs_generation() != last_fs_gen) refresh_view();
+    apply_fs_events();
 
     int toolbar_h = 40;
     int sidebar_w = 150;
@@ -519,6 +576,12 @@ void on_paint(int x, int y, int w, int h) {
     }
 }
 
+void on_close() {
+    if (watch_wd >= 0) sys->fs_watch_remove(watch_wd);
+    watch_wd = -1;
+    watch_path[0] = 0;
+}
+
 void menu_cb(int m, int i) {
     if (m == 0 && i == 0) create_item(1); 
     if (m == 0 && i == 1) create_item(0); 
@@ -562,6 +625,7 @@ cdl_exports_t* cdl_main(kernel_api_t* api) {
     sys->strcpy(menus[2].items[0].label, "Refresh");
 
     sys->set_window_menu(win, menus, 3, menu_cb);
+    sys->set_window_close(win, on_close);
 
     return &exports;
 }
\ No newline at end of file
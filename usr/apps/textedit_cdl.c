@@ -29,6 +29,13 @@ static int scroll_y = 0;
 static int win_w = 600, win_h = 450; 
 static int show_save_prompt = 0;
 
+// --- Async Loading ---
+static aio_ring_t* io_ring = 0;
+static int loading = 0;
+static char loading_path[128];
+static char* load_buf = 0;          // Files are read here; swapped in only if the read succeeds
+static char status_msg[64] = {0};   // Shown in the status bar until the next key
+
 // --- Navigation State ---
 static int preferred_cur_x = -1; // -1 means "use actual X", >= 0 means try to stick to this column
 
@@ -190,6 +197,8 @@ void on_input(int key) {
     extern int cm_dialog_input(int);
     if (cm_dialog_input(key)) return;
     if (show_save_prompt) return;
+    if (loading) return; // The document is about to be replaced
+    status_msg[0] = 0;
 
     if (key == 0) return;
 
@@ -256,9 +265,38 @@ void on_input(int key) {
 
 // --- Painting ---
 
+// An open has read `len` bytes of `path` into load_buf (< 0: failed).
+// The open document is only replaced once the new one is all there.
+static void open_done(const char* path, int len) {
+    if (len < 0) {
+        sys->strcpy(status_msg, "Could not open ");
+        sys->strncpy(status_msg + 15, path, sizeof(status_msg) - 16);
+        return;
+    }
+    char* old = doc_buffer;
+    doc_buffer = load_buf;
+    load_buf = old;
+    doc_len = len; doc_buffer[doc_len] = 0;
+    sys->strcpy(current_path, path);
+    cursor_idx = 0; scroll_y = 0; is_dirty = 0;
+    status_msg[0] = 0;
+}
+
+// Pick up a finished async open
+static void poll_io() {
+    if (!io_ring) return;
+    while (io_ring->cq_head != io_ring->cq_tail) {
+        aio_cqe_t* cqe = &io_ring->cqes[io_ring->cq_head & (io_ring->entries - 1)];
+        open_done(loading_path, cqe->result);
+        io_ring->cq_head++;
+        loading = 0;
+    }
+}
+
 void on_paint(int x, int y, int w, int h) {
     if (!sys) return;
     win_w = w; win_h = h; 
+    poll_io();
     
     // Toolbar
     sys->draw_rect(x, y, w, TOOLBAR_H, C_TOOLBAR);
@@ -321,6 +359,8 @@ void on_paint(int x, int y, int w, int h) {
     char stats[64]; 
     char num[12]; sys->itoa(doc_len, num);
     sys->strcpy(stats, "Length: "); sys->strcpy(stats+8, num);
+    if (loading) sys->strcpy(stats, "Loading...");
+    else if (status_msg[0]) sys->strcpy(stats, status_msg);
     sys->draw_text(x + 10, st_y + 8, stats, 0xFF444444); 
     
     // Dialogs
@@ -333,14 +373,32 @@ void on_paint(int x, int y, int w, int h) {
 // ... Rest of file (on_mouse, file ops, main) kept as is or minimally adapted ...
 // Forward declarations for dialog callbacks required
 void on_file_picked_open(const char* path) {
-    if (!sys || !doc_buffer) return;
-    sys->memset(doc_buffer, 0, MAX_BUFFER);
-    int len = sys->fs_read(path, doc_buffer, MAX_BUFFER - 1);
-    if (len >= 0) {
-        doc_len = len; doc_buffer[doc_len] = 0;
-        sys->strcpy(current_path, path);
-        cursor_idx = 0; scroll_y = 0; is_dirty = 0;
+    if (!sys || !doc_buffer || loading) return;
+    if (!load_buf) load_buf = (char*)sys->malloc(MAX_BUFFER);
+    if (!load_buf) { sys->strcpy(status_msg, "Out of memory"); return; }
+    sys->memset(load_buf, 0, MAX_BUFFER);
+
+    // Read in the background so the GUI keeps painting; the result is
+    // collected in on_paint. The ring is made on first use.
+    if (!io_ring) io_ring = sys->aio_create(4);
+    if (io_ring) {
+        aio_sqe_t* sqe = &io_ring->sqes[io_ring->sq_tail & (io_ring->entries - 1)];
+        sqe->op = AIO_OP_READ;
+        sqe->user_data = 0;
+        sqe->path = path;
+        sqe->buf = load_buf;
+        sqe->len = MAX_BUFFER - 1;
+        sqe->offset = 0;
+        io_ring->sq_tail++;
+        if (sys->aio_submit(io_ring) == 1) {
+            sys->strncpy(loading_path, path, sizeof(loading_path) - 1);
+            loading = 1;
+            return;
+        }
+        io_ring->sq_tail--;
     }
+
+    open_done(path, sys->fs_read(path, load_buf, MAX_BUFFER - 1));
 }
 void on_file_picked_save(const char* path) {
     if (!sys) return;
@@ -396,6 +454,15 @@ void menu_cb(int menu, int item) {
     }
 }
 
+void on_close() {
+    // Drops a read still in flight, so load_buf is no longer written to
+    if (io_ring) sys->aio_destroy(io_ring);
+    io_ring = 0;
+    loading = 0;
+    if (load_buf) sys->free(load_buf);
+    load_buf = 0;
+}
+
 static cdl_exports_t exports = { .lib_name = "TextEdit", .version = 4 };
 cdl_exports_t* cdl_main(kernel_api_t* api) {
     sys = api;
@@ -417,5 +484,6 @@ cdl_exports_t* cdl_main(kernel_api_t* api) {
     sys->strcpy(menus[0].items[2].label, "Save");
     sys->strcpy(menus[0].items[3].label, "Quit");
     sys->set_window_menu(win, menus, 1, menu_cb);
+    sys->set_window_close(win, on_close);
     return &exports;
 }
@@ -11,6 +11,7 @@
 #include "../hal/video/animation.h"
 #include "../core/app_switcher.h"
 #include "desktop.h" // For desktop_is_ctx_open
+#include "../core/aio.h"
 
 // Extern for destroying window
 extern void ws_destroy_window(window_t* win);
@@ -86,9 +87,6 @@ static int menu_rect_h = 0;
 static int snap_preview_active = 0;
 static rect_t snap_preview_rect = {0,0,0,0};
 
-// Auto Refresh
-static uint32_t last_fs_gen = 0;
-
 // Rename State
 static int renaming_mode = 0;
 static char rename_buffer[64] = {0};
@@ -584,12 +582,12 @@ void ctx_menu_handle_click(int mx, int my) {
     extern int wrap_exec_with_args(const char*, const char*);
 
     switch(action) {
-        case 1: { /* New Folder */ char new_path[256]; strcpy(new_path, "/home/desktop/New Folder"); int counter = 1; char test_path[256]; while(1) { strcpy(test_path, new_path); if(counter > 1) { char num[10]; int_to_str(counter, num); strcat(test_path, " "); strcat(test_path, num); } strcat(test_path, "/"); if(!sys_fs_exists(test_path)) { strcpy(new_path, test_path); new_path[strlen(new_path)-1] = 0; break; } counter++; } sys_fs_create(new_path, 1); desktop_refresh(); } break;
-        case 2: /* New File */ sys_fs_create("/home/desktop/New_Text.txt", 0); desktop_refresh(); break;
+        case 1: { /* New Folder */ char new_path[256]; strcpy(new_path, "/home/desktop/New Folder"); int counter = 1; char test_path[256]; while(1) { strcpy(test_path, new_path); if(counter > 1) { char num[10]; int_to_str(counter, num); strcat(test_path, " "); strcat(test_path, num); } strcat(test_path, "/"); if(!sys_fs_exists(test_path)) { strcpy(new_path, test_path); new_path[strlen(new_path)-1] = 0; break; } counter++; } sys_fs_create(new_path, 1); } break;
+        case 2: /* New File */ sys_fs_create("/home/desktop/New_Text.txt", 0); break;
         case 3: /* Rename */ renaming_mode = 1; rename_cursor = 0; rename_buffer[0] = 0; menu_rect_x = mx; menu_rect_y = my + 20; g_ctx_menu.active = 0; break;
-        case 4: /* Delete */ sys_fs_delete_recursive(target_name); desktop_refresh(); break;
+        case 4: /* Delete */ sys_fs_delete_recursive(target_name); break;
         case 5: /* Copy */ strcpy(clip_file_path, target_name); clip_is_cut = 0; clip_active = 1; break;
-        case 6: /* Paste */ if (clip_active) { char dest[128] = "/home/desktop/"; strcat(dest, "Copy_of_File"); sys_fs_copy(clip_file_path, dest); desktop_refresh(); } break;
+        case 6: /* Paste */ if (clip_active) { char dest[128] = "/home/desktop/"; strcat(dest, "Copy_of_File"); sys_fs_copy(clip_file_path, dest); } break;
         case 7: /* Cut */ break; // TODO
         case 10: /* Open (Default) */ desktop_execute_item(target_name, 0); break;
     }
@@ -796,7 +794,6 @@ void start_bubble_view() {
     frames_drawn = 0;
 
     int mx = 0, my = 0;
-    last_fs_gen = sys_get_fs_generation();
 
     // Force an initial clear to blue
     uint32_t* buffer = gfx_get_active_buffer();
@@ -849,12 +846,8 @@ void start_bubble_view() {
 
             frame_counter++;
 
-        // Auto Refresh
-        uint32_t gen = sys_get_fs_generation();
-        if (gen != last_fs_gen) {
-            desktop_refresh();
-            last_fs_gen = gen;
-        }
+        // Icons follow changes to the desktop folder as they happen
+        desktop_sync();
 
         // Handle rename mode input
         if (renaming_mode) {
@@ -882,7 +875,6 @@ void start_bubble_view() {
                         strcpy(new_path, "/home/desktop/");
                         strcat(new_path, rename_buffer);
                         sys_fs_rename(old_path, new_path);
-                        desktop_refresh();
                     }
                     renaming_mode = 0;
                 } else if (k == 8) { // Backspace
@@ -922,6 +914,9 @@ void start_bubble_view() {
 
         handle_input(mx, my, lb, rb);
 
+        // Async file I/O for apps: one bounded slice per frame
+        aio_pump();
+
         prev_lb = lb;
         prev_rb = rb;
         frames_drawn++;
@@ -6,6 +6,7 @@
 #include "lib/camel_ui.h"
 #include "../fs/pfs32.h"
 #include "desktop.h"
+#include "../core/fswatch.h"
 
 // Externs from bubbleview.c
 extern int desktop_rename_active;
@@ -43,18 +44,16 @@ pfs32_direntry_t desk_entries[32];
 int desk_count = 0;
 int desk_selected[32];
 
+static int desk_watch = -1;
+static uint32_t last_fs_gen = 0;   // Polled while no watch could be had
+
 void desktop_refresh() {
-    uint32_t blk = 0xFFFFFFFF;
-    extern int get_dir_block(const char*, uint32_t*);
-    if(get_dir_block(DESKTOP_PATH, &blk) != 0) {
-        sys_fs_create(DESKTOP_PATH, 1);
-        get_dir_block(DESKTOP_PATH, &blk);
-    }
-    
     // Clear old state explicitly
     desk_count = 0;
     memset(desk_entries, 0, sizeof(desk_entries));
     memset(desk_selected, 0, sizeof(desk_selected));
+    last_fs_gen = sys_get_fs_generation();
+    if (desk_watch < 0) desk_watch = fswatch_add(DESKTOP_PATH);
     
     // Force reset rename state on refresh to avoid ghost inputs
     if (desktop_rename_active) {
@@ -64,12 +63,64 @@ void desktop_refresh() {
         desktop_rename_idx = -1;
     }
 
-    if (blk != 0xFFFFFFFF) {
-        pfs32_direntry_t temp[32];
-        int raw = sys_fs_list_dir(DESKTOP_PATH, temp, 32);
-        for(int i=0; i<raw; i++) {
-            if(temp[i].filename[0] != 0 && temp[i].filename[0] != '.') {
-                desk_entries[desk_count++] = temp[i];
+    // One directory scan gives every icon's name and attributes
+    pfs32_dirent_plus_t temp[8];
+    uint32_t cursor = 0;
+    while (desk_count < 32 && cursor != PFS32_READDIR_END) {
+        int raw = sys_fs_readdir(DESKTOP_PATH, temp, 8, &cursor);
+        if (raw == PFS_ERR_NOT_FOUND && desk_count == 0) {
+            sys_fs_create(DESKTOP_PATH, 1);
+            return;
+        }
+        if (raw <= 0) break;
+        for (int i = 0; i < raw && desk_count < 32; i++) desk_entries[desk_count++] = temp[i].entry;
+    }
+}
+
+static int desk_find(const char* name) {
+    for (int i = 0; i < desk_count; i++) if (strcmp(desk_entries[i].filename, name) == 0) return i;
+    return -1;
+}
+
+static void desk_remove(int idx) {
+    if (desktop_rename_active && desktop_rename_idx == idx) {
+        desktop_rename_active = 0;
+        desktop_rename_idx = -1;
+    } else if (desktop_rename_active && desktop_rename_idx > idx) {
+        desktop_rename_idx--;
+    }
+    for (int i = idx; i < desk_count - 1; i++) {
+        desk_entries[i] = desk_entries[i + 1];
+        desk_selected[i] = desk_selected[i + 1];
+    }
+    desk_count--;
+    memset(&desk_entries[desk_count], 0, sizeof(pfs32_direntry_t));
+    desk_selected[desk_count] = 0;
+}
+
+// Apply queued changes to the icons they name; only an overflowed queue
+// costs a full re-list. Without a watch (all slots taken), fall back to
+// the fs generation.
+void desktop_sync() {
+    if (desk_watch < 0) {
+        if (sys_get_fs_generation() != last_fs_gen) desktop_refresh();
+        return;
+    }
+    fs_event_t events[8];
+    int n;
+    while ((n = fswatch_read(desk_watch, events, 8)) > 0) {
+        for (int i = 0; i < n; i++) {
+            pfs32_direntry_t* e = (pfs32_direntry_t*)events[i].entry;
+            if (events[i].mask & FS_EVENT_OVERFLOW) { desktop_refresh(); continue; }
+            if (e->filename[0] == 0 || e->filename[0] == '.') continue;
+            int idx = desk_find(e->filename);
+            if (events[i].mask & (FS_EVENT_DELETE | FS_EVENT_RENAME_FROM)) {
+                if (idx >= 0) desk_remove(idx);
+            } else if (idx >= 0) {
+                desk_entries[idx] = *e;
+            } else if (desk_count < 32) {
+                desk_selected[desk_count] = 0;
+                desk_entries[desk_count++] = *e;
             }
         }
     }
@@ -20,5 +20,6 @@ extern int desktop_is_ctx_open();
 // Context menu functions (defined in bubbleview.c)
 extern void ctx_menu_show(int x, int y, int type, void* target);
 extern void desktop_refresh();
+extern void desktop_sync();    // Apply file-change events for the desktop folder
 
 #endif
\ No newline at end of file